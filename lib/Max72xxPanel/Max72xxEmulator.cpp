@@ -0,0 +1,187 @@
+/******************************************************************
+ Host-side emulator of a MAX7219/MAX7221 daisy chain.
+ See Max72xxEmulator.h for details.
+ ******************************************************************/
+
+#ifdef MAX72XX_EMULATOR
+
+#include "Max72xxEmulator.h"
+
+#include <chrono>
+#include <string.h>
+
+// The opcodes for the MAX7221 and MAX7219
+#define OP_NOOP         0
+#define OP_DIGIT0       1
+#define OP_DIGIT7       8
+#define OP_DECODEMODE   9
+#define OP_INTENSITY   10
+#define OP_SCANLIMIT   11
+#define OP_SHUTDOWN    12
+#define OP_DISPLAYTEST 15
+
+static uint64_t hostMicros() {
+	return std::chrono::duration_cast<std::chrono::microseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+Max72xxEmulator &Max72xxEmulator::instance() {
+	static Max72xxEmulator emulator;
+	return emulator;
+}
+
+void Max72xxEmulator::begin(uint8_t displays, uint8_t hDisplays) {
+	// Power-on state: registers are cleared and the chips are shut down
+	Device device = {};
+	device.shutdown = true;
+
+	devices.assign(displays, device);
+	shiftRegisters.assign(displays, 0);
+	Max72xxEmulator::hDisplays = hDisplays;
+
+	clear();
+}
+
+void Max72xxEmulator::latch(const uint8_t *data, size_t length) {
+	// Every chip passes the word it held to the next one, so after the
+	// transfer the first word sent sits in the farthest chip.
+
+	for ( size_t i = 0; i + 1 < length; i += 2 ) {
+		for ( size_t d = shiftRegisters.size(); d > 1; d-- ) {
+			shiftRegisters[d - 1] = shiftRegisters[d - 2];
+		}
+
+		if ( !shiftRegisters.empty() ) {
+			shiftRegisters[0] = (data[i] << 8) | data[i + 1];
+		}
+	}
+
+	for ( size_t d = 0; d < devices.size(); d++ ) {
+		execute(devices[d], shiftRegisters[d]);
+	}
+
+	pendingBytes += length;
+	pendingLatches++;
+}
+
+void Max72xxEmulator::execute(Device &device, uint16_t word) {
+	uint8_t opcode = (word >> 8) & 0x0f;
+	uint8_t data = word & 0xff;
+
+	if ( opcode >= OP_DIGIT0 && opcode <= OP_DIGIT7 ) {
+		device.digits[opcode - OP_DIGIT0] = data;
+		return;
+	}
+
+	switch ( opcode ) {
+		case OP_DECODEMODE:  device.decodeMode = data; break;
+		case OP_INTENSITY:   device.intensity = data & 0x0f; break;
+		case OP_SCANLIMIT:   device.scanLimit = data & 0x07; break;
+		case OP_SHUTDOWN:    device.shutdown = !(data & 1); break;
+		case OP_DISPLAYTEST: device.displayTest = data & 1; break;
+		default: break; // OP_NOOP and unused opcodes
+	}
+}
+
+void Max72xxEmulator::endFrame() {
+	uint64_t now = hostMicros();
+	uint32_t duration = lastFrameTime ? (uint32_t) (now - lastFrameTime) : 0;
+	lastFrameTime = now;
+
+	if ( maxFrames && recorded.size() >= maxFrames ) {
+		recorded.erase(recorded.begin(), recorded.begin() + (recorded.size() - maxFrames + 1));
+	}
+
+	recorded.push_back(Frame{devices, pendingBytes, pendingLatches, duration});
+
+	if ( !statistics.frames || pendingBytes < statistics.minBytes ) statistics.minBytes = pendingBytes;
+	if ( !statistics.frames || pendingBytes > statistics.maxBytes ) statistics.maxBytes = pendingBytes;
+	if ( !statistics.frames || duration < statistics.minDuration ) statistics.minDuration = duration;
+	if ( !statistics.frames || duration > statistics.maxDuration ) statistics.maxDuration = duration;
+
+	statistics.frames++;
+	statistics.bytes += pendingBytes;
+	statistics.totalDuration += duration;
+
+	pendingBytes = 0;
+	pendingLatches = 0;
+}
+
+void Max72xxEmulator::clear() {
+	recorded.clear();
+	statistics = {};
+
+	pendingBytes = 0;
+	pendingLatches = 0;
+	lastFrameTime = 0;
+}
+
+bool Max72xxEmulator::pixel(const Frame &frame, uint16_t x, uint16_t y) const {
+	// Panel sends bitmap columns as digits, so digit is x and bit is y
+	size_t display = (x >> 3) + hDisplays * (y >> 3);
+	if ( display >= frame.devices.size() ) return false;
+
+	const Device &device = frame.devices[display];
+	if ( device.displayTest ) return true;
+	if ( device.shutdown || (x & 0b111) > device.scanLimit ) return false;
+
+	return (device.digits[x & 0b111] >> (y & 0b111)) & 1;
+}
+
+void Max72xxEmulator::dumpAscii(FILE *out, const Frame &frame) const {
+	for ( uint16_t y = 0; y < height(); y++ ) {
+		for ( uint16_t x = 0; x < width(); x++ ) {
+			fputc(pixel(frame, x, y) ? '#' : '.', out);
+		}
+
+		fputc('\n', out);
+	}
+}
+
+bool Max72xxEmulator::dumpPpm(const char *path, const Frame &frame, uint8_t scale) const {
+	FILE *out = fopen(path, "wb");
+	if ( !out ) return false;
+
+	uint16_t w = width() * scale, h = height() * scale;
+	fprintf(out, "P6\n%u %u\n255\n", w, h);
+
+	std::vector<uint8_t> row(w * 3);
+	for ( uint16_t y = 0; y < h; y++ ) {
+		for ( uint16_t x = 0; x < w; x++ ) {
+			uint8_t *ptr = &row[x * 3];
+			size_t display = (x / scale >> 3) + hDisplays * (y / scale >> 3);
+
+			// Red LEDs, brightness follows the intensity register
+			uint8_t intensity = display < frame.devices.size() ? frame.devices[display].intensity : 0;
+			ptr[0] = pixel(frame, x / scale, y / scale) ? 15 + 15 * intensity : 24;
+			ptr[1] = ptr[2] = 0;
+		}
+
+		fwrite(row.data(), 1, row.size(), out);
+	}
+
+	return fclose(out) == 0;
+}
+
+size_t Max72xxEmulator::dumpPpmSequence(const char *pathPrefix, uint8_t scale) const {
+	char path[512];
+	size_t written = 0;
+
+	for ( size_t i = 0; i < recorded.size(); i++ ) {
+		snprintf(path, sizeof(path), "%s%04u.ppm", pathPrefix, (unsigned) i);
+		if ( dumpPpm(path, recorded[i], scale) ) written++;
+	}
+
+	return written;
+}
+
+void Max72xxEmulator::printStats(FILE *out) const {
+	fprintf(out, "Frames:          %u\n", statistics.frames);
+	fprintf(out, "SPI bytes:       %llu\n", (unsigned long long) statistics.bytes);
+	fprintf(out, "Bytes per frame: min %u, avg %.1f, max %u\n",
+	        statistics.minBytes, statistics.avgBytes(), statistics.maxBytes);
+	fprintf(out, "Frame time, us:  min %u, avg %.1f, max %u\n",
+	        statistics.minDuration, statistics.avgDuration(), statistics.maxDuration);
+}
+
+#endif	// MAX72XX_EMULATOR
@@ -0,0 +1,123 @@
+/******************************************************************
+ Host-side emulator of a MAX7219/MAX7221 daisy chain.
+
+ When the library is built with MAX72XX_EMULATOR defined, the panel
+ does not touch SPI or GPIO. Every chip select frame is fed into this
+ emulator instead, which decodes it the same way the chips do and
+ records a frame for every Max72xxPanel::write().
+
+ Frames can be dumped as ASCII art or PPM images, and statistics of
+ frame time and SPI traffic are collected, so rendering can be
+ regression- and performance-tested without the hardware.
+ ******************************************************************/
+
+#ifndef Max72xxEmulator_h
+#define Max72xxEmulator_h
+
+#ifdef MAX72XX_EMULATOR
+
+#include <stdint.h>
+#include <stdio.h>
+#include <vector>
+
+class Max72xxEmulator {
+
+public:
+
+  struct Device {
+    uint8_t digits[8];
+    uint8_t intensity;
+    uint8_t scanLimit;
+    uint8_t decodeMode;
+    bool shutdown;
+    bool displayTest;
+  };
+
+  struct Frame {
+    std::vector<Device> devices;
+
+    /* SPI traffic since the previous frame */
+    uint32_t bytes;
+    uint16_t latches;
+
+    /* Host time since the previous frame, in microseconds */
+    uint32_t duration;
+  };
+
+  struct Stats {
+    uint32_t frames;
+    uint64_t bytes;
+
+    uint32_t minBytes, maxBytes;
+    uint32_t minDuration, maxDuration;
+    uint64_t totalDuration;
+
+    double avgBytes() const { return frames ? (double) bytes / frames : 0; }
+    double avgDuration() const { return frames ? (double) totalDuration / frames : 0; }
+  };
+
+  /* Emulator shared by all panels of the process */
+  static Max72xxEmulator &instance();
+
+  /*
+   * Set up the chain. Displays are laid out in rows of hDisplays,
+   * the same way Max72xxPanel orders them.
+   */
+  void begin(uint8_t displays, uint8_t hDisplays);
+
+  /* Shift data in and latch it with a single chip select pulse */
+  void latch(const uint8_t *data, size_t length);
+
+  /* Record current state of displays as a frame */
+  void endFrame();
+
+  /* Drop recorded frames and statistics, state of displays is kept */
+  void clear();
+
+  /* Keep only the last maxFrames frames, 0 for no limit */
+  void setMaxFrames(size_t maxFrames) { this->maxFrames = maxFrames; }
+
+  const std::vector<Device> &state() const { return devices; }
+  const std::vector<Frame> &frames() const { return recorded; }
+  const Stats &stats() const { return statistics; }
+
+  uint16_t width() const { return hDisplays << 3; }
+  uint16_t height() const { return hDisplays ? ((devices.size() + hDisplays - 1) / hDisplays) << 3 : 0; }
+
+  /* Lit state of a pixel, using the same coordinates as the panel's bitmap */
+  bool pixel(const Frame &frame, uint16_t x, uint16_t y) const;
+
+  /* Write frame as rows of '#' and '.' */
+  void dumpAscii(FILE *out, const Frame &frame) const;
+
+  /* Write frame as binary PPM, every pixel is scale x scale square */
+  bool dumpPpm(const char *path, const Frame &frame, uint8_t scale = 8) const;
+
+  /* Write all frames as path_prefix0000.ppm, path_prefix0001.ppm, ... */
+  size_t dumpPpmSequence(const char *pathPrefix, uint8_t scale = 8) const;
+
+  void printStats(FILE *out) const;
+
+private:
+  Max72xxEmulator() = default;
+
+  std::vector<Device> devices;
+
+  /* 16-bit shift register of every device, index 0 is next to DIN */
+  std::vector<uint16_t> shiftRegisters;
+  uint8_t hDisplays = 0;
+
+  std::vector<Frame> recorded;
+  size_t maxFrames = 0;
+  Stats statistics = {};
+
+  uint32_t pendingBytes = 0;
+  uint16_t pendingLatches = 0;
+  uint64_t lastFrameTime = 0;
+
+  void execute(Device &device, uint16_t word);
+};
+
+#endif	// MAX72XX_EMULATOR
+
+#endif	// Max72xxEmulator_h
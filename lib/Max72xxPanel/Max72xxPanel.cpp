@@ -16,7 +16,12 @@
 
 #include <Adafruit_GFX.h>
 #include "Max72xxPanel.h"
-#include <SPI.h>
+
+#ifdef MAX72XX_EMULATOR
+	#include "Max72xxEmulator.h"
+#else
+	#include <SPI.h>
+#endif
 
 // The opcodes for the MAX7221 and MAX7219
 #define OP_NOOP         0
@@ -43,18 +48,29 @@ Max72xxPanel::Max72xxPanel(byte csPin, byte hDisplays, byte vDisplays) : Adafrui
 	Max72xxPanel::bitmapSize = displays << 3;
 
   Max72xxPanel::bitmap = (byte*)malloc(bitmapSize);
+  Max72xxPanel::latched = (byte*)malloc(bitmapSize);
+  Max72xxPanel::txBuffer = (byte*)malloc(displays << 1);
   Max72xxPanel::matrixRotation = (byte*)malloc(displays);
   Max72xxPanel::matrixPosition = (byte*)malloc(displays);
+  Max72xxPanel::pixelMap = (uint16_t*)malloc(bitmapSize * 8 * sizeof(uint16_t));
 
   for ( byte display = 0; display < displays; display++ ) {
   	matrixPosition[display] = display;
   	matrixRotation[display] = 0;
   }
 
+  updatePixelMap();
+
+  invalidate();
+
+#ifdef MAX72XX_EMULATOR
+  Max72xxEmulator::instance().begin(displays, hDisplays);
+#else
   SPI.begin();
 //SPI.setBitOrder(MSBFIRST);
 //SPI.setDataMode(SPI_MODE0);
   pinMode(SPI_CS, OUTPUT);
+#endif
 
   // Clear the screen
   fillScreen(0);
@@ -77,14 +93,19 @@ Max72xxPanel::Max72xxPanel(byte csPin, byte hDisplays, byte vDisplays) : Adafrui
 
 void Max72xxPanel::setPosition(byte display, byte x, byte y) {
 	matrixPosition[x + hDisplays * y] = display;
+	updatePixelMap();
 }
 
 void Max72xxPanel::setRotation(byte display, byte rotation) {
 	matrixRotation[display] = rotation;
+	updatePixelMap();
 }
 
 void Max72xxPanel::setRotation(uint8_t rotation) {
+	if ( (rotation & 3) == getRotation() ) return;
+
 	Adafruit_GFX::setRotation(rotation);
+	updatePixelMap();
 }
 
 void Max72xxPanel::shutdown(boolean b) {
@@ -92,14 +113,22 @@ void Max72xxPanel::shutdown(boolean b) {
 }
 
 void Max72xxPanel::setIntensity(byte intensity) {
+  if ( latchedIntensity == intensity ) return;
+
   spiTransfer(OP_INTENSITY, intensity);
+  latchedIntensity = intensity;
+}
+
+void Max72xxPanel::invalidate() {
+  latchedValid = false;
+  latchedIntensity = -1;
 }
 
 void Max72xxPanel::fillScreen(uint16_t color) {
   memset(bitmap, color ? 0xff : 0, bitmapSize);
 }
 
-void Max72xxPanel::drawPixel(int16_t xx, int16_t yy, uint16_t color) {
+int16_t Max72xxPanel::mapPixel(int16_t xx, int16_t yy) {
 	// Operating in bytes is faster and takes less code to run. We don't
 	// need values above 200, so switch from 16 bit ints to 8 bit unsigned
 	// ints (bytes).
@@ -125,7 +154,7 @@ void Max72xxPanel::drawPixel(int16_t xx, int16_t yy, uint16_t color) {
 
 	if ( x < 0 || x >= WIDTH || y < 0 || y >= HEIGHT ) {
 		// Ignore pixels outside the canvas.
-		return;
+		return -1;
 	}
 
 	// Translate the x, y coordinate according to the layout of the
@@ -150,10 +179,30 @@ void Max72xxPanel::drawPixel(int16_t xx, int16_t yy, uint16_t color) {
 	x += (display - d * hDisplays) << 3; // x += (display % hDisplays) * 8
 	y += d << 3;												 // y += (display / hDisplays) * 8
 
+	// Position of the pixel in our bitmap buffer: byte index and bit.
+
+	return ((x + WIDTH * (y >> 3)) << 3) | (y & 0b111);
+}
+
+void Max72xxPanel::updatePixelMap() {
+	for ( int16_t y = 0; y < _height; y++ ) {
+		for ( int16_t x = 0; x < _width; x++ ) {
+			pixelMap[x + _width * y] = mapPixel(x, y);
+		}
+	}
+}
+
+void Max72xxPanel::drawPixel(int16_t x, int16_t y, uint16_t color) {
+	if ( x < 0 || x >= _width || y < 0 || y >= _height ) {
+		// Ignore pixels outside the canvas.
+		return;
+	}
+
 	// Update the color bit in our bitmap buffer.
 
-	byte *ptr = bitmap + x + WIDTH * (y >> 3);
-	byte val = 1 << (y & 0b111);
+	uint16_t index = pixelMap[x + _width * y];
+	byte *ptr = bitmap + (index >> 3);
+	byte val = 1 << (index & 0b111);
 
 	if ( color ) {
 		*ptr |= val;
@@ -163,12 +212,53 @@ void Max72xxPanel::drawPixel(int16_t xx, int16_t yy, uint16_t color) {
 	}
 }
 
+void Max72xxPanel::drawColumn(int16_t x, int16_t y, byte bits) {
+	if ( x < 0 || x >= _width ) {
+		return;
+	}
+
+	if ( y >= 0 && y + 7 < _height ) {
+		const uint16_t *column = pixelMap + x + _width * y;
+
+		// Pixels of the column share one byte in the natural bit order,
+		// so just replace the byte.
+		if ( !(column[0] & 0b111) && column[_width * 7] == column[0] + 7 ) {
+			bitmap[column[0] >> 3] = bits;
+			return;
+		}
+	}
+
+	for ( byte i = 0; i < 8; i++ ) {
+		drawPixel(x, y + i, (bits >> i) & 1);
+	}
+}
+
 void Max72xxPanel::write() {
 	// Send the bitmap buffer to the displays.
+	// Every row is latched by its own CS pulse, so rows which are the same
+	// for all displays as the last time are skipped.
 
 	for ( byte row = OP_DIGIT7; row >= OP_DIGIT0; row-- ) {
+		byte offset = row - OP_DIGIT0;
+
+		bool changed = !latchedValid;
+		for ( byte i = offset; !changed && i < bitmapSize; i += 8 ) {
+			changed = bitmap[i] != latched[i];
+		}
+
+		if ( !changed ) continue;
+
 		spiTransfer(row);
+		for ( byte i = offset; i < bitmapSize; i += 8 ) {
+			latched[i] = bitmap[i];
+		}
 	}
+
+	latchedValid = true;
+
+#ifdef MAX72XX_EMULATOR
+	Max72xxEmulator::instance().endFrame();
+#endif
 }
 
 void Max72xxPanel::spiTransfer(byte opcode, byte data) {
@@ -176,20 +266,24 @@ void Max72xxPanel::spiTransfer(byte opcode, byte data) {
 	// If opcode <= OP_DIGIT7, display the column with data in our buffer for all displays.
 	// We do not support (nor need) to use the OP_NOOP opcode.
 
-	// Enable the line
-	digitalWrite(SPI_CS, LOW);
-
-	// Now shift out the data, two bytes per display. The first byte is the opcode,
-	// the second byte the data.
+	// Prepare the data, two bytes per display. The first byte is the opcode,
+	// the second byte the data. The farthest display goes first.
 	byte end = opcode - OP_DIGIT0;
 	byte start = bitmapSize + end;
+	byte *ptr = txBuffer;
 	do {
 		start -= 8;
-		SPI.transfer(opcode);
-		SPI.transfer(opcode <= OP_DIGIT7 ? bitmap[start] : data);
+		*ptr++ = opcode;
+		*ptr++ = opcode <= OP_DIGIT7 ? bitmap[start] : data;
 	}
 	while ( start > end );
 
-	// Latch the data onto the display(s)
+	// Shift it out in a single transfer and latch the data onto the display(s)
+#ifdef MAX72XX_EMULATOR
+	Max72xxEmulator::instance().latch(txBuffer, ptr - txBuffer);
+#else
+	digitalWrite(SPI_CS, LOW);
+	SPI.writeBytes(txBuffer, ptr - txBuffer);
 	digitalWrite(SPI_CS, HIGH);
+#endif
 }
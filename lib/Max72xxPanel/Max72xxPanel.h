@@ -67,10 +67,18 @@ public:
   /*
    * Draw a pixel on your canvas. Note that for performance reasons,
    * the pixels are not actually send to the displays. Only the internal
-   * bitmap buffer is modified.
+   * bitmap buffer is modified. The position in the buffer is looked up
+   * in a table, which is rebuilt when rotation or position changes.
    */
   void drawPixel(int16_t x, int16_t y, uint16_t color);
 
+  /*
+   * Draw 8 vertical pixels starting at (x, y) at once. The least
+   * significant bit of bits goes to the top pixel. When nothing is
+   * rotated and y is aligned to the displays, it is a single byte copy.
+   */
+  void drawColumn(int16_t x, int16_t y, byte bits);
+
   /*
    * As we can do this much faster then setting all the pixels one by
    * one, we have a dedicated function to clear the screen.
@@ -95,10 +103,18 @@ public:
 
   /*
    * After you're done filling the bitmap buffer with your picture,
-   * send it to the display(s).
+   * send it to the display(s). Only rows changed since the last
+   * write are sent.
    */
   void write();
 
+  /*
+   * Forget what was latched by the displays, so the next write() and
+   * setIntensity() send everything again. Use it if displays could
+   * lose their state (e.g. after power glitch).
+   */
+  void invalidate();
+
 private:
   byte SPI_CS; /* SPI chip selection */
 
@@ -109,9 +125,27 @@ private:
   byte *bitmap;
   byte bitmapSize;
 
+  /* Shadow of the bitmap as it was latched by the displays */
+  byte *latched;
+  bool latchedValid;
+  int16_t latchedIntensity;
+
+  /* Opcode and data pair for every display, sent in a single transfer */
+  byte *txBuffer;
+
   byte hDisplays;
   byte *matrixPosition;
   byte *matrixRotation;
+
+  /*
+   * Bitmap position (byte index * 8 + bit) of every pixel of the canvas
+   * in the current rotation, indexed by x + width * y.
+   */
+  uint16_t *pixelMap;
+
+  /* Translate canvas coordinates to bitmap position, -1 if outside */
+  int16_t mapPixel(int16_t x, int16_t y);
+  void updatePixelMap();
 };
 
 #endif	// Max72xxPanel_h
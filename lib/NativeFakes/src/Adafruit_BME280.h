@@ -0,0 +1,83 @@
+#pragma once
+
+#include "Wire.h"
+
+struct FakeBme280State;
+
+/*
+ * BME280 driver with readings set by fake_bme280_set(). Reads block for the time of the real bus transfers.
+ * Every I2C controller has its own sensor with different default readings, so zones can be told apart.
+ */
+class Adafruit_BME280 {
+    FakeBme280State *_state;
+
+public:
+    Adafruit_BME280();
+
+    enum sensor_mode {
+        MODE_SLEEP = 0b00,
+        MODE_FORCED = 0b01,
+        MODE_NORMAL = 0b11,
+    };
+
+    enum sensor_sampling {
+        SAMPLING_NONE = 0b000,
+        SAMPLING_X1 = 0b001,
+        SAMPLING_X2 = 0b010,
+        SAMPLING_X4 = 0b011,
+        SAMPLING_X8 = 0b100,
+        SAMPLING_X16 = 0b101,
+    };
+
+    enum sensor_filter {
+        FILTER_OFF = 0b000,
+        FILTER_X2 = 0b001,
+        FILTER_X4 = 0b010,
+        FILTER_X8 = 0b011,
+        FILTER_X16 = 0b100,
+    };
+
+    enum standby_duration {
+        STANDBY_MS_0_5 = 0b000,
+        STANDBY_MS_10 = 0b110,
+        STANDBY_MS_20 = 0b111,
+        STANDBY_MS_62_5 = 0b001,
+        STANDBY_MS_125 = 0b010,
+        STANDBY_MS_250 = 0b011,
+        STANDBY_MS_500 = 0b100,
+        STANDBY_MS_1000 = 0b101,
+    };
+
+    bool begin(uint8_t address = 0x77, TwoWire *wire = &Wire);
+
+    void setSampling(sensor_mode mode = MODE_NORMAL,
+                     sensor_sampling temperature = SAMPLING_X16,
+                     sensor_sampling pressure = SAMPLING_X16,
+                     sensor_sampling humidity = SAMPLING_X16,
+                     sensor_filter filter = FILTER_OFF,
+                     standby_duration duration = STANDBY_MS_0_5);
+
+    bool takeForcedMeasurement();
+
+    float readTemperature();
+    float readPressure();
+    float readHumidity();
+};
+
+struct FakeBme280State {
+    float temperature;
+    float humidity;
+    float pressure;
+
+    // Time of a single register read and of a forced measurement
+    uint32_t read_us;
+    uint32_t measurement_us;
+
+    uint32_t reads;
+};
+
+#define FAKE_I2C_BUS_COUNT 2
+
+// Sensor on I2C controller bus: 22.5 C, 45 % on bus 0 and 20.5 C, 55 % on bus 1 by default
+void fake_bme280_set(float temperature, float humidity, uint8_t bus = 0);
+FakeBme280State &fake_bme280(uint8_t bus = 0);
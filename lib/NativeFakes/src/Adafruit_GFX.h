@@ -0,0 +1,81 @@
+#pragma once
+
+#include "Arduino.h"
+
+/*
+ * Adafruit GFX subset: pixel primitives, rotation and text with the classic 5x7 font,
+ * so glyphs rendered on host look like on the device.
+ */
+class Adafruit_GFX : public Print {
+protected:
+    int16_t WIDTH, HEIGHT;
+    int16_t _width, _height;
+    uint8_t rotation = 0;
+
+    int16_t cursor_x = 0, cursor_y = 0;
+    uint16_t textcolor = 0xffff, textbgcolor = 0xffff;
+    uint8_t textsize_x = 1, textsize_y = 1;
+    bool wrap = true;
+
+public:
+    Adafruit_GFX(int16_t w, int16_t h) : WIDTH(w), HEIGHT(h), _width(w), _height(h) {}
+
+    virtual void drawPixel(int16_t x, int16_t y, uint16_t color) = 0;
+
+    virtual void startWrite() {}
+    virtual void endWrite() {}
+    virtual void writePixel(int16_t x, int16_t y, uint16_t color) { drawPixel(x, y, color); }
+
+    virtual void drawFastVLine(int16_t x, int16_t y, int16_t h, uint16_t color);
+    virtual void drawFastHLine(int16_t x, int16_t y, int16_t w, uint16_t color);
+    virtual void fillRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color);
+    virtual void fillScreen(uint16_t color);
+
+    virtual void setRotation(uint8_t r);
+    virtual void invertDisplay(bool) {}
+
+    void drawRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color);
+    void drawChar(int16_t x, int16_t y, unsigned char c, uint16_t color, uint16_t bg, uint8_t size);
+    void drawChar(int16_t x, int16_t y, unsigned char c, uint16_t color, uint16_t bg, uint8_t size_x, uint8_t size_y);
+
+    inline void setCursor(int16_t x, int16_t y) {
+        cursor_x = x;
+        cursor_y = y;
+    }
+
+    inline void setTextColor(uint16_t c) { textcolor = textbgcolor = c; }
+    inline void setTextColor(uint16_t c, uint16_t bg) {
+        textcolor = c;
+        textbgcolor = bg;
+    }
+
+    inline void setTextSize(uint8_t s) { textsize_x = textsize_y = s > 0 ? s : 1; }
+    inline void setTextWrap(bool w) { wrap = w; }
+    inline void cp437(bool) {}
+
+    inline int16_t getCursorX() const { return cursor_x; }
+    inline int16_t getCursorY() const { return cursor_y; }
+
+    size_t write(uint8_t c) override;
+    using Print::write;
+
+    inline int16_t width() const { return _width; }
+    inline int16_t height() const { return _height; }
+    inline uint8_t getRotation() const { return rotation; }
+};
+
+class GFXcanvas1 : public Adafruit_GFX {
+    uint8_t *_buffer;
+
+    bool _rotate(int16_t &x, int16_t &y) const;
+
+public:
+    GFXcanvas1(uint16_t w, uint16_t h);
+    ~GFXcanvas1();
+
+    void drawPixel(int16_t x, int16_t y, uint16_t color) override;
+    void fillScreen(uint16_t color) override;
+
+    bool getPixel(int16_t x, int16_t y) const;
+    inline uint8_t *getBuffer() const { return _buffer; }
+};
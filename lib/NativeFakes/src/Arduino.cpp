@@ -0,0 +1,454 @@
+#include "Arduino.h"
+
+#include <mutex>
+#include <random>
+#include <thread>
+
+#include "fake_time.h"
+
+HardwareSerial Serial(0);
+EspClass ESP;
+
+static const uint32_t FAKE_HEAP_SIZE = 327680;
+static const uint32_t FAKE_FREE_HEAP = 245760;
+
+static uint8_t pin_modes[40];
+static uint8_t pin_levels[40];
+
+static FakeLedcChannel ledc_channels[LEDC_CHANNELS];
+static std::mutex ledc_mutex;
+
+static std::mt19937 random_engine(0);
+static std::mutex random_mutex;
+
+unsigned long millis() {
+    return (unsigned long) (fake_time_us() / 1000);
+}
+
+unsigned long micros() {
+    return (unsigned long) fake_time_us();
+}
+
+void delay(uint32_t ms) {
+    fake_time_sleep((uint64_t) ms * 1000);
+}
+
+void delayMicroseconds(uint32_t us) {
+    fake_time_sleep(us);
+}
+
+void yield() {
+    std::this_thread::yield();
+}
+
+void pinMode(uint8_t pin, uint8_t mode) {
+    if (pin < sizeof(pin_modes)) pin_modes[pin] = mode;
+}
+
+void digitalWrite(uint8_t pin, uint8_t value) {
+    if (pin < sizeof(pin_levels)) pin_levels[pin] = value;
+}
+
+int digitalRead(uint8_t pin) {
+    return pin < sizeof(pin_levels) ? pin_levels[pin] : LOW;
+}
+
+void tone(uint8_t pin, unsigned int frequency, unsigned long duration) {
+    ledcAttachPin(pin, 0);
+    ledcWriteTone(0, frequency);
+
+    if (duration) {
+        delay(duration);
+        ledcWriteTone(0, 0);
+    }
+}
+
+void noTone(uint8_t pin) {
+    ledcWriteTone(0, 0);
+}
+
+double ledcSetup(uint8_t channel, double frequency, uint8_t resolution_bits) {
+    if (channel >= LEDC_CHANNELS) return 0;
+
+    std::lock_guard<std::mutex> guard(ledc_mutex);
+    ledc_channels[channel].frequency = frequency;
+    ledc_channels[channel].resolution_bits = resolution_bits;
+
+    return frequency;
+}
+
+void ledcWrite(uint8_t channel, uint32_t duty) {
+    if (channel >= LEDC_CHANNELS) return;
+
+    std::lock_guard<std::mutex> guard(ledc_mutex);
+    ledc_channels[channel].duty = duty;
+}
+
+double ledcWriteTone(uint8_t channel, double frequency) {
+    if (channel >= LEDC_CHANNELS) return 0;
+
+    std::lock_guard<std::mutex> guard(ledc_mutex);
+    auto &state = ledc_channels[channel];
+    state.frequency = frequency;
+
+    // Tone is square wave of 50% duty
+    if (frequency > 0) {
+        state.duty = state.resolution_bits ? 1u << (state.resolution_bits - 1) : 0;
+        ++state.tones;
+    } else {
+        state.duty = 0;
+    }
+
+    return frequency;
+}
+
+uint32_t ledcRead(uint8_t channel) {
+    return channel < LEDC_CHANNELS ? fake_ledc_channel(channel).duty : 0;
+}
+
+double ledcReadFreq(uint8_t channel) {
+    return channel < LEDC_CHANNELS ? fake_ledc_channel(channel).frequency : 0;
+}
+
+void ledcAttachPin(uint8_t pin, uint8_t channel) {
+    if (channel >= LEDC_CHANNELS) return;
+
+    std::lock_guard<std::mutex> guard(ledc_mutex);
+    ledc_channels[channel].pin = pin;
+}
+
+void ledcDetachPin(uint8_t pin) {
+    std::lock_guard<std::mutex> guard(ledc_mutex);
+    for (auto &channel : ledc_channels) {
+        if (channel.pin == pin) channel.pin = -1;
+    }
+}
+
+const FakeLedcChannel &fake_ledc_channel(uint8_t channel) {
+    std::lock_guard<std::mutex> guard(ledc_mutex);
+    return ledc_channels[channel];
+}
+
+long random(long max) {
+    return max > 0 ? random(0, max) : 0;
+}
+
+long random(long min, long max) {
+    if (min >= max) return min;
+
+    std::lock_guard<std::mutex> guard(random_mutex);
+    return min + (long) (random_engine() % (unsigned long) (max - min));
+}
+
+void randomSeed(unsigned long seed) {
+    std::lock_guard<std::mutex> guard(random_mutex);
+    random_engine.seed(seed);
+}
+
+// Seeded with constant, so runs are reproducible
+uint32_t esp_random() {
+    std::lock_guard<std::mutex> guard(random_mutex);
+    return random_engine();
+}
+
+static std::string _format_unsigned(unsigned long long value, uint8_t base) {
+    if (base < 2) base = DEC;
+
+    char buffer[65];
+    char *str = &buffer[sizeof(buffer) - 1];
+    *str = '\0';
+
+    do {
+        const char digit = (char) (value % base);
+        *--str = digit < 10 ? digit + '0' : digit + 'A' - 10;
+        value /= base;
+    } while (value);
+
+    return str;
+}
+
+static std::string _format_signed(long long value, uint8_t base) {
+    if (value < 0 && base == DEC) return "-" + _format_unsigned((unsigned long long) -value, base);
+    return _format_unsigned((unsigned long long) value, base);
+}
+
+static std::string _format_float(double value, unsigned int decimals) {
+    char buffer[64];
+    snprintf(buffer, sizeof(buffer), "%.*f", (int) decimals, value);
+    return buffer;
+}
+
+String::String(unsigned char value, unsigned char base) : _value(_format_unsigned(value, base)) { _keep_on_heap(); }
+
+String::String(int value, unsigned char base) : _value(_format_signed(value, base)) { _keep_on_heap(); }
+
+String::String(unsigned int value, unsigned char base) : _value(_format_unsigned(value, base)) { _keep_on_heap(); }
+
+String::String(long value, unsigned char base) : _value(_format_signed(value, base)) { _keep_on_heap(); }
+
+String::String(unsigned long value, unsigned char base) : _value(_format_unsigned(value, base)) { _keep_on_heap(); }
+
+String::String(float value, unsigned int decimals) : _value(_format_float(value, decimals)) { _keep_on_heap(); }
+
+String::String(double value, unsigned int decimals) : _value(_format_float(value, decimals)) { _keep_on_heap(); }
+
+String &String::operator=(const char *value) {
+    _value = value ? value : "";
+    _keep_on_heap();
+    return *this;
+}
+
+bool String::concat(const String &other) {
+    _value += other._value;
+    _keep_on_heap();
+    return true;
+}
+
+bool String::concat(const char *value) {
+    if (value) _value += value;
+    _keep_on_heap();
+    return value != nullptr;
+}
+
+bool String::concat(char c) {
+    _value += c;
+    _keep_on_heap();
+    return true;
+}
+
+String &String::operator+=(const String &other) {
+    concat(other);
+    return *this;
+}
+
+String &String::operator+=(const char *value) {
+    concat(value);
+    return *this;
+}
+
+String &String::operator+=(char c) {
+    concat(c);
+    return *this;
+}
+
+String operator+(const String &a, const String &b) {
+    String result(a);
+    result += b;
+    return result;
+}
+
+String operator+(const String &a, const char *b) {
+    String result(a);
+    result += b;
+    return result;
+}
+
+String operator+(const char *a, const String &b) {
+    String result(a);
+    result += b;
+    return result;
+}
+
+String operator+(const String &a, char b) {
+    String result(a);
+    result += b;
+    return result;
+}
+
+int String::indexOf(char c, unsigned int from) const {
+    const auto pos = _value.find(c, from);
+    return pos == std::string::npos ? -1 : (int) pos;
+}
+
+int String::indexOf(const char *value, unsigned int from) const {
+    const auto pos = _value.find(value, from);
+    return pos == std::string::npos ? -1 : (int) pos;
+}
+
+String String::substring(unsigned int from) const {
+    return substring(from, length());
+}
+
+String String::substring(unsigned int from, unsigned int to) const {
+    if (from > to) std::swap(from, to);
+    if (from >= _value.size()) return String();
+
+    return String(_value.substr(from, to - from).c_str());
+}
+
+long String::toInt() const {
+    return atol(_value.c_str());
+}
+
+float String::toFloat() const {
+    return (float) atof(_value.c_str());
+}
+
+double String::toDouble() const {
+    return atof(_value.c_str());
+}
+
+size_t Print::write(const uint8_t *buffer, size_t size) {
+    size_t written = 0;
+    while (size--) {
+        if (!write(*buffer++)) break;
+        ++written;
+    }
+
+    return written;
+}
+
+size_t Print::printf(const char *format, ...) {
+    char buffer[256];
+
+    va_list args;
+    va_start(args, format);
+    const int length = vsnprintf(buffer, sizeof(buffer), format, args);
+    va_end(args);
+
+    if (length < 0) return 0;
+    if ((size_t) length < sizeof(buffer)) return write((const uint8_t *) buffer, length);
+
+    std::string large((size_t) length + 1, '\0');
+    va_start(args, format);
+    vsnprintf(&large[0], large.size(), format, args);
+    va_end(args);
+
+    return write((const uint8_t *) large.data(), length);
+}
+
+size_t Print::_print_number(unsigned long long value, uint8_t base) {
+    const auto str = _format_unsigned(value, base);
+    return write((const uint8_t *) str.data(), str.size());
+}
+
+size_t Print::_print_signed(long long value, int base) {
+    const auto str = _format_signed(value, (uint8_t) base);
+    return write((const uint8_t *) str.data(), str.size());
+}
+
+size_t Print::_print_float(double value, uint8_t digits) {
+    const auto str = _format_float(value, digits);
+    return write((const uint8_t *) str.data(), str.size());
+}
+
+size_t Print::print(const char *str) {
+    return write(str);
+}
+
+size_t Print::print(const String &str) {
+    return write((const uint8_t *) str.c_str(), str.length());
+}
+
+size_t Print::print(char c) {
+    return write((uint8_t) c);
+}
+
+size_t Print::print(unsigned char value, int base) {
+    return base ? _print_number(value, base) : write(value);
+}
+
+size_t Print::print(int value, int base) {
+    return base ? _print_signed(value, base) : write((uint8_t) value);
+}
+
+size_t Print::print(unsigned int value, int base) {
+    return base ? _print_number(value, base) : write((uint8_t) value);
+}
+
+size_t Print::print(long value, int base) {
+    return base ? _print_signed(value, base) : write((uint8_t) value);
+}
+
+size_t Print::print(unsigned long value, int base) {
+    return base ? _print_number(value, base) : write((uint8_t) value);
+}
+
+size_t Print::print(long long value, int base) {
+    return base ? _print_signed(value, base) : write((uint8_t) value);
+}
+
+size_t Print::print(unsigned long long value, int base) {
+    return base ? _print_number(value, base) : write((uint8_t) value);
+}
+
+size_t Print::print(double value, int digits) {
+    return _print_float(value, (uint8_t) digits);
+}
+
+size_t Print::print(const Printable &value) {
+    return value.printTo(*this);
+}
+
+size_t Print::println() {
+    return write((const uint8_t *) "\r\n", 2);
+}
+
+String IPAddress::toString() const {
+    char buffer[16];
+    snprintf(buffer, sizeof(buffer), "%u.%u.%u.%u", _address.bytes[0], _address.bytes[1], _address.bytes[2], _address.bytes[3]);
+    return String(buffer);
+}
+
+size_t IPAddress::printTo(Print &p) const {
+    return p.print(toString());
+}
+
+size_t HardwareSerial::write(uint8_t c) {
+    return write(&c, 1);
+}
+
+size_t HardwareSerial::write(const uint8_t *buffer, size_t size) {
+    if (_uart != 0) return size;
+    return fwrite(buffer, 1, size, stdout);
+}
+
+void HardwareSerial::flush() {
+    if (_uart == 0) fflush(stdout);
+}
+
+void EspClass::restart() {
+    Serial.println("ESP.restart() called, exiting");
+    Serial.flush();
+
+    quick_exit(0);
+}
+
+uint32_t EspClass::getHeapSize() {
+    return FAKE_HEAP_SIZE;
+}
+
+uint32_t EspClass::getFreeHeap() {
+    return FAKE_FREE_HEAP;
+}
+
+uint32_t EspClass::getMinFreeHeap() {
+    return FAKE_FREE_HEAP;
+}
+
+uint32_t EspClass::getMaxAllocHeap() {
+    return FAKE_FREE_HEAP / 2;
+}
+
+// Certificate is embedded by the ESP32 toolchain from board_build.embed_txtfiles, TLS isn't simulated
+extern "C" const char fake_ssl_cert[] asm("_binary_certs_api_pem_start") = "";
+
+/*
+ * Arduino loop task. Weak, so benchmarks can define their own main() and drive the firmware directly.
+ * FAKE_RUN_SECONDS stops the program after given device time, otherwise it runs until killed.
+ * Exit handlers have to be registered with at_quick_exit().
+ */
+__attribute__((weak)) int main() {
+    const char *run_seconds = getenv("FAKE_RUN_SECONDS");
+    const uint64_t run_until = run_seconds ? (uint64_t) (atof(run_seconds) * 1e6) : FAKE_WAIT_FOREVER;
+
+    setup();
+    while (fake_time_us() < run_until) {
+        loop();
+        delay(1);
+    }
+
+    // Task threads are still running, static destructors would pull objects from under them
+    Serial.flush();
+    quick_exit(0);
+}
@@ -0,0 +1,270 @@
+#pragma once
+
+/*
+ * Arduino-ESP32 API subset for the native build. It's the hardware abstraction boundary of the firmware:
+ * sources are compiled unchanged, and everything below this API is simulated on host.
+ */
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include <algorithm>
+#include <string>
+
+#include "esp_timer.h"
+#include "esp32-hal-ledc.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/event_groups.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+
+typedef uint8_t byte;
+typedef bool boolean;
+typedef uint16_t word;
+
+#define HIGH 0x1
+#define LOW 0x0
+
+#define INPUT 0x01
+#define OUTPUT 0x03
+#define INPUT_PULLUP 0x05
+
+#define DEC 10
+#define HEX 16
+#define OCT 8
+#define BIN 2
+
+#define SERIAL_8N1 0x800001c
+
+#define PROGMEM
+#define PGM_P const char *
+#define PSTR(s) (s)
+#define F(s) (s)
+#define pgm_read_byte(addr) (*(const uint8_t *) (addr))
+#define pgm_read_word(addr) (*(const uint16_t *) (addr))
+
+#define IRAM_ATTR
+#define RTC_DATA_ATTR
+#define RTC_NOINIT_ATTR
+
+using std::isinf;
+using std::isnan;
+using std::max;
+using std::min;
+
+unsigned long millis();
+unsigned long micros();
+void delay(uint32_t ms);
+void delayMicroseconds(uint32_t us);
+void yield();
+
+// GPIO isn't simulated, only pin modes and levels are stored
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t value);
+int digitalRead(uint8_t pin);
+
+void tone(uint8_t pin, unsigned int frequency, unsigned long duration = 0);
+void noTone(uint8_t pin);
+
+long random(long max);
+long random(long min, long max);
+void randomSeed(unsigned long seed);
+uint32_t esp_random();
+
+/*
+ * Text is always kept on the heap like WString does, std::string would keep short one inline
+ * and allocations of String code wouldn't be seen by heap_allocations().
+ */
+class String {
+    std::string _value;
+
+    inline void _keep_on_heap() {
+        if (!_value.empty() && _value.capacity() < sizeof(std::string)) _value.reserve(sizeof(std::string));
+    }
+
+public:
+    String(const char *value = "") : _value(value ? value : "") { _keep_on_heap(); }
+    String(const String &other) : _value(other._value) { _keep_on_heap(); }
+    String(String &&other) = default;
+
+    explicit String(char c) : _value(1, c) { _keep_on_heap(); }
+    explicit String(unsigned char value, unsigned char base = DEC);
+    explicit String(int value, unsigned char base = DEC);
+    explicit String(unsigned int value, unsigned char base = DEC);
+    explicit String(long value, unsigned char base = DEC);
+    explicit String(unsigned long value, unsigned char base = DEC);
+    explicit String(float value, unsigned int decimals = 2);
+    explicit String(double value, unsigned int decimals = 2);
+
+    String &operator=(const String &other) {
+        _value = other._value;
+        _keep_on_heap();
+        return *this;
+    }
+
+    String &operator=(String &&other) = default;
+    String &operator=(const char *value);
+
+    inline const char *c_str() const { return _value.c_str(); }
+    inline unsigned int length() const { return _value.size(); }
+    inline bool isEmpty() const { return _value.empty(); }
+    inline void reserve(unsigned int size) { _value.reserve(size); }
+
+    inline char operator[](unsigned int index) const { return index < _value.size() ? _value[index] : 0; }
+    inline char charAt(unsigned int index) const { return operator[](index); }
+
+    bool concat(const String &other);
+    bool concat(const char *value);
+    bool concat(char c);
+
+    String &operator+=(const String &other);
+    String &operator+=(const char *value);
+    String &operator+=(char c);
+
+    friend String operator+(const String &a, const String &b);
+    friend String operator+(const String &a, const char *b);
+    friend String operator+(const char *a, const String &b);
+    friend String operator+(const String &a, char b);
+
+    inline bool equals(const String &other) const { return _value == other._value; }
+    inline bool equals(const char *value) const { return _value == (value ? value : ""); }
+
+    inline bool operator==(const String &other) const { return equals(other); }
+    inline bool operator==(const char *value) const { return equals(value); }
+    inline bool operator!=(const String &other) const { return !equals(other); }
+    inline bool operator!=(const char *value) const { return !equals(value); }
+    inline bool operator<(const String &other) const { return _value < other._value; }
+
+    int indexOf(char c, unsigned int from = 0) const;
+    int indexOf(const char *value, unsigned int from = 0) const;
+    String substring(unsigned int from) const;
+    String substring(unsigned int from, unsigned int to) const;
+
+    long toInt() const;
+    float toFloat() const;
+    double toDouble() const;
+};
+
+class Print;
+
+class Printable {
+public:
+    virtual ~Printable() = default;
+    virtual size_t printTo(Print &p) const = 0;
+};
+
+class Print {
+    size_t _print_number(unsigned long long value, uint8_t base);
+    size_t _print_signed(long long value, int base);
+    size_t _print_float(double value, uint8_t digits);
+
+public:
+    virtual ~Print() = default;
+
+    virtual size_t write(uint8_t c) = 0;
+    virtual size_t write(const uint8_t *buffer, size_t size);
+    inline size_t write(const char *str) { return str ? write((const uint8_t *) str, strlen(str)) : 0; }
+    inline size_t write(const char *buffer, size_t size) { return write((const uint8_t *) buffer, size); }
+
+    virtual void flush() {}
+
+    size_t printf(const char *format, ...) __attribute__((format(printf, 2, 3)));
+
+    size_t print(const char *str);
+    size_t print(const String &str);
+    size_t print(char c);
+    size_t print(unsigned char value, int base = DEC);
+    size_t print(int value, int base = DEC);
+    size_t print(unsigned int value, int base = DEC);
+    size_t print(long value, int base = DEC);
+    size_t print(unsigned long value, int base = DEC);
+    size_t print(long long value, int base = DEC);
+    size_t print(unsigned long long value, int base = DEC);
+    size_t print(double value, int digits = 2);
+    size_t print(const Printable &value);
+
+    size_t println();
+
+    template<typename T>
+    size_t println(const T &value) { return print(value) + println(); }
+
+    template<typename T>
+    size_t println(const T &value, int format) { return print(value, format) + println(); }
+};
+
+class IPAddress : public Printable {
+    union {
+        uint8_t bytes[4];
+        uint32_t dword;
+    } _address;
+
+public:
+    IPAddress() { _address.dword = 0; }
+    IPAddress(uint32_t address) { _address.dword = address; }
+    IPAddress(uint8_t a, uint8_t b, uint8_t c, uint8_t d) : IPAddress() {
+        _address.bytes[0] = a;
+        _address.bytes[1] = b;
+        _address.bytes[2] = c;
+        _address.bytes[3] = d;
+    }
+
+    inline operator uint32_t() const { return _address.dword; }
+    inline uint8_t operator[](int index) const { return _address.bytes[index]; }
+    inline bool operator==(const IPAddress &other) const { return _address.dword == other._address.dword; }
+
+    String toString() const;
+    size_t printTo(Print &p) const override;
+};
+
+class HardwareSerial : public Print {
+    int _uart;
+
+public:
+    explicit HardwareSerial(int uart) : _uart(uart) {}
+
+    inline int uart() const { return _uart; }
+
+    void begin(unsigned long baud, uint32_t config = 0, int8_t rx = -1, int8_t tx = -1) {}
+    void end() {}
+
+    int available() { return 0; }
+    int read() { return -1; }
+    int peek() { return -1; }
+
+    // Only UART0 is connected to stdout, writes to others are dropped
+    size_t write(uint8_t c) override;
+    size_t write(const uint8_t *buffer, size_t size) override;
+    void flush() override;
+
+    using Print::write;
+
+    operator bool() const { return true; }
+};
+
+extern HardwareSerial Serial;
+
+// Heap isn't measured on host, values are of idle ESP32 for metrics to look sane
+class EspClass {
+public:
+    [[noreturn]] void restart();
+
+    uint32_t getHeapSize();
+    uint32_t getFreeHeap();
+    uint32_t getMinFreeHeap();
+    uint32_t getMaxAllocHeap();
+
+    uint8_t getChipRevision() { return 3; }
+    uint32_t getCpuFreqMHz() { return 240; }
+    uint64_t getEfuseMac() { return 0x0000aabbccddeeffULL; }
+};
+
+extern EspClass ESP;
+
+void setup();
+void loop();
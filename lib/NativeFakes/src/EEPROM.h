@@ -0,0 +1,38 @@
+#pragma once
+
+#include <vector>
+
+#include "Arduino.h"
+
+/*
+ * Flash emulated EEPROM kept in memory.
+ * If FAKE_EEPROM_FILE environment variable is set, content is loaded from it and saved on commit(),
+ * so settings survive restarts like on the device.
+ */
+class EEPROMClass {
+    std::vector<uint8_t> _data;
+
+public:
+    bool begin(size_t size);
+    bool commit();
+    void end() {}
+
+    inline size_t length() const { return _data.size(); }
+
+    inline uint8_t read(int address) const { return address >= 0 && (size_t) address < _data.size() ? _data[address] : 0; }
+    inline void write(int address, uint8_t value) { if (address >= 0 && (size_t) address < _data.size()) _data[address] = value; }
+
+    template<typename T>
+    T &get(int address, T &value) const {
+        if (address >= 0 && address + sizeof(T) <= _data.size()) memcpy((void *) &value, &_data[address], sizeof(T));
+        return value;
+    }
+
+    template<typename T>
+    const T &put(int address, const T &value) {
+        if (address >= 0 && address + sizeof(T) <= _data.size()) memcpy(&_data[address], (const void *) &value, sizeof(T));
+        return value;
+    }
+};
+
+extern EEPROMClass EEPROM;
@@ -0,0 +1,260 @@
+#include "ESPAsyncWebServer.h"
+
+#include <mutex>
+
+// Payload of a single TCP segment, filler callbacks get buffers of this size
+static const size_t FAKE_WEB_SEGMENT_SIZE = 1436;
+
+static std::vector<AsyncWebServer *> servers;
+static std::recursive_mutex web_mutex;
+
+static const String EMPTY_STRING;
+
+size_t AsyncResponseStream::write(uint8_t c) {
+    return write(&c, 1);
+}
+
+size_t AsyncResponseStream::write(const uint8_t *buffer, size_t size) {
+    _body.append((const char *) buffer, size);
+    ++_chunks;
+
+    return size;
+}
+
+AsyncWebServerRequest::AsyncWebServerRequest(WebRequestMethodComposite method, const String &url,
+                                             const std::map<std::string, String> &args,
+                                             const std::map<std::string, String> &headers)
+        : _method(method), _url(url), _args(args), _request_headers(headers) {}
+
+AsyncWebServerRequest::~AsyncWebServerRequest() {
+    for (auto *response : _allocated) delete response;
+}
+
+bool AsyncWebServerRequest::hasArg(const char *name) const {
+    return _args.count(name) > 0;
+}
+
+const String &AsyncWebServerRequest::arg(const char *name) const {
+    auto it = _args.find(name);
+    return it != _args.end() ? it->second : EMPTY_STRING;
+}
+
+bool AsyncWebServerRequest::hasHeader(const char *name) const {
+    return _request_headers.count(name) > 0;
+}
+
+const String &AsyncWebServerRequest::header(const char *name) const {
+    auto it = _request_headers.find(name);
+    return it != _request_headers.end() ? it->second : EMPTY_STRING;
+}
+
+void AsyncWebServerRequest::send(int code, const String &content_type, const String &content) {
+    send(beginResponse(code, content_type, content));
+}
+
+void AsyncWebServerRequest::send(AsyncWebServerResponse *response) {
+    _response = response;
+}
+
+AsyncWebServerResponse *AsyncWebServerRequest::beginResponse(int code, const String &content_type,
+                                                             const String &content) {
+    auto *response = _allocate(new AsyncWebServerResponse(code, content_type));
+    response->_body.assign(content.c_str(), content.length());
+    response->_content_length = content.length();
+
+    return response;
+}
+
+AsyncWebServerResponse *AsyncWebServerRequest::beginResponse(const String &content_type, size_t len,
+                                                             AwsResponseFiller callback) {
+    auto *response = _allocate(new AsyncWebServerResponse(200, content_type));
+    response->_content_length = len;
+    response->_filler = callback;
+
+    return response;
+}
+
+AsyncWebServerResponse *AsyncWebServerRequest::beginChunkedResponse(const String &content_type,
+                                                                    AwsResponseFiller callback) {
+    auto *response = _allocate(new AsyncWebServerResponse(200, content_type));
+    response->_content_length = SIZE_MAX;
+    response->_filler = callback;
+
+    return response;
+}
+
+AsyncWebServerResponse *AsyncWebServerRequest::beginResponse_P(int code, const String &content_type,
+                                                               const uint8_t *content, size_t len) {
+    auto *response = _allocate(new AsyncWebServerResponse(code, content_type));
+    response->_body.assign((const char *) content, len);
+    response->_content_length = len;
+
+    return response;
+}
+
+AsyncResponseStream *AsyncWebServerRequest::beginResponseStream(const String &content_type, size_t) {
+    return _allocate(new AsyncResponseStream(content_type));
+}
+
+FakeWebResponse AsyncWebServerRequest::_collect() {
+    FakeWebResponse result{500, String(), {}, std::string(), 0};
+    if (_response == nullptr) return result;
+
+    result.code = _response->_code;
+    result.content_type = _response->_content_type;
+    result.headers = _response->_headers;
+
+    if (_response->_filler) {
+        std::vector<uint8_t> buffer(FAKE_WEB_SEGMENT_SIZE);
+        size_t index = 0;
+
+        while (index < _response->_content_length) {
+            const size_t max_len = std::min(buffer.size(), _response->_content_length - index);
+            const size_t written = _response->_filler(buffer.data(), max_len, index);
+            if (written == 0) break;
+
+            result.body.append((const char *) buffer.data(), written);
+            index += written;
+            ++result.chunks;
+        }
+    } else {
+        result.body = _response->_body;
+        result.chunks = std::max<size_t>(_response->_chunks, 1);
+    }
+
+    return result;
+}
+
+bool AsyncCallbackWebHandler::canHandle(AsyncWebServerRequest *request) {
+    return (request->method() & _method) && request->url() == _uri;
+}
+
+void AsyncCallbackWebHandler::handleRequest(AsyncWebServerRequest *request) {
+    if (_on_request) _on_request(request);
+}
+
+void AsyncEventSourceClient::send(const char *message, const char *, uint32_t, uint32_t) {
+    if (_connected) _messages.emplace_back(message);
+}
+
+AsyncEventSource::~AsyncEventSource() {
+    close();
+}
+
+void AsyncEventSource::close() {
+    std::lock_guard<std::recursive_mutex> guard(web_mutex);
+    for (auto *client : _clients) delete client;
+
+    _clients.clear();
+}
+
+size_t AsyncEventSource::count() const {
+    std::lock_guard<std::recursive_mutex> guard(web_mutex);
+
+    size_t result = 0;
+    for (auto *client : _clients) {
+        if (client->connected()) ++result;
+    }
+
+    return result;
+}
+
+void AsyncEventSource::send(const char *message, const char *event, uint32_t id, uint32_t reconnect) {
+    std::lock_guard<std::recursive_mutex> guard(web_mutex);
+    for (auto *client : _clients) client->send(message, event, id, reconnect);
+}
+
+bool AsyncEventSource::canHandle(AsyncWebServerRequest *request) {
+    return request->method() == HTTP_GET && request->url() == _url;
+}
+
+AsyncEventSourceClient *AsyncEventSource::_subscribe(AsyncWebServerRequest *request) {
+    std::lock_guard<std::recursive_mutex> guard(web_mutex);
+    if (!filter(request)) return nullptr;
+
+    auto *client = new AsyncEventSourceClient();
+    _clients.push_back(client);
+
+    if (_on_connect) _on_connect(client);
+    return client;
+}
+
+AsyncWebServer::AsyncWebServer(uint16_t port) : _port(port) {
+    std::lock_guard<std::recursive_mutex> guard(web_mutex);
+    servers.push_back(this);
+}
+
+AsyncWebServer::~AsyncWebServer() {
+    std::lock_guard<std::recursive_mutex> guard(web_mutex);
+    servers.erase(std::remove(servers.begin(), servers.end(), this), servers.end());
+}
+
+void AsyncWebServer::begin() {
+    _started = true;
+}
+
+void AsyncWebServer::end() {
+    _started = false;
+}
+
+AsyncCallbackWebHandler &AsyncWebServer::on(const char *uri, WebRequestMethodComposite method,
+                                            ArRequestHandlerFunction on_request) {
+    auto *handler = new AsyncCallbackWebHandler(uri, method, on_request);
+    addHandler(handler);
+
+    return *handler;
+}
+
+AsyncWebHandler &AsyncWebServer::addHandler(AsyncWebHandler *handler) {
+    std::lock_guard<std::recursive_mutex> guard(web_mutex);
+    _handlers.push_back(handler);
+
+    return *handler;
+}
+
+FakeWebResponse fake_web_request(WebRequestMethodComposite method, const char *url,
+                                 const std::map<std::string, String> &args,
+                                 const std::map<std::string, String> &headers) {
+    AsyncWebServerRequest request(method, url, args, headers);
+
+    AsyncWebHandler *target = nullptr;
+    {
+        std::lock_guard<std::recursive_mutex> guard(web_mutex);
+        for (auto *server : servers) {
+            if (!server->_started) continue;
+
+            for (auto *handler : server->_handlers) {
+                if (handler->filter(&request) && handler->canHandle(&request)) {
+                    target = handler;
+                    break;
+                }
+            }
+
+            if (target) break;
+        }
+    }
+
+    if (target == nullptr) {
+        request.send(404);
+    } else {
+        target->handleRequest(&request);
+    }
+
+    return request._collect();
+}
+
+AsyncEventSourceClient *fake_web_subscribe(const char *url) {
+    AsyncWebServerRequest request(HTTP_GET, url, {}, {});
+
+    std::lock_guard<std::recursive_mutex> guard(web_mutex);
+    for (auto *server : servers) {
+        if (!server->_started) continue;
+
+        for (auto *handler : server->_handlers) {
+            auto *source = dynamic_cast<AsyncEventSource *>(handler);
+            if (source && source->canHandle(&request)) return source->_subscribe(&request);
+        }
+    }
+
+    return nullptr;
+}
@@ -0,0 +1,225 @@
+#pragma once
+
+#include <functional>
+#include <map>
+#include <vector>
+
+#include "Arduino.h"
+#include "WiFi.h"
+
+/*
+ * ESPAsyncWebServer without sockets. Registered handlers are called by fake_web_request() in the calling thread
+ * and whole response is collected, filler callbacks are called with TCP segment sized buffers like on the device.
+ * Event sources get subscribers from fake_web_subscribe(), which record what was sent to them.
+ */
+
+typedef enum {
+    HTTP_GET = 0b00000001,
+    HTTP_POST = 0b00000010,
+    HTTP_DELETE = 0b00000100,
+    HTTP_PUT = 0b00001000,
+    HTTP_PATCH = 0b00010000,
+    HTTP_HEAD = 0b00100000,
+    HTTP_OPTIONS = 0b01000000,
+    HTTP_ANY = 0b01111111,
+} WebRequestMethod;
+
+typedef uint8_t WebRequestMethodComposite;
+
+class AsyncWebServerRequest;
+class AsyncEventSourceClient;
+
+typedef std::function<size_t(uint8_t *buffer, size_t max_len, size_t index)> AwsResponseFiller;
+typedef std::function<void(AsyncWebServerRequest *request)> ArRequestHandlerFunction;
+typedef std::function<bool(AsyncWebServerRequest *request)> ArRequestFilterFunction;
+typedef std::function<void(AsyncEventSourceClient *client)> ArEventHandlerFunction;
+
+class AsyncWebServerResponse {
+protected:
+    int _code;
+    String _content_type;
+    std::vector<std::pair<String, String>> _headers;
+    std::string _body;
+    size_t _chunks = 0;
+
+    // Unknown length for chunked responses
+    size_t _content_length;
+    AwsResponseFiller _filler;
+
+    friend class AsyncWebServerRequest;
+
+public:
+    AsyncWebServerResponse(int code, const String &content_type)
+            : _code(code), _content_type(content_type), _content_length(0) {}
+
+    virtual ~AsyncWebServerResponse() = default;
+
+    void setCode(int code) { _code = code; }
+    void setContentType(const String &type) { _content_type = type; }
+    void addHeader(const String &name, const String &value) { _headers.emplace_back(name, value); }
+};
+
+class AsyncResponseStream : public AsyncWebServerResponse, public Print {
+public:
+    explicit AsyncResponseStream(const String &content_type) : AsyncWebServerResponse(200, content_type) {}
+
+    size_t write(uint8_t c) override;
+    size_t write(const uint8_t *buffer, size_t size) override;
+    using Print::write;
+};
+
+struct FakeWebResponse {
+    int code;
+    String content_type;
+    std::vector<std::pair<String, String>> headers;
+    std::string body;
+
+    // Number of filler calls or stream writes it took to produce the body
+    size_t chunks;
+};
+
+class AsyncWebServerRequest {
+    WebRequestMethodComposite _method;
+    String _url;
+    std::map<std::string, String> _args;
+    std::map<std::string, String> _request_headers;
+
+    std::vector<AsyncWebServerResponse *> _allocated;
+    AsyncWebServerResponse *_response = nullptr;
+
+    template<typename T>
+    T *_allocate(T *response) {
+        _allocated.push_back(response);
+        return response;
+    }
+
+public:
+    AsyncWebServerRequest(WebRequestMethodComposite method, const String &url,
+                          const std::map<std::string, String> &args,
+                          const std::map<std::string, String> &headers);
+
+    ~AsyncWebServerRequest();
+
+    AsyncWebServerRequest(const AsyncWebServerRequest &) = delete;
+    AsyncWebServerRequest &operator=(const AsyncWebServerRequest &) = delete;
+
+    inline WebRequestMethodComposite method() const { return _method; }
+    inline const String &url() const { return _url; }
+
+    bool hasArg(const char *name) const;
+    const String &arg(const char *name) const;
+    const String &arg(const String &name) const { return arg(name.c_str()); }
+    size_t args() const { return _args.size(); }
+
+    bool hasHeader(const char *name) const;
+    const String &header(const char *name) const;
+
+    void send(int code, const String &content_type = String(), const String &content = String());
+    void send(AsyncWebServerResponse *response);
+
+    AsyncWebServerResponse *beginResponse(int code, const String &content_type = String(),
+                                          const String &content = String());
+    AsyncWebServerResponse *beginResponse(const String &content_type, size_t len, AwsResponseFiller callback);
+    AsyncWebServerResponse *beginChunkedResponse(const String &content_type, AwsResponseFiller callback);
+    AsyncWebServerResponse *beginResponse_P(int code, const String &content_type, const uint8_t *content, size_t len);
+    AsyncResponseStream *beginResponseStream(const String &content_type, size_t buffer_size = 1460);
+
+    // Runs filler of the sent response and returns what would go to the socket
+    FakeWebResponse _collect();
+};
+
+class AsyncWebHandler {
+protected:
+    ArRequestFilterFunction _filter;
+
+public:
+    virtual ~AsyncWebHandler() = default;
+
+    AsyncWebHandler &setFilter(ArRequestFilterFunction filter) {
+        _filter = filter;
+        return *this;
+    }
+
+    bool filter(AsyncWebServerRequest *request) { return !_filter || _filter(request); }
+
+    virtual bool canHandle(AsyncWebServerRequest *request) { return false; }
+    virtual void handleRequest(AsyncWebServerRequest *request) {}
+};
+
+class AsyncCallbackWebHandler : public AsyncWebHandler {
+    String _uri;
+    WebRequestMethodComposite _method;
+    ArRequestHandlerFunction _on_request;
+
+public:
+    AsyncCallbackWebHandler(const String &uri, WebRequestMethodComposite method, ArRequestHandlerFunction on_request)
+            : _uri(uri), _method(method), _on_request(on_request) {}
+
+    bool canHandle(AsyncWebServerRequest *request) override;
+    void handleRequest(AsyncWebServerRequest *request) override;
+};
+
+class AsyncEventSourceClient {
+    std::vector<String> _messages;
+    bool _connected = true;
+
+public:
+    void send(const char *message, const char *event = nullptr, uint32_t id = 0, uint32_t reconnect = 0);
+    void close() { _connected = false; }
+    bool connected() const { return _connected; }
+
+    inline const std::vector<String> &messages() const { return _messages; }
+};
+
+class AsyncEventSource : public AsyncWebHandler {
+    String _url;
+    std::vector<AsyncEventSourceClient *> _clients;
+    ArEventHandlerFunction _on_connect;
+
+public:
+    explicit AsyncEventSource(const String &url) : _url(url) {}
+    ~AsyncEventSource() override;
+
+    inline const String &url() const { return _url; }
+
+    void onConnect(ArEventHandlerFunction callback) { _on_connect = callback; }
+    void close();
+
+    size_t count() const;
+    void send(const char *message, const char *event = nullptr, uint32_t id = 0, uint32_t reconnect = 0);
+
+    bool canHandle(AsyncWebServerRequest *request) override;
+
+    // Connects new subscriber, nullptr if it was refused by the filter
+    AsyncEventSourceClient *_subscribe(AsyncWebServerRequest *request);
+};
+
+class AsyncWebServer {
+    uint16_t _port;
+    bool _started = false;
+    std::vector<AsyncWebHandler *> _handlers;
+
+    friend FakeWebResponse fake_web_request(WebRequestMethodComposite, const char *,
+                                            const std::map<std::string, String> &,
+                                            const std::map<std::string, String> &);
+
+    friend AsyncEventSourceClient *fake_web_subscribe(const char *);
+
+public:
+    explicit AsyncWebServer(uint16_t port);
+    ~AsyncWebServer();
+
+    void begin();
+    void end();
+
+    AsyncCallbackWebHandler &on(const char *uri, WebRequestMethodComposite method, ArRequestHandlerFunction on_request);
+    AsyncWebHandler &addHandler(AsyncWebHandler *handler);
+};
+
+// Handles request by the first started server and handler which accept it, 404 if none
+FakeWebResponse fake_web_request(WebRequestMethodComposite method, const char *url,
+                                 const std::map<std::string, String> &args = {},
+                                 const std::map<std::string, String> &headers = {});
+
+// Subscribes to event source, returned client is owned by the source
+AsyncEventSourceClient *fake_web_subscribe(const char *url);
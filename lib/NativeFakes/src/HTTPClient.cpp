@@ -0,0 +1,140 @@
+#include "HTTPClient.h"
+
+#include <mutex>
+
+#include "fake_time.h"
+
+static std::mutex http_mutex;
+static FakeHttpServer server = {200, 150, 600};
+static std::vector<FakeHttpRequest> requests;
+
+bool HTTPClient::begin(WiFiClient &, const String &url) {
+    return begin(url);
+}
+
+bool HTTPClient::begin(const String &url) {
+    if (url != _url) _connected = false;
+
+    _url = url;
+    _headers.clear();
+
+    return true;
+}
+
+void HTTPClient::end() {
+    if (!_reuse) _connected = false;
+}
+
+void HTTPClient::addHeader(const String &name, const String &value, bool first, bool replace) {
+    if (replace) {
+        for (auto &header : _headers) {
+            if (header.first == name) {
+                header.second = value;
+                return;
+            }
+        }
+    }
+
+    if (first) {
+        _headers.insert(_headers.begin(), std::make_pair(name, value));
+    } else {
+        _headers.emplace_back(name, value);
+    }
+}
+
+int HTTPClient::_request(const char *method, const uint8_t *payload, size_t size) {
+    if (!WiFi.isConnected()) {
+        _connected = false;
+        return HTTPC_ERROR_CONNECTION_REFUSED;
+    }
+
+    const FakeHttpServer current = fake_http_server();
+    const uint32_t duration = current.latency_ms + (_connected ? 0 : current.handshake_ms);
+
+    if (duration > _timeout) {
+        fake_time_sleep((uint64_t) _timeout * 1000);
+        _connected = false;
+
+        return HTTPC_ERROR_READ_TIMEOUT;
+    }
+
+    fake_time_sleep((uint64_t) duration * 1000);
+    _connected = true;
+
+    FakeHttpRequest request;
+    request.time_us = fake_time_us();
+    request.method = method;
+    request.url = _url;
+    request.headers = _headers;
+
+    std::string body((const char *) payload, size);
+    request.body = body.c_str();
+
+    {
+        std::lock_guard<std::mutex> guard(http_mutex);
+        requests.push_back(request);
+    }
+
+    return current.status;
+}
+
+int HTTPClient::GET() {
+    return _request("GET", nullptr, 0);
+}
+
+int HTTPClient::POST(uint8_t *payload, size_t size) {
+    return _request("POST", payload, size);
+}
+
+int HTTPClient::POST(const String &payload) {
+    return _request("POST", (const uint8_t *) payload.c_str(), payload.length());
+}
+
+String HTTPClient::errorToString(int error) {
+    switch (error) {
+        case HTTPC_ERROR_CONNECTION_REFUSED:
+            return String("connection refused");
+        case HTTPC_ERROR_SEND_HEADER_FAILED:
+            return String("send header failed");
+        case HTTPC_ERROR_SEND_PAYLOAD_FAILED:
+            return String("send payload failed");
+        case HTTPC_ERROR_NOT_CONNECTED:
+            return String("not connected");
+        case HTTPC_ERROR_CONNECTION_LOST:
+            return String("connection lost");
+        case HTTPC_ERROR_NO_STREAM:
+            return String("no stream");
+        case HTTPC_ERROR_NO_HTTP_SERVER:
+            return String("no HTTP server");
+        case HTTPC_ERROR_TOO_LESS_RAM:
+            return String("too less ram");
+        case HTTPC_ERROR_ENCODING:
+            return String("Transfer-Encoding not supported");
+        case HTTPC_ERROR_STREAM_WRITE:
+            return String("Stream write error");
+        case HTTPC_ERROR_READ_TIMEOUT:
+            return String("read Timeout");
+        default:
+            return String();
+    }
+}
+
+FakeHttpServer fake_http_server() {
+    std::lock_guard<std::mutex> guard(http_mutex);
+    return server;
+}
+
+void fake_http_set_server(const FakeHttpServer &value) {
+    std::lock_guard<std::mutex> guard(http_mutex);
+    server = value;
+}
+
+std::vector<FakeHttpRequest> fake_http_requests() {
+    std::lock_guard<std::mutex> guard(http_mutex);
+    return requests;
+}
+
+void fake_http_clear() {
+    std::lock_guard<std::mutex> guard(http_mutex);
+    requests.clear();
+}
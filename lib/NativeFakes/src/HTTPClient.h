@@ -0,0 +1,75 @@
+#pragma once
+
+#include <vector>
+
+#include "Arduino.h"
+#include "WiFi.h"
+#include "WiFiClientSecure.h"
+
+#define HTTPC_ERROR_CONNECTION_REFUSED (-1)
+#define HTTPC_ERROR_SEND_HEADER_FAILED (-2)
+#define HTTPC_ERROR_SEND_PAYLOAD_FAILED (-3)
+#define HTTPC_ERROR_NOT_CONNECTED (-4)
+#define HTTPC_ERROR_CONNECTION_LOST (-5)
+#define HTTPC_ERROR_NO_STREAM (-6)
+#define HTTPC_ERROR_NO_HTTP_SERVER (-7)
+#define HTTPC_ERROR_TOO_LESS_RAM (-8)
+#define HTTPC_ERROR_ENCODING (-9)
+#define HTTPC_ERROR_STREAM_WRITE (-10)
+#define HTTPC_ERROR_READ_TIMEOUT (-11)
+
+/*
+ * HTTP client which doesn't touch the network: requests are recorded and answered with configured status
+ * after configured latency. Without Wi-Fi connection requests fail like on the device.
+ */
+class HTTPClient {
+    String _url;
+    std::vector<std::pair<String, String>> _headers;
+    uint16_t _timeout = 5000;
+    bool _reuse = true;
+    bool _connected = false;
+
+    int _request(const char *method, const uint8_t *payload, size_t size);
+
+public:
+    bool begin(WiFiClient &client, const String &url);
+    bool begin(const String &url);
+    void end();
+
+    void setReuse(bool reuse) { _reuse = reuse; }
+    void setConnectTimeout(int32_t timeout) {}
+    void setTimeout(uint16_t timeout) { _timeout = timeout; }
+
+    void addHeader(const String &name, const String &value, bool first = false, bool replace = true);
+
+    int GET();
+    int POST(uint8_t *payload, size_t size);
+    int POST(const String &payload);
+
+    String getString() { return String(); }
+
+    static String errorToString(int error);
+};
+
+struct FakeHttpRequest {
+    uint64_t time_us;
+
+    String method;
+    String url;
+    std::vector<std::pair<String, String>> headers;
+    String body;
+};
+
+struct FakeHttpServer {
+    int status;
+
+    // Full request time when connection is reused, new connection adds TLS handshake
+    uint32_t latency_ms;
+    uint32_t handshake_ms;
+};
+
+FakeHttpServer fake_http_server();
+void fake_http_set_server(const FakeHttpServer &server);
+
+std::vector<FakeHttpRequest> fake_http_requests();
+void fake_http_clear();
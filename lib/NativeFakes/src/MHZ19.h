@@ -0,0 +1,44 @@
+#pragma once
+
+#include "Arduino.h"
+
+struct FakeMhz19State;
+
+/*
+ * MH-Z19 driver with concentration set by fake_mhz19_set(). Requests block for the time of UART exchange.
+ * Every UART has its own sensor with different default concentration, so zones can be told apart.
+ */
+class MHZ19 {
+    FakeMhz19State *_state;
+
+public:
+    MHZ19();
+
+    // 0 on success, like RESULT_OK of the real driver
+    uint8_t errorCode = 0;
+
+    void begin(HardwareSerial &serial);
+
+    void setRange(int range = 2000);
+    void autoCalibration(bool enabled = true, uint8_t hours = 24) {}
+    void calibrate();
+
+    int getCO2(bool unlimited = true, bool force = true);
+};
+
+struct FakeMhz19State {
+    int co2;
+    int range;
+
+    // Request and response of 9 bytes at 9600 baud plus sensor processing
+    uint32_t request_us;
+
+    uint32_t requests;
+    uint32_t calibrations;
+};
+
+#define FAKE_UART_COUNT 3
+
+// Sensor on UART: 600 ppm on UART2, which the firmware uses by default, 800 ppm on UART1 and 1000 ppm on UART0
+void fake_mhz19_set(int co2, uint8_t uart = 2);
+FakeMhz19State &fake_mhz19(uint8_t uart = 2);
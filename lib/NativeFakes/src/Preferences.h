@@ -0,0 +1,28 @@
+#pragma once
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "Arduino.h"
+
+// NVS namespaces kept in memory for process lifetime, so it starts empty like after flash erase
+class Preferences {
+    std::string _namespace;
+    bool _read_only = false;
+    bool _started = false;
+
+    std::string _key(const char *key) const { return _namespace + "/" + key; }
+
+public:
+    bool begin(const char *name, bool read_only = false);
+    void end();
+
+    bool clear();
+    bool remove(const char *key);
+    bool isKey(const char *key);
+
+    size_t getBytesLength(const char *key);
+    size_t getBytes(const char *key, void *buffer, size_t max_length);
+    size_t putBytes(const char *key, const void *value, size_t length);
+};
@@ -0,0 +1,360 @@
+#include "WiFi.h"
+
+#include <mutex>
+#include <vector>
+
+#include "fake_time.h"
+
+WiFiClass WiFi;
+
+enum FakeWifiStage : uint8_t {
+    STAGE_IDLE,
+    STAGE_ASSOCIATING,
+    STAGE_DHCP,
+};
+
+struct FakeWifiEvent {
+    arduino_event_id_t id;
+    arduino_event_info_t info;
+};
+
+struct FakeWifiHandler {
+    WiFiEventFuncCb callback;
+    arduino_event_id_t event;
+};
+
+static const size_t WIFI_EVENT_QUEUE_LENGTH = 16;
+
+static std::recursive_mutex wifi_mutex;
+
+static FakeAccessPoint access_point = {
+        true,
+        {0x24, 0x4b, 0xfe, 0x01, 0x02, 0x03}, 6, -55,
+        IPAddress(192, 168, 1, 50), IPAddress(192, 168, 1, 1), IPAddress(255, 255, 255, 0), IPAddress(192, 168, 1, 1),
+        2000, 300, 500
+};
+
+static wifi_mode_t wifi_mode = WIFI_OFF;
+static wl_status_t wifi_status = WL_IDLE_STATUS;
+static FakeWifiStage stage = STAGE_IDLE;
+static uint64_t stage_due = 0;
+
+static String target_ssid;
+static bool target_known = false;
+static uint8_t target_bssid[6];
+static int32_t target_channel = 0;
+
+static uint32_t static_ip = 0, static_gateway = 0, static_subnet = 0, static_dns = 0;
+static uint32_t lease_ip = 0, lease_gateway = 0, lease_subnet = 0, lease_dns = 0;
+static uint8_t connected_bssid[6];
+static int32_t connected_channel = 0;
+
+static std::vector<FakeWifiHandler> handlers;
+static QueueHandle_t event_queue = nullptr;
+static esp_timer_handle_t connect_timer = nullptr;
+
+static void _event_task(void *) {
+    FakeWifiEvent event;
+    for (;;) {
+        if (xQueueReceive(event_queue, &event, portMAX_DELAY) != pdTRUE) continue;
+
+        std::vector<FakeWifiHandler> current;
+        {
+            std::lock_guard<std::recursive_mutex> guard(wifi_mutex);
+            current = handlers;
+        }
+
+        for (auto &handler : current) {
+            if (handler.callback && (handler.event == ARDUINO_EVENT_MAX || handler.event == event.id)) {
+                handler.callback(event.id, event.info);
+            }
+        }
+    }
+}
+
+static void _post(arduino_event_id_t id, const arduino_event_info_t &info) {
+    FakeWifiEvent event{id, info};
+
+    // Event loop drops events when its queue is full, waiting here could deadlock with handlers
+    xQueueSend(event_queue, &event, 0);
+}
+
+static void _post_disconnected(uint8_t reason) {
+    arduino_event_info_t info{};
+    info.wifi_sta_disconnected.reason = reason;
+    memcpy(info.wifi_sta_disconnected.bssid, connected_bssid, sizeof(connected_bssid));
+
+    _post(ARDUINO_EVENT_WIFI_STA_DISCONNECTED, info);
+}
+
+static void _schedule(FakeWifiStage next, uint32_t ms) {
+    stage = next;
+    stage_due = fake_time_us() + (uint64_t) ms * 1000;
+
+    esp_timer_stop(connect_timer);
+    esp_timer_start_once(connect_timer, (uint64_t) ms * 1000);
+}
+
+static void _on_connect_timer(void *) {
+    std::lock_guard<std::recursive_mutex> guard(wifi_mutex);
+
+    // Attempt was restarted after the timer has fired
+    if (stage == STAGE_IDLE || fake_time_us() < stage_due) return;
+
+    if (stage == STAGE_ASSOCIATING) {
+        const bool found = access_point.available
+                           && (!target_known || (memcmp(target_bssid, access_point.bssid, 6) == 0
+                                                 && target_channel == access_point.channel));
+
+        if (!found) {
+            stage = STAGE_IDLE;
+            wifi_status = WL_NO_SSID_AVAIL;
+            _post_disconnected(WIFI_REASON_NO_AP_FOUND);
+            return;
+        }
+
+        memcpy(connected_bssid, access_point.bssid, sizeof(connected_bssid));
+        connected_channel = access_point.channel;
+
+        arduino_event_info_t info{};
+        memcpy(info.wifi_sta_connected.bssid, connected_bssid, sizeof(connected_bssid));
+        info.wifi_sta_connected.channel = (uint8_t) connected_channel;
+        _post(ARDUINO_EVENT_WIFI_STA_CONNECTED, info);
+
+        // Static address is applied right away
+        _schedule(STAGE_DHCP, static_ip ? 0 : access_point.dhcp_ms);
+    } else if (stage == STAGE_DHCP) {
+        stage = STAGE_IDLE;
+        wifi_status = WL_CONNECTED;
+
+        if (static_ip) {
+            lease_ip = static_ip;
+            lease_gateway = static_gateway;
+            lease_subnet = static_subnet;
+            lease_dns = static_dns;
+        } else {
+            lease_ip = access_point.ip;
+            lease_gateway = access_point.gateway;
+            lease_subnet = access_point.subnet;
+            lease_dns = access_point.dns;
+        }
+
+        arduino_event_info_t info{};
+        info.got_ip.ip_info.ip = lease_ip;
+        info.got_ip.ip_info.netmask = lease_subnet;
+        info.got_ip.ip_info.gw = lease_gateway;
+        _post(ARDUINO_EVENT_WIFI_STA_GOT_IP, info);
+    }
+}
+
+static void _init() {
+    if (event_queue != nullptr) return;
+
+    event_queue = xQueueCreate(WIFI_EVENT_QUEUE_LENGTH, sizeof(FakeWifiEvent));
+    xTaskCreatePinnedToCore(_event_task, "sys_evt", 4096, nullptr, 20, nullptr, 0);
+
+    esp_timer_create_args_t args{};
+    args.callback = _on_connect_timer;
+    args.name = "fake_wifi";
+    esp_timer_create(&args, &connect_timer);
+}
+
+static void _start_attempt() {
+    wifi_status = WL_DISCONNECTED;
+    lease_ip = 0;
+
+    // Known access point skips the scan
+    _schedule(STAGE_ASSOCIATING, (target_known ? 0 : access_point.scan_ms) + access_point.associate_ms);
+}
+
+wl_status_t WiFiClass::status() {
+    std::lock_guard<std::recursive_mutex> guard(wifi_mutex);
+    return wifi_status;
+}
+
+bool WiFiClass::mode(wifi_mode_t mode) {
+    std::lock_guard<std::recursive_mutex> guard(wifi_mutex);
+    _init();
+
+    if (mode == WIFI_OFF && wifi_mode != WIFI_OFF) WiFi.disconnect();
+    wifi_mode = mode;
+
+    return true;
+}
+
+wifi_mode_t WiFiClass::getMode() {
+    std::lock_guard<std::recursive_mutex> guard(wifi_mutex);
+    return wifi_mode;
+}
+
+wl_status_t WiFiClass::begin(const char *ssid, const char *passphrase, int32_t channel, const uint8_t *bssid,
+                             bool connect) {
+    std::lock_guard<std::recursive_mutex> guard(wifi_mutex);
+    _init();
+
+    if (wifi_mode == WIFI_OFF) wifi_mode = WIFI_STA;
+
+    target_ssid = ssid;
+    target_known = bssid != nullptr && channel > 0;
+    if (target_known) memcpy(target_bssid, bssid, sizeof(target_bssid));
+    target_channel = channel;
+
+    if (connect) _start_attempt();
+    return wifi_status;
+}
+
+bool WiFiClass::config(IPAddress local_ip, IPAddress gateway, IPAddress subnet, IPAddress dns1, IPAddress) {
+    std::lock_guard<std::recursive_mutex> guard(wifi_mutex);
+
+    static_ip = local_ip;
+    static_gateway = gateway;
+    static_subnet = subnet;
+    static_dns = dns1;
+
+    return true;
+}
+
+bool WiFiClass::disconnect(bool wifi_off, bool) {
+    std::lock_guard<std::recursive_mutex> guard(wifi_mutex);
+    _init();
+
+    const bool active = stage != STAGE_IDLE || wifi_status == WL_CONNECTED;
+
+    stage = STAGE_IDLE;
+    esp_timer_stop(connect_timer);
+
+    wifi_status = WL_DISCONNECTED;
+    lease_ip = 0;
+
+    if (active) _post_disconnected(WIFI_REASON_ASSOC_LEAVE);
+    if (wifi_off) wifi_mode = WIFI_OFF;
+
+    return true;
+}
+
+bool WiFiClass::reconnect() {
+    std::lock_guard<std::recursive_mutex> guard(wifi_mutex);
+    if (wifi_mode == WIFI_OFF || target_ssid.isEmpty()) return false;
+
+    if (wifi_status == WL_CONNECTED) disconnect();
+    _start_attempt();
+
+    return true;
+}
+
+bool WiFiClass::isConnected() {
+    return status() == WL_CONNECTED;
+}
+
+bool WiFiClass::setSleep(bool) {
+    return true;
+}
+
+bool WiFiClass::setSleep(wifi_ps_type_t) {
+    return true;
+}
+
+// Driver never reconnects by itself on host
+bool WiFiClass::setAutoReconnect(bool) {
+    return true;
+}
+
+bool WiFiClass::getAutoReconnect() {
+    return false;
+}
+
+wifi_event_id_t WiFiClass::onEvent(WiFiEventFuncCb callback, arduino_event_id_t event) {
+    std::lock_guard<std::recursive_mutex> guard(wifi_mutex);
+    _init();
+
+    handlers.push_back({callback, event});
+    return handlers.size();
+}
+
+void WiFiClass::removeEvent(wifi_event_id_t id) {
+    std::lock_guard<std::recursive_mutex> guard(wifi_mutex);
+    if (id > 0 && id <= handlers.size()) handlers[id - 1].callback = nullptr;
+}
+
+IPAddress WiFiClass::localIP() {
+    std::lock_guard<std::recursive_mutex> guard(wifi_mutex);
+    return lease_ip;
+}
+
+IPAddress WiFiClass::gatewayIP() {
+    std::lock_guard<std::recursive_mutex> guard(wifi_mutex);
+    return lease_ip ? lease_gateway : 0;
+}
+
+IPAddress WiFiClass::subnetMask() {
+    std::lock_guard<std::recursive_mutex> guard(wifi_mutex);
+    return lease_ip ? lease_subnet : 0;
+}
+
+IPAddress WiFiClass::dnsIP(uint8_t) {
+    std::lock_guard<std::recursive_mutex> guard(wifi_mutex);
+    return lease_ip ? lease_dns : 0;
+}
+
+int8_t WiFiClass::RSSI() {
+    std::lock_guard<std::recursive_mutex> guard(wifi_mutex);
+    return wifi_status == WL_CONNECTED ? access_point.rssi : 0;
+}
+
+uint8_t *WiFiClass::BSSID() {
+    return connected_bssid;
+}
+
+String WiFiClass::BSSIDstr() {
+    char buffer[18];
+    snprintf(buffer, sizeof(buffer), "%02X:%02X:%02X:%02X:%02X:%02X", connected_bssid[0], connected_bssid[1],
+             connected_bssid[2], connected_bssid[3], connected_bssid[4], connected_bssid[5]);
+
+    return String(buffer);
+}
+
+int32_t WiFiClass::channel() {
+    std::lock_guard<std::recursive_mutex> guard(wifi_mutex);
+    return connected_channel;
+}
+
+String WiFiClass::SSID() {
+    std::lock_guard<std::recursive_mutex> guard(wifi_mutex);
+    return target_ssid;
+}
+
+String WiFiClass::macAddress() {
+    return String("AA:BB:CC:DD:EE:FF");
+}
+
+// No DNS on host, every name resolves to the gateway
+int WiFiClass::hostByName(const char *, IPAddress &result) {
+    std::lock_guard<std::recursive_mutex> guard(wifi_mutex);
+    if (wifi_status != WL_CONNECTED) return 0;
+
+    result = lease_gateway;
+    return 1;
+}
+
+FakeAccessPoint fake_wifi_access_point() {
+    std::lock_guard<std::recursive_mutex> guard(wifi_mutex);
+    return access_point;
+}
+
+void fake_wifi_set_access_point(const FakeAccessPoint &value) {
+    std::lock_guard<std::recursive_mutex> guard(wifi_mutex);
+    access_point = value;
+
+    if (!access_point.available && wifi_status == WL_CONNECTED) {
+        wifi_status = WL_CONNECTION_LOST;
+        lease_ip = 0;
+        _post_disconnected(WIFI_REASON_BEACON_TIMEOUT);
+    }
+}
+
+void fake_wifi_set_available(bool available) {
+    FakeAccessPoint value = fake_wifi_access_point();
+    value.available = available;
+
+    fake_wifi_set_access_point(value);
+}
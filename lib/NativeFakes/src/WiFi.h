@@ -0,0 +1,148 @@
+#pragma once
+
+#include <functional>
+
+#include "Arduino.h"
+#include "WiFiClient.h"
+
+/*
+ * Station mode Wi-Fi with simulated access point. Connection goes through scan, association and DHCP,
+ * each taking configured device time, and events are delivered from a separate task like from the ESP32 event loop.
+ * Connection with known BSSID and channel skips the scan, static IP skips DHCP.
+ */
+
+typedef enum {
+    WL_NO_SHIELD = 255,
+    WL_IDLE_STATUS = 0,
+    WL_NO_SSID_AVAIL,
+    WL_SCAN_COMPLETED,
+    WL_CONNECTED,
+    WL_CONNECT_FAILED,
+    WL_CONNECTION_LOST,
+    WL_DISCONNECTED,
+} wl_status_t;
+
+typedef enum {
+    WIFI_OFF = 0,
+    WIFI_STA,
+    WIFI_AP,
+    WIFI_AP_STA,
+} wifi_mode_t;
+
+typedef enum {
+    WIFI_PS_NONE,
+    WIFI_PS_MIN_MODEM,
+    WIFI_PS_MAX_MODEM,
+} wifi_ps_type_t;
+
+typedef enum {
+    ARDUINO_EVENT_WIFI_READY = 0,
+    ARDUINO_EVENT_WIFI_SCAN_DONE,
+    ARDUINO_EVENT_WIFI_STA_START,
+    ARDUINO_EVENT_WIFI_STA_STOP,
+    ARDUINO_EVENT_WIFI_STA_CONNECTED,
+    ARDUINO_EVENT_WIFI_STA_DISCONNECTED,
+    ARDUINO_EVENT_WIFI_STA_AUTHMODE_CHANGE,
+    ARDUINO_EVENT_WIFI_STA_GOT_IP,
+    ARDUINO_EVENT_WIFI_STA_GOT_IP6,
+    ARDUINO_EVENT_WIFI_STA_LOST_IP,
+    ARDUINO_EVENT_MAX
+} arduino_event_id_t;
+
+#define WIFI_REASON_ASSOC_LEAVE 8
+#define WIFI_REASON_BEACON_TIMEOUT 200
+#define WIFI_REASON_NO_AP_FOUND 201
+#define WIFI_REASON_AUTH_FAIL 202
+
+typedef union {
+    struct {
+        uint8_t ssid[32];
+        uint8_t ssid_len;
+        uint8_t bssid[6];
+        uint8_t reason;
+    } wifi_sta_disconnected;
+
+    struct {
+        uint8_t ssid[32];
+        uint8_t ssid_len;
+        uint8_t bssid[6];
+        uint8_t channel;
+    } wifi_sta_connected;
+
+    struct {
+        struct {
+            uint32_t ip;
+            uint32_t netmask;
+            uint32_t gw;
+        } ip_info;
+    } got_ip;
+} arduino_event_info_t;
+
+typedef arduino_event_id_t WiFiEvent_t;
+typedef arduino_event_info_t WiFiEventInfo_t;
+typedef std::function<void(arduino_event_id_t event, arduino_event_info_t info)> WiFiEventFuncCb;
+typedef size_t wifi_event_id_t;
+
+class WiFiClass {
+public:
+    static wl_status_t status();
+    static bool mode(wifi_mode_t mode);
+    static wifi_mode_t getMode();
+
+    wl_status_t begin(const char *ssid, const char *passphrase = nullptr, int32_t channel = 0,
+                      const uint8_t *bssid = nullptr, bool connect = true);
+
+    bool config(IPAddress local_ip, IPAddress gateway, IPAddress subnet,
+                IPAddress dns1 = (uint32_t) 0, IPAddress dns2 = (uint32_t) 0);
+
+    bool disconnect(bool wifi_off = false, bool erase_ap = false);
+    bool reconnect();
+    bool isConnected();
+
+    bool setSleep(bool enabled);
+    bool setSleep(wifi_ps_type_t type);
+    bool setAutoReconnect(bool enabled);
+    bool getAutoReconnect();
+
+    wifi_event_id_t onEvent(WiFiEventFuncCb callback, arduino_event_id_t event = ARDUINO_EVENT_MAX);
+    void removeEvent(wifi_event_id_t id);
+
+    IPAddress localIP();
+    IPAddress gatewayIP();
+    IPAddress subnetMask();
+    IPAddress dnsIP(uint8_t index = 0);
+
+    int8_t RSSI();
+    uint8_t *BSSID();
+    String BSSIDstr();
+    int32_t channel();
+    String SSID();
+    String macAddress();
+
+    int hostByName(const char *host, IPAddress &result);
+};
+
+extern WiFiClass WiFi;
+
+struct FakeAccessPoint {
+    bool available;
+
+    uint8_t bssid[6];
+    int32_t channel;
+    int8_t rssi;
+
+    // Lease given by DHCP
+    uint32_t ip;
+    uint32_t gateway;
+    uint32_t subnet;
+    uint32_t dns;
+
+    uint32_t scan_ms;
+    uint32_t associate_ms;
+    uint32_t dhcp_ms;
+};
+
+// Changes are applied to the next connection attempt. Unavailable access point drops current connection
+FakeAccessPoint fake_wifi_access_point();
+void fake_wifi_set_access_point(const FakeAccessPoint &access_point);
+void fake_wifi_set_available(bool available);
@@ -0,0 +1,119 @@
+#include "WiFiClient.h"
+
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "WiFi.h"
+
+int WiFiClient::connect(IPAddress ip, uint16_t port) {
+    return connect(ip.toString().c_str(), port);
+}
+
+int WiFiClient::connect(const char *host, uint16_t port) {
+    stop();
+    if (WiFiClass::status() != WL_CONNECTED) return 0;
+
+    addrinfo hints{};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+
+    char service[8];
+    snprintf(service, sizeof(service), "%u", port);
+
+    addrinfo *addresses = nullptr;
+    if (getaddrinfo(host, service, &hints, &addresses) != 0) return 0;
+
+    for (auto *address = addresses; address != nullptr; address = address->ai_next) {
+        const int fd = socket(address->ai_family, address->ai_socktype, address->ai_protocol);
+        if (fd < 0) continue;
+
+        if (::connect(fd, address->ai_addr, address->ai_addrlen) == 0) {
+            _fd = fd;
+            break;
+        }
+
+        close(fd);
+    }
+
+    freeaddrinfo(addresses);
+    return _fd >= 0 ? 1 : 0;
+}
+
+size_t WiFiClient::write(const uint8_t *buffer, size_t size) {
+    if (_fd < 0) return 0;
+
+    size_t written = 0;
+    while (written < size) {
+        const auto result = send(_fd, buffer + written, size - written, MSG_NOSIGNAL);
+        if (result <= 0) {
+            stop();
+            break;
+        }
+
+        written += result;
+    }
+
+    return written;
+}
+
+int WiFiClient::available() {
+    if (_fd < 0) return 0;
+
+    int count = 0;
+    if (ioctl(_fd, FIONREAD, &count) < 0) return 0;
+
+    return count;
+}
+
+int WiFiClient::read() {
+    uint8_t c;
+    return read(&c, 1) == 1 ? c : -1;
+}
+
+int WiFiClient::read(uint8_t *buffer, size_t size) {
+    if (_fd < 0) return -1;
+
+    const auto result = recv(_fd, buffer, size, MSG_DONTWAIT);
+    if (result == 0) stop();
+
+    return result > 0 ? (int) result : -1;
+}
+
+int WiFiClient::peek() {
+    if (_fd < 0) return -1;
+
+    uint8_t c;
+    return recv(_fd, &c, 1, MSG_DONTWAIT | MSG_PEEK) == 1 ? c : -1;
+}
+
+// Closed by peer when socket is readable without data
+uint8_t WiFiClient::connected() {
+    if (_fd < 0) return 0;
+    if (available() > 0) return 1;
+
+    uint8_t c;
+    if (recv(_fd, &c, 1, MSG_DONTWAIT | MSG_PEEK) == 0) {
+        stop();
+        return 0;
+    }
+
+    return 1;
+}
+
+void WiFiClient::stop() {
+    if (_fd < 0) return;
+
+    close(_fd);
+    _fd = -1;
+}
+
+int WiFiClient::setNoDelay(bool nodelay) {
+    if (_fd < 0) return -1;
+
+    int value = nodelay ? 1 : 0;
+    return setsockopt(_fd, IPPROTO_TCP, TCP_NODELAY, &value, sizeof(value));
+}
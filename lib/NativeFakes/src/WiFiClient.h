@@ -0,0 +1,40 @@
+#pragma once
+
+#include "Arduino.h"
+
+/*
+ * Plain TCP connection of the host, so protocols the firmware implements itself (like MQTT) can talk to local servers.
+ * There is no TLS, WiFiClientSecure connects in plain text. Without Wi-Fi connection connect() fails like on the device.
+ * HTTPClient is faked on its own level and doesn't use it.
+ */
+class WiFiClient : public Print {
+    int _fd = -1;
+
+public:
+    WiFiClient() = default;
+    WiFiClient(const WiFiClient &) = delete;
+    WiFiClient &operator=(const WiFiClient &) = delete;
+
+    ~WiFiClient() override { stop(); }
+
+    virtual int connect(IPAddress ip, uint16_t port);
+    virtual int connect(const char *host, uint16_t port);
+    virtual int connect(const char *host, uint16_t port, int32_t timeout) { return connect(host, port); }
+
+    size_t write(uint8_t c) override { return write(&c, 1); }
+    size_t write(const uint8_t *buffer, size_t size) override;
+    using Print::write;
+
+    virtual int available();
+    virtual int read();
+    virtual int read(uint8_t *buffer, size_t size);
+    virtual int peek();
+
+    virtual uint8_t connected();
+    virtual void stop();
+
+    void setTimeout(uint32_t seconds) {}
+    int setNoDelay(bool nodelay);
+
+    virtual operator bool() { return connected(); }
+};
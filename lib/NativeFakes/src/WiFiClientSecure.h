@@ -0,0 +1,10 @@
+#pragma once
+
+#include "WiFiClient.h"
+
+class WiFiClientSecure : public WiFiClient {
+public:
+    void setCACert(const char *root_ca) {}
+    void setInsecure() {}
+    void setHandshakeTimeout(unsigned long timeout) {}
+};
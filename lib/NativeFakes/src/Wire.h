@@ -0,0 +1,18 @@
+#pragma once
+
+#include "Arduino.h"
+
+// I2C bus isn't simulated, sensors are faked on driver level
+class TwoWire {
+    uint8_t _bus;
+
+public:
+    explicit TwoWire(uint8_t bus) : _bus(bus) {}
+
+    inline uint8_t bus() const { return _bus; }
+
+    bool begin(int sda = -1, int scl = -1, uint32_t frequency = 0) { return true; }
+    void end() {}
+};
+
+extern TwoWire Wire;
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <stdint.h>
+
+/*
+ * LEDC channels are simulated as state only, it's exposed for checks of what the firmware plays.
+ */
+
+#define LEDC_CHANNELS 16
+
+double ledcSetup(uint8_t channel, double frequency, uint8_t resolution_bits);
+void ledcWrite(uint8_t channel, uint32_t duty);
+double ledcWriteTone(uint8_t channel, double frequency);
+uint32_t ledcRead(uint8_t channel);
+double ledcReadFreq(uint8_t channel);
+void ledcAttachPin(uint8_t pin, uint8_t channel);
+void ledcDetachPin(uint8_t pin);
+
+struct FakeLedcChannel {
+    int16_t pin;
+    uint8_t resolution_bits;
+
+    double frequency;
+    uint32_t duty;
+
+    // Number of ledcWriteTone() calls with non-zero frequency
+    uint32_t tones;
+};
+
+const FakeLedcChannel &fake_ledc_channel(uint8_t channel);
@@ -0,0 +1,16 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "esp_timer.h"
+
+/*
+ * Light sleep passes the time on fake clock. Deep sleep resets the chip, on host the process exits,
+ * RTC memory isn't preserved.
+ */
+
+esp_err_t esp_sleep_enable_timer_wakeup(uint64_t time_us);
+
+esp_err_t esp_light_sleep_start();
+
+[[noreturn]] void esp_deep_sleep_start();
@@ -0,0 +1,14 @@
+#pragma once
+
+#include "esp_timer.h"
+#include "freertos/task.h"
+
+// Tasks can't be interrupted on host, so watchdog is not implemented
+
+inline esp_err_t esp_task_wdt_init(uint32_t, bool) { return ESP_OK; }
+
+inline esp_err_t esp_task_wdt_add(TaskHandle_t) { return ESP_OK; }
+
+inline esp_err_t esp_task_wdt_delete(TaskHandle_t) { return ESP_OK; }
+
+inline esp_err_t esp_task_wdt_reset() { return ESP_OK; }
@@ -0,0 +1,142 @@
+#include "esp_timer.h"
+
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+#include "fake_time.h"
+#include "freertos/task.h"
+
+struct esp_timer {
+    esp_timer_cb_t callback;
+    void *arg;
+
+    bool active;
+    uint64_t deadline;
+    uint64_t period;
+};
+
+static std::vector<esp_timer *> timers;
+
+// Incremented on every change, so dispatcher recalculates its deadline
+static uint32_t timers_generation = 0;
+
+static void _dispatch(void *) {
+    std::vector<esp_timer *> due;
+
+    std::unique_lock<std::mutex> lock(fake_kernel_mutex());
+    for (;;) {
+        const uint32_t generation = timers_generation;
+
+        uint64_t next = FAKE_WAIT_FOREVER;
+        for (auto *timer : timers) {
+            if (timer->active) next = std::min(next, timer->deadline);
+        }
+
+        if (next != FAKE_WAIT_FOREVER) {
+            const uint64_t now = fake_time_us();
+            next = next > now ? next - now : 0;
+        }
+
+        fake_kernel_wait(lock, next, [generation] { return timers_generation != generation; });
+
+        const uint64_t now = fake_time_us();
+        due.clear();
+        for (auto *timer : timers) {
+            if (!timer->active || timer->deadline > now) continue;
+
+            due.push_back(timer);
+            if (timer->period) {
+                timer->deadline = std::max(timer->deadline + timer->period, now);
+            } else {
+                timer->active = false;
+            }
+        }
+
+        std::sort(due.begin(), due.end(), [](const esp_timer *a, const esp_timer *b) { return a->deadline < b->deadline; });
+
+        // Callbacks can start and stop timers
+        lock.unlock();
+        for (auto *timer : due) timer->callback(timer->arg);
+        lock.lock();
+    }
+}
+
+static void _changed() {
+    ++timers_generation;
+}
+
+esp_err_t esp_timer_create(const esp_timer_create_args_t *args, esp_timer_handle_t *handle) {
+    if (args == nullptr || args->callback == nullptr || handle == nullptr) return ESP_ERR_INVALID_ARG;
+
+    // Timers are created from static initializers as well, so dispatcher is started on demand
+    static std::once_flag dispatcher_started;
+    std::call_once(dispatcher_started, [] {
+        xTaskCreatePinnedToCore(_dispatch, "esp_timer", 4096, nullptr, 22, nullptr, 0);
+    });
+
+    auto *timer = new esp_timer{args->callback, args->arg, false, 0, 0};
+    {
+        std::lock_guard<std::mutex> guard(fake_kernel_mutex());
+        timers.push_back(timer);
+        _changed();
+    }
+
+    *handle = timer;
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_delete(esp_timer_handle_t timer) {
+    {
+        std::lock_guard<std::mutex> guard(fake_kernel_mutex());
+        if (timer->active) return ESP_ERR_INVALID_STATE;
+
+        timers.erase(std::remove(timers.begin(), timers.end(), timer), timers.end());
+        _changed();
+    }
+
+    delete timer;
+    return ESP_OK;
+}
+
+static esp_err_t _start(esp_timer_handle_t timer, uint64_t timeout_us, uint64_t period_us) {
+    {
+        std::lock_guard<std::mutex> guard(fake_kernel_mutex());
+        if (timer->active) return ESP_ERR_INVALID_STATE;
+
+        timer->active = true;
+        timer->deadline = fake_time_us() + timeout_us;
+        timer->period = period_us;
+        _changed();
+    }
+
+    fake_kernel_notify();
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_start_once(esp_timer_handle_t timer, uint64_t timeout_us) {
+    return _start(timer, timeout_us, 0);
+}
+
+esp_err_t esp_timer_start_periodic(esp_timer_handle_t timer, uint64_t period_us) {
+    return _start(timer, period_us, period_us);
+}
+
+esp_err_t esp_timer_stop(esp_timer_handle_t timer) {
+    std::lock_guard<std::mutex> guard(fake_kernel_mutex());
+    if (!timer->active) return ESP_ERR_INVALID_STATE;
+
+    timer->active = false;
+    _changed();
+
+    return ESP_OK;
+}
+
+bool esp_timer_is_active(esp_timer_handle_t timer) {
+    std::lock_guard<std::mutex> guard(fake_kernel_mutex());
+    return timer->active;
+}
+
+int64_t esp_timer_get_time() {
+    return (int64_t) fake_time_us();
+}
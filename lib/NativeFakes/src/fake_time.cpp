@@ -0,0 +1,183 @@
+#include "fake_time.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <list>
+
+typedef std::chrono::steady_clock RealClock;
+
+struct FakeWaiter {
+    uint64_t deadline;
+    const std::function<bool()> *pred;
+};
+
+static std::mutex clock_mutex;
+
+
+// Device time is base_us plus real time since base_real multiplied by speed
+static uint64_t base_us = 0;
+static RealClock::time_point base_real;
+
+// Negative until the clock is started by the first call, which can come from static initializers
+static double speed = -1;
+
+// Guarded by kernel lock. Main thread is running from the start
+static int running_threads = 1;
+
+/*
+ * Created on first use, as kernel objects are used by static initializers of the firmware.
+ * Never destroyed: detached task threads still wait on them while static destructors run at exit.
+ */
+std::mutex &fake_kernel_mutex() {
+    static auto *mutex = new std::mutex();
+    return *mutex;
+}
+
+static std::condition_variable &_kernel_cv() {
+    static auto *cv = new std::condition_variable();
+    return *cv;
+}
+
+static std::list<FakeWaiter> &_waiters() {
+    static auto *waiters = new std::list<FakeWaiter>();
+    return *waiters;
+}
+
+static void _start_locked() {
+    if (speed >= 0) return;
+
+    const char *value = getenv("FAKE_TIME_SPEED");
+    speed = value ? atof(value) : 1.0;
+    base_real = RealClock::now();
+}
+
+static uint64_t _now_locked() {
+    _start_locked();
+    if (speed == 0) return base_us;
+
+    const auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(RealClock::now() - base_real).count();
+    return base_us + (uint64_t) ((double) elapsed * speed);
+}
+
+void fake_time_set_speed(double value) {
+    {
+        std::lock_guard<std::mutex> guard(clock_mutex);
+        base_us = _now_locked();
+        base_real = RealClock::now();
+        speed = value > 0 ? value : 0;
+    }
+
+    fake_kernel_notify();
+}
+
+double fake_time_speed() {
+    std::lock_guard<std::mutex> guard(clock_mutex);
+    _start_locked();
+
+    return speed;
+}
+
+uint64_t fake_time_us() {
+    std::lock_guard<std::mutex> guard(clock_mutex);
+    return _now_locked();
+}
+
+void fake_time_advance(uint64_t us) {
+    {
+        std::lock_guard<std::mutex> guard(clock_mutex);
+        base_us += us;
+    }
+
+    fake_kernel_notify();
+}
+
+void fake_time_sleep(uint64_t us) {
+    std::unique_lock<std::mutex> lock(fake_kernel_mutex());
+    fake_kernel_wait(lock, us, [] { return false; });
+}
+
+
+void fake_kernel_notify() {
+    std::lock_guard<std::mutex> guard(fake_kernel_mutex());
+    _kernel_cv().notify_all();
+}
+
+void fake_thread_started() {
+    std::lock_guard<std::mutex> guard(fake_kernel_mutex());
+    ++running_threads;
+}
+
+void fake_thread_finished() {
+    std::lock_guard<std::mutex> guard(fake_kernel_mutex());
+    --running_threads;
+
+    _kernel_cv().notify_all();
+}
+
+/*
+ * Stopped clock jumps to the nearest deadline when no thread can make progress: all are waiting
+ * and nobody's condition is met. Otherwise time would pass while someone is still busy.
+ */
+static void _skip_idle_time() {
+    auto &waiters = _waiters();
+    if (running_threads > 0 || waiters.empty()) return;
+
+    uint64_t next = FAKE_WAIT_FOREVER;
+    for (auto &waiter : waiters) {
+        if ((*waiter.pred)()) return;
+        next = std::min(next, waiter.deadline);
+    }
+
+    if (next == FAKE_WAIT_FOREVER) return;
+
+    {
+        std::lock_guard<std::mutex> guard(clock_mutex);
+        if (speed == 0 && next > base_us) base_us = next;
+    }
+
+    // Woken threads run when the caller releases the lock
+    _kernel_cv().notify_all();
+}
+
+bool fake_kernel_wait(std::unique_lock<std::mutex> &lock, uint64_t timeout_us, const std::function<bool()> &pred) {
+    if (pred()) return true;
+
+    const uint64_t start = fake_time_us();
+    const uint64_t deadline = timeout_us == FAKE_WAIT_FOREVER ? FAKE_WAIT_FOREVER : start + timeout_us;
+
+    auto &waiters = _waiters();
+    auto waiter = waiters.insert(waiters.end(), FakeWaiter{deadline, &pred});
+    --running_threads;
+
+    bool result;
+    for (;;) {
+        if (pred()) {
+            result = true;
+            break;
+        }
+
+        const uint64_t now = fake_time_us();
+        if (now >= deadline) {
+            result = false;
+            break;
+        }
+
+        // Speed can change while waiting, so real timeout is only a hint and the clock is checked again
+        const double current_speed = fake_time_speed();
+        if (current_speed == 0) {
+            _skip_idle_time();
+            if (fake_time_us() < deadline) _kernel_cv().wait(lock);
+        } else if (deadline == FAKE_WAIT_FOREVER) {
+            _kernel_cv().wait(lock);
+        } else {
+            const auto real_us = (uint64_t) ((double) (deadline - now) / current_speed) + 1;
+            _kernel_cv().wait_for(lock, std::chrono::microseconds(real_us));
+        }
+    }
+
+    waiters.erase(waiter);
+    ++running_threads;
+
+    return result;
+}
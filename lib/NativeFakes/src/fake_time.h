@@ -0,0 +1,42 @@
+#pragma once
+
+#include <stdint.h>
+#include <functional>
+#include <mutex>
+
+/*
+ * Device clock of the native build. Everything time related in the fakes (millis(), delay(), FreeRTOS timeouts,
+ * esp_timer) uses it, so device time can run faster than real time or be stepped manually.
+ *
+ * With speed 0 the clock stands still while any task is running and jumps to the nearest timeout when all of them
+ * are waiting, so firmware runs as fast as host can execute it and runs are repeatable.
+ * It can also be moved explicitly by fake_time_advance().
+ */
+
+const uint64_t FAKE_WAIT_FOREVER = UINT64_MAX;
+
+// Speed relative to real time, 1 by default or FAKE_TIME_SPEED environment variable
+void fake_time_set_speed(double speed);
+double fake_time_speed();
+
+// Microseconds since start
+uint64_t fake_time_us();
+void fake_time_advance(uint64_t us);
+
+// Blocks the caller for given device time
+void fake_time_sleep(uint64_t us);
+
+/*
+ * All fake kernel objects (queues, semaphores, event groups, timers) share a single lock and condition variable,
+ * like a single-core scheduler. Every state change and every move of the clock wakes all waiters.
+ */
+std::mutex &fake_kernel_mutex();
+
+void fake_kernel_notify();
+
+// Threads which run firmware code, i.e. FreeRTOS tasks, are counted to know when all of them are idle
+void fake_thread_started();
+void fake_thread_finished();
+
+// Waits with kernel lock held until predicate is true or timeout of device time has passed
+bool fake_kernel_wait(std::unique_lock<std::mutex> &lock, uint64_t timeout_us, const std::function<bool()> &pred);
@@ -0,0 +1,332 @@
+#include "freertos/FreeRTOS.h"
+#include "freertos/event_groups.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+
+#include <algorithm>
+#include <cstring>
+#include <deque>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "fake_time.h"
+
+struct FakeTask {
+    std::string name;
+    uint32_t stack_depth;
+    BaseType_t core;
+
+    uint32_t notifications;
+};
+
+struct FakeQueue {
+    size_t length;
+    size_t item_size;
+
+    std::deque<std::vector<uint8_t>> items;
+};
+
+struct FakeSemaphore {
+    UBaseType_t max_count;
+    UBaseType_t count;
+};
+
+struct FakeEventGroup {
+    EventBits_t bits;
+};
+
+// Thrown by vTaskDelete() to unwind the task thread
+struct FakeTaskExit {
+};
+
+static std::vector<FakeTask *> tasks;
+static thread_local FakeTask *current_task = nullptr;
+
+static std::recursive_mutex critical_mutex;
+
+static uint64_t _ticks_to_us(TickType_t ticks) {
+    return ticks == portMAX_DELAY ? FAKE_WAIT_FOREVER : (uint64_t) ticks * portTICK_PERIOD_MS * 1000;
+}
+
+static FakeTask *_register_task(const char *name, uint32_t stack_depth, BaseType_t core) {
+    auto *task = new FakeTask{name, stack_depth, core, 0};
+
+    std::lock_guard<std::mutex> guard(fake_kernel_mutex());
+    tasks.push_back(task);
+
+    return task;
+}
+
+static FakeTask *_current_task() {
+    // Threads not created by xTaskCreate(), i.e. main thread, are the Arduino loop task
+    if (current_task == nullptr) current_task = _register_task("loopTask", 8192, 1);
+    return current_task;
+}
+
+void vPortEnterCritical(portMUX_TYPE *) {
+    critical_mutex.lock();
+}
+
+void vPortExitCritical(portMUX_TYPE *) {
+    critical_mutex.unlock();
+}
+
+BaseType_t xPortGetCoreID() {
+    return _current_task()->core;
+}
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t fn, const char *name, uint32_t stack_depth, void *param,
+                                   UBaseType_t, TaskHandle_t *handle, BaseType_t core) {
+    FakeTask *task = _register_task(name, stack_depth, core < 0 || core >= portNUM_PROCESSORS ? 0 : core);
+    if (handle) *handle = task;
+
+    // Counted before the thread starts, so stopped clock doesn't jump while it's being created
+    fake_thread_started();
+    std::thread([fn, param, task]() {
+        current_task = task;
+
+        try {
+            fn(param);
+        } catch (const FakeTaskExit &) {}
+
+        fake_thread_finished();
+    }).detach();
+
+    return pdPASS;
+}
+
+BaseType_t xTaskCreate(TaskFunction_t fn, const char *name, uint32_t stack_depth, void *param,
+                       UBaseType_t priority, TaskHandle_t *handle) {
+    return xTaskCreatePinnedToCore(fn, name, stack_depth, param, priority, handle, 0);
+}
+
+void vTaskDelete(TaskHandle_t task) {
+    FakeTask *self = _current_task();
+    if (task != nullptr && task != self) return;
+
+    {
+        std::lock_guard<std::mutex> guard(fake_kernel_mutex());
+        tasks.erase(std::remove(tasks.begin(), tasks.end(), self), tasks.end());
+    }
+
+    // Handle may still be used by others, so it's never freed
+    throw FakeTaskExit();
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle() {
+    return _current_task();
+}
+
+TaskHandle_t xTaskGetHandle(const char *name) {
+    std::lock_guard<std::mutex> guard(fake_kernel_mutex());
+    for (auto *task : tasks) {
+        if (task->name == name) return task;
+    }
+
+    return nullptr;
+}
+
+const char *pcTaskGetName(TaskHandle_t task) {
+    return (task ? task : _current_task())->name.c_str();
+}
+
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t task) {
+    return (task ? task : _current_task())->stack_depth;
+}
+
+void vTaskDelay(TickType_t ticks) {
+    fake_time_sleep(_ticks_to_us(ticks));
+}
+
+TickType_t xTaskGetTickCount() {
+    return (TickType_t) (fake_time_us() / 1000 / portTICK_PERIOD_MS);
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t task) {
+    {
+        std::lock_guard<std::mutex> guard(fake_kernel_mutex());
+        ++task->notifications;
+    }
+
+    fake_kernel_notify();
+    return pdPASS;
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clear, TickType_t timeout) {
+    FakeTask *self = _current_task();
+
+    std::unique_lock<std::mutex> lock(fake_kernel_mutex());
+    if (!fake_kernel_wait(lock, _ticks_to_us(timeout), [self] { return self->notifications > 0; })) return 0;
+
+    const uint32_t value = self->notifications;
+    self->notifications = clear ? 0 : value - 1;
+
+    return value;
+}
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t item_size) {
+    return new FakeQueue{length, item_size, {}};
+}
+
+void vQueueDelete(QueueHandle_t queue) {
+    delete queue;
+}
+
+static BaseType_t _queue_send(QueueHandle_t queue, const void *item, TickType_t timeout, bool front) {
+    {
+        std::unique_lock<std::mutex> lock(fake_kernel_mutex());
+        if (!fake_kernel_wait(lock, _ticks_to_us(timeout), [queue] { return queue->items.size() < queue->length; })) {
+            return pdFALSE;
+        }
+
+        const auto *bytes = (const uint8_t *) item;
+        std::vector<uint8_t> copy(bytes, bytes + queue->item_size);
+        if (front) {
+            queue->items.push_front(std::move(copy));
+        } else {
+            queue->items.push_back(std::move(copy));
+        }
+    }
+
+    fake_kernel_notify();
+    return pdTRUE;
+}
+
+BaseType_t xQueueSend(QueueHandle_t queue, const void *item, TickType_t timeout) {
+    return _queue_send(queue, item, timeout, false);
+}
+
+BaseType_t xQueueSendToBack(QueueHandle_t queue, const void *item, TickType_t timeout) {
+    return _queue_send(queue, item, timeout, false);
+}
+
+BaseType_t xQueueSendToFront(QueueHandle_t queue, const void *item, TickType_t timeout) {
+    return _queue_send(queue, item, timeout, true);
+}
+
+BaseType_t xQueueOverwrite(QueueHandle_t queue, const void *item) {
+    {
+        std::lock_guard<std::mutex> guard(fake_kernel_mutex());
+        queue->items.clear();
+
+        const auto *bytes = (const uint8_t *) item;
+        queue->items.emplace_back(bytes, bytes + queue->item_size);
+    }
+
+    fake_kernel_notify();
+    return pdPASS;
+}
+
+static BaseType_t _queue_receive(QueueHandle_t queue, void *item, TickType_t timeout, bool remove) {
+    {
+        std::unique_lock<std::mutex> lock(fake_kernel_mutex());
+        if (!fake_kernel_wait(lock, _ticks_to_us(timeout), [queue] { return !queue->items.empty(); })) return pdFALSE;
+
+        memcpy(item, queue->items.front().data(), queue->item_size);
+        if (!remove) return pdTRUE;
+
+        queue->items.pop_front();
+    }
+
+    fake_kernel_notify();
+    return pdTRUE;
+}
+
+BaseType_t xQueueReceive(QueueHandle_t queue, void *item, TickType_t timeout) {
+    return _queue_receive(queue, item, timeout, true);
+}
+
+BaseType_t xQueuePeek(QueueHandle_t queue, void *item, TickType_t timeout) {
+    return _queue_receive(queue, item, timeout, false);
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue) {
+    std::lock_guard<std::mutex> guard(fake_kernel_mutex());
+    return queue->items.size();
+}
+
+UBaseType_t uxQueueSpacesAvailable(QueueHandle_t queue) {
+    std::lock_guard<std::mutex> guard(fake_kernel_mutex());
+    return queue->length - queue->items.size();
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutex() {
+    return new FakeSemaphore{1, 1};
+}
+
+SemaphoreHandle_t xSemaphoreCreateBinary() {
+    return new FakeSemaphore{1, 0};
+}
+
+SemaphoreHandle_t xSemaphoreCreateCounting(UBaseType_t max_count, UBaseType_t initial_count) {
+    return new FakeSemaphore{max_count, initial_count};
+}
+
+void vSemaphoreDelete(SemaphoreHandle_t semaphore) {
+    delete semaphore;
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t semaphore, TickType_t timeout) {
+    std::unique_lock<std::mutex> lock(fake_kernel_mutex());
+    if (!fake_kernel_wait(lock, _ticks_to_us(timeout), [semaphore] { return semaphore->count > 0; })) return pdFALSE;
+
+    --semaphore->count;
+    return pdTRUE;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t semaphore) {
+    {
+        std::lock_guard<std::mutex> guard(fake_kernel_mutex());
+        if (semaphore->count >= semaphore->max_count) return pdFALSE;
+
+        ++semaphore->count;
+    }
+
+    fake_kernel_notify();
+    return pdTRUE;
+}
+
+EventGroupHandle_t xEventGroupCreate() {
+    return new FakeEventGroup{0};
+}
+
+EventBits_t xEventGroupSetBits(EventGroupHandle_t group, EventBits_t bits) {
+    EventBits_t result;
+    {
+        std::lock_guard<std::mutex> guard(fake_kernel_mutex());
+        result = group->bits |= bits;
+    }
+
+    fake_kernel_notify();
+    return result;
+}
+
+EventBits_t xEventGroupClearBits(EventGroupHandle_t group, EventBits_t bits) {
+    std::lock_guard<std::mutex> guard(fake_kernel_mutex());
+
+    const EventBits_t result = group->bits;
+    group->bits &= ~bits;
+
+    return result;
+}
+
+EventBits_t xEventGroupGetBits(EventGroupHandle_t group) {
+    std::lock_guard<std::mutex> guard(fake_kernel_mutex());
+    return group->bits;
+}
+
+EventBits_t xEventGroupWaitBits(EventGroupHandle_t group, EventBits_t bits, BaseType_t clear_on_exit,
+                                BaseType_t wait_for_all, TickType_t timeout) {
+    std::unique_lock<std::mutex> lock(fake_kernel_mutex());
+
+    const bool done = fake_kernel_wait(lock, _ticks_to_us(timeout), [group, bits, wait_for_all] {
+        return wait_for_all ? (group->bits & bits) == bits : (group->bits & bits) != 0;
+    });
+
+    const EventBits_t result = group->bits;
+    if (done && clear_on_exit) group->bits &= ~bits;
+
+    return result;
+}
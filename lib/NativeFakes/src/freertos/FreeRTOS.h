@@ -0,0 +1,43 @@
+#pragma once
+
+#include <stdint.h>
+
+/*
+ * FreeRTOS API subset on top of std::thread, see freertos.cpp.
+ * Tick is one millisecond of device time.
+ */
+
+typedef uint32_t TickType_t;
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+
+#define portMAX_DELAY ((TickType_t) 0xffffffffUL)
+#define portTICK_PERIOD_MS 1
+#define portNUM_PROCESSORS 2
+#define pdMS_TO_TICKS(ms) ((TickType_t) (ms))
+
+#define pdTRUE 1
+#define pdFALSE 0
+#define pdPASS pdTRUE
+#define pdFAIL pdFALSE
+
+#define configMAX_PRIORITIES 25
+#define configMAX_TASK_NAME_LEN 16
+
+// Critical sections are a single process-wide recursive lock
+typedef struct {
+    int unused;
+} portMUX_TYPE;
+
+#define portMUX_INITIALIZER_UNLOCKED {0}
+
+void vPortEnterCritical(portMUX_TYPE *mux);
+void vPortExitCritical(portMUX_TYPE *mux);
+
+#define portENTER_CRITICAL(mux) vPortEnterCritical(mux)
+#define portEXIT_CRITICAL(mux) vPortExitCritical(mux)
+#define portENTER_CRITICAL_ISR(mux) vPortEnterCritical(mux)
+#define portEXIT_CRITICAL_ISR(mux) vPortExitCritical(mux)
+
+// Core given to xTaskCreatePinnedToCore(), setup() runs on core 1 like Arduino loop task
+BaseType_t xPortGetCoreID();
@@ -0,0 +1,17 @@
+#pragma once
+
+#include "FreeRTOS.h"
+
+typedef struct FakeSemaphore *SemaphoreHandle_t;
+
+// Mutex is a binary semaphore which is given at creation, priority inheritance is irrelevant on host
+SemaphoreHandle_t xSemaphoreCreateMutex();
+SemaphoreHandle_t xSemaphoreCreateBinary();
+SemaphoreHandle_t xSemaphoreCreateCounting(UBaseType_t max_count, UBaseType_t initial_count);
+void vSemaphoreDelete(SemaphoreHandle_t semaphore);
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t semaphore, TickType_t timeout);
+BaseType_t xSemaphoreGive(SemaphoreHandle_t semaphore);
+
+#define xSemaphoreTakeFromISR(semaphore, woken) xSemaphoreTake(semaphore, 0)
+#define xSemaphoreGiveFromISR(semaphore, woken) xSemaphoreGive(semaphore)
@@ -0,0 +1,91 @@
+#include "Adafruit_BME280.h"
+#include "MHZ19.h"
+
+#include "fake_time.h"
+
+TwoWire Wire(0);
+
+static FakeBme280State bme280[FAKE_I2C_BUS_COUNT] = {
+        {22.5f, 45.0f, 101325.0f, 200, 8000, 0},
+        {20.5f, 55.0f, 101325.0f, 200, 8000, 0},
+};
+
+static FakeMhz19State mhz19[FAKE_UART_COUNT] = {
+        {1000, 2000, 25000, 0, 0},
+        {800, 2000, 25000, 0, 0},
+        {600, 2000, 25000, 0, 0},
+};
+
+void fake_bme280_set(float temperature, float humidity, uint8_t bus) {
+    bme280[bus].temperature = temperature;
+    bme280[bus].humidity = humidity;
+}
+
+FakeBme280State &fake_bme280(uint8_t bus) {
+    return bme280[bus];
+}
+
+Adafruit_BME280::Adafruit_BME280() : _state(&bme280[0]) {}
+
+bool Adafruit_BME280::begin(uint8_t address, TwoWire *wire) {
+    _state = &bme280[wire->bus() < FAKE_I2C_BUS_COUNT ? wire->bus() : 0];
+    return true;
+}
+
+void Adafruit_BME280::setSampling(sensor_mode mode, sensor_sampling temperature, sensor_sampling pressure,
+                                  sensor_sampling humidity, sensor_filter filter, standby_duration duration) {}
+
+bool Adafruit_BME280::takeForcedMeasurement() {
+    fake_time_sleep(_state->measurement_us);
+    return true;
+}
+
+float Adafruit_BME280::readTemperature() {
+    ++_state->reads;
+    fake_time_sleep(_state->read_us);
+
+    return _state->temperature;
+}
+
+float Adafruit_BME280::readPressure() {
+    ++_state->reads;
+    fake_time_sleep(_state->read_us);
+
+    return _state->pressure;
+}
+
+float Adafruit_BME280::readHumidity() {
+    ++_state->reads;
+    fake_time_sleep(_state->read_us);
+
+    return _state->humidity;
+}
+
+void fake_mhz19_set(int co2, uint8_t uart) {
+    mhz19[uart].co2 = co2;
+}
+
+FakeMhz19State &fake_mhz19(uint8_t uart) {
+    return mhz19[uart];
+}
+
+MHZ19::MHZ19() : _state(&mhz19[2]) {}
+
+void MHZ19::begin(HardwareSerial &serial) {
+    _state = &mhz19[serial.uart() >= 0 && serial.uart() < FAKE_UART_COUNT ? serial.uart() : 2];
+}
+
+void MHZ19::setRange(int range) {
+    _state->range = range;
+}
+
+void MHZ19::calibrate() {
+    ++_state->calibrations;
+}
+
+int MHZ19::getCO2(bool unlimited, bool force) {
+    ++_state->requests;
+    fake_time_sleep(_state->request_us);
+
+    return unlimited ? _state->co2 : std::min(_state->co2, _state->range);
+}
@@ -0,0 +1,107 @@
+#include "EEPROM.h"
+#include "Preferences.h"
+
+#include <mutex>
+
+EEPROMClass EEPROM;
+
+static std::map<std::string, std::vector<uint8_t>> nvs;
+static std::mutex nvs_mutex;
+
+bool EEPROMClass::begin(size_t size) {
+    // Erased flash reads as 0xff
+    _data.assign(size, 0xff);
+
+    const char *path = getenv("FAKE_EEPROM_FILE");
+    if (path == nullptr) return true;
+
+    FILE *file = fopen(path, "rb");
+    if (file == nullptr) return true;
+
+    fread(_data.data(), 1, _data.size(), file);
+    fclose(file);
+
+    return true;
+}
+
+bool EEPROMClass::commit() {
+    const char *path = getenv("FAKE_EEPROM_FILE");
+    if (path == nullptr) return true;
+
+    FILE *file = fopen(path, "wb");
+    if (file == nullptr) return false;
+
+    const bool success = fwrite(_data.data(), 1, _data.size(), file) == _data.size();
+    fclose(file);
+
+    return success;
+}
+
+bool Preferences::begin(const char *name, bool read_only) {
+    _namespace = name;
+    _read_only = read_only;
+    _started = true;
+
+    return true;
+}
+
+void Preferences::end() {
+    _started = false;
+}
+
+bool Preferences::clear() {
+    if (!_started || _read_only) return false;
+
+    std::lock_guard<std::mutex> guard(nvs_mutex);
+    const std::string prefix = _key("");
+    for (auto it = nvs.begin(); it != nvs.end();) {
+        if (it->first.compare(0, prefix.size(), prefix) == 0) {
+            it = nvs.erase(it);
+        } else {
+            ++it;
+        }
+    }
+
+    return true;
+}
+
+bool Preferences::remove(const char *key) {
+    if (!_started || _read_only) return false;
+
+    std::lock_guard<std::mutex> guard(nvs_mutex);
+    return nvs.erase(_key(key)) > 0;
+}
+
+bool Preferences::isKey(const char *key) {
+    std::lock_guard<std::mutex> guard(nvs_mutex);
+    return _started && nvs.count(_key(key)) > 0;
+}
+
+size_t Preferences::getBytesLength(const char *key) {
+    if (!_started) return 0;
+
+    std::lock_guard<std::mutex> guard(nvs_mutex);
+    auto it = nvs.find(_key(key));
+    return it != nvs.end() ? it->second.size() : 0;
+}
+
+size_t Preferences::getBytes(const char *key, void *buffer, size_t max_length) {
+    if (!_started) return 0;
+
+    std::lock_guard<std::mutex> guard(nvs_mutex);
+    auto it = nvs.find(_key(key));
+    if (it == nvs.end() || it->second.size() > max_length) return 0;
+
+    memcpy(buffer, it->second.data(), it->second.size());
+    return it->second.size();
+}
+
+size_t Preferences::putBytes(const char *key, const void *value, size_t length) {
+    if (!_started || _read_only) return 0;
+
+    std::lock_guard<std::mutex> guard(nvs_mutex);
+    const auto *bytes = (const uint8_t *) value;
+    nvs[_key(key)].assign(bytes, bytes + length);
+
+    return length;
+}
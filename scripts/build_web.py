@@ -0,0 +1,81 @@
+# Minify and gzip Web UI assets into a C header embedded in the firmware.
+# Runs as PlatformIO pre-build script, can be run manually as well: python scripts/build_web.py
+
+import gzip
+import hashlib
+import os
+import re
+
+try:
+    Import("env")
+    PROJECT_DIR = env["PROJECT_DIR"]
+except NameError:
+    PROJECT_DIR = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+
+ASSETS = [
+    # (source, symbol name)
+    ("html/index.html", "WEB_INDEX"),
+]
+
+OUTPUT = "src/generated/web_assets.h"
+
+
+def minify(text):
+    # Only safe transformations: JS relies on line breaks for automatic semicolon insertion
+    text = re.sub(r"<!--.*?-->", "", text, flags=re.S)
+    lines = (line.strip() for line in text.splitlines())
+    return "\n".join(line for line in lines if line)
+
+
+def c_array(data):
+    rows = []
+    for i in range(0, len(data), 16):
+        rows.append("        " + ", ".join("0x%02x" % b for b in data[i:i + 16]) + ",")
+
+    return "\n".join(rows)
+
+
+def build():
+    parts = [
+        "#pragma once",
+        "",
+        "// Generated by scripts/build_web.py, do not edit",
+        "",
+        "#include <Arduino.h>",
+    ]
+
+    for source, name in ASSETS:
+        with open(os.path.join(PROJECT_DIR, source), "r", encoding="utf-8") as f:
+            minified = minify(f.read()).encode("utf-8")
+
+        # mtime=0 keeps output reproducible, so ETag changes only with content
+        compressed = gzip.compress(minified, compresslevel=9, mtime=0)
+        etag = hashlib.sha1(compressed).hexdigest()[:16]
+
+        print("Web asset %s: %d bytes, minified %d, gzip %d, etag %s"
+              % (source, os.path.getsize(os.path.join(PROJECT_DIR, source)), len(minified), len(compressed), etag))
+
+        parts += [
+            "",
+            "const char %s_ETAG[] = \"\\\"%s\\\"\";" % (name, etag),
+            "const size_t %s_GZ_SIZE = %d;" % (name, len(compressed)),
+            "const uint8_t %s_GZ[] PROGMEM = {" % name,
+            c_array(compressed),
+            "};",
+        ]
+
+    content = "\n".join(parts) + "\n"
+
+    path = os.path.join(PROJECT_DIR, OUTPUT)
+    os.makedirs(os.path.dirname(path), exist_ok=True)
+
+    # Don't touch file if nothing changed to avoid needless rebuild
+    if os.path.exists(path):
+        with open(path, "r", encoding="utf-8") as f:
+            if f.read() == content: return
+
+    with open(path, "w", encoding="utf-8") as f:
+        f.write(content)
+
+
+build()
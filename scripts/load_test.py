@@ -0,0 +1,101 @@
+# Host-side HTTP load test for the device Web UI.
+#
+# Usage: python scripts/load_test.py <device-ip> [--path /status] [--connections 8] [--duration 10]
+#
+# Each connection sends requests back to back (reusing the socket when server keeps it open)
+# and the script reports throughput and latency percentiles.
+
+import argparse
+import asyncio
+import time
+
+
+async def read_response(reader):
+    head = await reader.readuntil(b"\r\n\r\n")
+    lines = head.decode("latin-1").split("\r\n")
+    version, status = lines[0].split(" ")[:2]
+
+    headers = {}
+    for line in lines[1:]:
+        if ":" in line:
+            key, value = line.split(":", 1)
+            headers[key.strip().lower()] = value.strip()
+
+    framed = True
+    if "content-length" in headers:
+        await reader.readexactly(int(headers["content-length"]))
+    elif headers.get("transfer-encoding", "").lower() == "chunked":
+        while True:
+            size = int((await reader.readline()).strip(), 16)
+            await reader.readexactly(size + 2)
+            if size == 0: break
+    else:
+        framed = False
+        await reader.read()
+
+    connection = headers.get("connection", "").lower()
+    keep_alive = connection == "keep-alive" or (version == "HTTP/1.1" and connection != "close")
+    return int(status), keep_alive and framed
+
+
+async def worker(args, deadline, stats):
+    request = ("GET %s HTTP/1.1\r\nHost: %s\r\nConnection: keep-alive\r\n\r\n" % (args.path, args.host)).encode()
+
+    reader = writer = None
+    while time.monotonic() < deadline:
+        start = time.monotonic()
+        try:
+            if writer is None:
+                reader, writer = await asyncio.wait_for(asyncio.open_connection(args.host, args.port), args.timeout)
+                stats["connections"] += 1
+
+            writer.write(request)
+            await writer.drain()
+
+            status, keep_alive = await asyncio.wait_for(read_response(reader), args.timeout)
+            stats["latency"].append(time.monotonic() - start)
+            if status != 200: stats["errors"] += 1
+        except (OSError, asyncio.TimeoutError, asyncio.IncompleteReadError, ValueError, IndexError):
+            stats["errors"] += 1
+            keep_alive = False
+
+        if not keep_alive and writer is not None:
+            writer.close()
+            reader = writer = None
+
+    if writer is not None:
+        writer.close()
+
+
+def percentile(values, p):
+    if not values: return float("nan")
+    return values[min(len(values) - 1, int(len(values) * p / 100))]
+
+
+async def main():
+    parser = argparse.ArgumentParser(description="HTTP load test")
+    parser.add_argument("host")
+    parser.add_argument("--port", type=int, default=80)
+    parser.add_argument("--path", default="/status")
+    parser.add_argument("--connections", type=int, default=8)
+    parser.add_argument("--duration", type=float, default=10)
+    parser.add_argument("--timeout", type=float, default=5)
+    args = parser.parse_args()
+
+    stats = {"latency": [], "errors": 0, "connections": 0}
+    deadline = time.monotonic() + args.duration
+
+    started = time.monotonic()
+    await asyncio.gather(*(worker(args, deadline, stats) for _ in range(args.connections)))
+    elapsed = time.monotonic() - started
+
+    latency = sorted(stats["latency"])
+    print("Requests:    %d (%d errors, %d connections opened)" % (len(latency), stats["errors"], stats["connections"]))
+    print("Throughput:  %.1f req/s" % (len(latency) / elapsed))
+    print("Latency p50: %.1f ms" % (percentile(latency, 50) * 1000))
+    print("Latency p99: %.1f ms" % (percentile(latency, 99) * 1000))
+    print("Latency max: %.1f ms" % ((latency[-1] if latency else float("nan")) * 1000))
+
+
+if __name__ == "__main__":
+    asyncio.run(main())
@@ -2,37 +2,40 @@
 
 #include <Arduino.h>
 
+#include "channels.h"
 #include "settings.h"
 
-#define ALERT_TEMPERATURE 0u
-#define ALERT_CO2 1u
-#define ALERT_HUMIDITY 2u
-#define ALERT_SENDING 3u
+// Indexed by zone and ChannelId
+static unsigned long alert_time[ZONE_COUNT][ALERT_COUNT] = {};
 
-struct Alert {
-    const int key;
-    const AlertEntry &entry_prop;
-    const volatile float &value;
+// Value is out of range, until it returns into range or alert is disabled
+static bool alert_active[ZONE_COUNT][ALERT_COUNT] = {};
 
-    const char *name;
-    const char *unit;
-    unsigned int fraction;
-};
+bool alert(uint8_t zone, ChannelId channel, const unsigned int alert_interval, float value, float min, float max) {
+    const auto last_alert = alert_time[zone][channel];
 
-static unsigned long alert_time[] = {0ul, 0ul, 0ul};
+    if (value < min || value > max) {
+        alert_active[zone][channel] = true;
 
-bool alert(const unsigned int key, const unsigned int alert_interval, float value, float min, float max) {
-    const auto last_alert = alert_time[key];
-
-    if ((value < min || value > max) && (last_alert == 0ul || millis() - last_alert > alert_interval)) {
-        alert_time[key] = millis();
-        return true;
+        if (last_alert == 0ul || millis() - last_alert > alert_interval) {
+            alert_time[zone][channel] = millis();
+            return true;
+        }
     }
 
     return false;
 }
 
-bool alert(const unsigned int key, float value, const AlertEntry &entry) {
-    if (entry.enabled) return alert(key, entry.alert_interval, value, entry.min, entry.max);
+bool alert(uint8_t zone, ChannelId channel, float value, const AlertEntry &entry) {
+    if (entry.enabled) return alert(zone, channel, entry.alert_interval, value, entry.min, entry.max);
     return false;
-}
\ No newline at end of file
+}
+
+// Returns true once when active alert is over. Missing reading doesn't clear it
+bool alert_cleared(uint8_t zone, ChannelId channel, float value, const AlertEntry &entry) {
+    if (!alert_active[zone][channel]) return false;
+    if (entry.enabled && (isnan(value) || value < entry.min || value > entry.max)) return false;
+
+    alert_active[zone][channel] = false;
+    return true;
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <Arduino.h>
+#include <esp_timer.h>
+
+#include "debug.h"
+
+/*
+ * Boot phases run concurrently in the tasks that own them, only settings are loaded before everything else.
+ * Completed phases are set in the event group, so anyone can wait for what it depends on.
+ * Start and end of every phase are recorded and exported as metrics.
+ */
+enum BootPhase : uint8_t {
+    BOOT_SETTINGS,
+    BOOT_DISPLAY,
+    BOOT_SENSORS,
+    BOOT_NETWORK,
+    BOOT_WEB,
+
+    BOOT_PHASE_COUNT
+};
+
+struct BootPhaseInfo {
+    const char *name;
+
+    // Microseconds since boot, -1 if not reached yet
+    volatile int64_t start;
+    volatile int64_t end;
+};
+
+static BootPhaseInfo BootPhases[BOOT_PHASE_COUNT] = {
+        {"settings", -1, -1},
+        {"display",  -1, -1},
+        {"sensors",  -1, -1},
+        {"network",  -1, -1},
+        {"web",      -1, -1},
+};
+
+#define BOOT_BIT(phase) (1u << (phase))
+#define BOOT_ALL_BITS (BOOT_BIT(BOOT_PHASE_COUNT) - 1)
+
+static EventGroupHandle_t boot_events = xEventGroupCreate();
+
+void boot_phase_begin(BootPhase phase) {
+    BootPhases[phase].start = esp_timer_get_time();
+}
+
+void boot_phase_end(BootPhase phase) {
+    // Phase can complete again, e.g. network after reconnect, only the first time counts
+    if (BootPhases[phase].end >= 0) return;
+
+    BootPhases[phase].end = esp_timer_get_time();
+    xEventGroupSetBits(boot_events, BOOT_BIT(phase));
+
+#ifdef DEBUG
+    Serial.print("Boot phase ");
+    Serial.print(BootPhases[phase].name);
+    Serial.print(" done in ");
+    Serial.print((long) ((BootPhases[phase].end - BootPhases[phase].start) / 1000));
+    Serial.print(" ms, at ");
+    Serial.print((long) (BootPhases[phase].end / 1000));
+    Serial.println(" ms since boot");
+#endif
+}
+
+// Returns true if all phases from bits are completed before timeout
+bool boot_wait(EventBits_t bits, TickType_t timeout = portMAX_DELAY) {
+    return (xEventGroupWaitBits(boot_events, bits, pdFALSE, pdTRUE, timeout) & bits) == bits;
+}
+
+inline bool boot_phase_completed(BootPhase phase) { return BootPhases[phase].end >= 0; }
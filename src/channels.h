@@ -0,0 +1,82 @@
+#pragma once
+
+#include <Arduino.h>
+
+#include "models.h"
+#include "pins.h"
+
+/*
+ * Channel registry: every sensor and actuator is declared here once.
+ * Sampling, alerts, schedules, settings layout and keys, status and upload JSON are generated
+ * by loops over Channels[] at compile time known size, so there is no per-channel code elsewhere.
+ * Adding a channel is a ChannelId entry in models.h and a row below (and a sample function for a sensor),
+ * plus its output in Zones[] for an actuator.
+ */
+
+struct ChannelInfo {
+    ChannelId id;
+
+    // Key in status JSON and of per channel settings group
+    const char *key;
+    // Field of Data API payload, nullptr if not uploaded
+    const char *upload_key;
+
+    // Name and unit for alerts and logs
+    const char *name;
+    const char *unit;
+    uint8_t fraction;
+
+    // Value of the channel label in metrics
+    const char *metric_label;
+
+    // Sensors (ids below SENSOR_COUNT). Returns NAN when reading is invalid
+    float (*sample)(uint8_t zone);
+    const char *calibration_key;
+
+    // Alerts (ids below ALERT_COUNT)
+    const char *alert_key;
+    AlertEntry alert;
+
+    // Actuators (ids from ACTUATOR_FIRST), outputs are assigned per zone
+    uint8_t pwm_bits;
+    ScheduleEntry schedule;
+};
+
+// Defined in data.h, next to the sensor drivers
+float sample_temperature(uint8_t zone);
+float sample_humidity(uint8_t zone);
+float sample_co2(uint8_t zone);
+
+#define CHANNEL_ALERT_INTERVAL ((unsigned long) 5 * 60 * 1000)
+
+static constexpr ChannelInfo Channels[CHANNEL_COUNT] = {
+        {TEMPERATURE,  "temp", "Tamb", "TEMP",       "C",   1, "temperature",
+                sample_temperature, "t_cal",   "alert_temp", {true, CHANNEL_ALERT_INTERVAL, 22, 24}},
+        {HUMIDITY,     "hum",  "Hum",  "HUM",        "%",   0, "humidity",
+                sample_humidity,    "h_cal",   "alert_hum",  {true, CHANNEL_ALERT_INTERVAL, 80, 100}},
+        {CO2,          "co2",  "CntR", "CO2",        "ppm", 0, "co2",
+                sample_co2,         "co2_cal", "alert_co2",  {true, CHANNEL_ALERT_INTERVAL, 400, 1500}},
+        {SEND_LATENCY, "lat",  nullptr, "LATENCY",   "ms",  0, "latency",
+                nullptr,            nullptr,   "alert_lat",  {true, CHANNEL_ALERT_INTERVAL, 0, 900}},
+        {FAN,          "fan",  "Fan",  "FAN",        "%",   0, "fan",
+                nullptr,            nullptr,   nullptr,      {},
+                FAN_PWM_BITS,        {ScheduleMode::PWM, CO2, 500, 1000, 480, 3600, 0, 26000, 0, 1}},
+        {HUMIDIFIER,   "humr", "HumR", "HUMIDIFIER", "%",   0, "humidifier",
+                nullptr,            nullptr,   nullptr,      {},
+                HUMIDIFIER_PWM_BITS, {ScheduleMode::PWM, HUMIDITY, 100, 80, 480, 3600, 0, 26000, 0, 1}},
+};
+
+constexpr bool _channels_ordered(uint8_t index = 0) {
+    return index == CHANNEL_COUNT || (Channels[index].id == index && _channels_ordered(index + 1));
+}
+
+static_assert(_channels_ordered(), "Channels[] must be listed in ChannelId order");
+
+constexpr bool _channels_complete(uint8_t index = 0) {
+    return index == CHANNEL_COUNT
+           || ((index >= SENSOR_COUNT || (Channels[index].sample && Channels[index].calibration_key))
+               && (index >= ALERT_COUNT || Channels[index].alert_key)
+               && _channels_complete(index + 1));
+}
+
+static_assert(_channels_complete(), "Sensor and alert channels must have sample function and settings keys");
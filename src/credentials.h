@@ -6,4 +6,13 @@ const char *password = "<PASSWORD>";
 const char *API_URL = "https://<ADDRESS:PORT>/sensor";
 const char *API_KEY = "<API-KEY>";
 
+// MQTT over TLS, broker certificate is verified with SSL_CERT too. Empty user or password isn't sent
+const char *MQTT_HOST = "<ADDRESS>";
+const uint16_t MQTT_PORT = 8883;
+const char *MQTT_CLIENT_ID = "temp-monitor";
+const char *MQTT_USER = "<MQTT-USER>";
+const char *MQTT_PASSWORD = "<MQTT-PASSWORD>";
+// Values of the zone are retained in <MQTT_TOPIC>/<zone name>
+const char *MQTT_TOPIC = "temp-monitor";
+
 extern const char SSL_CERT[]  asm("_binary_certs_api_pem_start");
\ No newline at end of file
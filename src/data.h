@@ -1,212 +1,433 @@
 #pragma once
 
-#include <ArduinoJson.h>
 #include "HTTPClient.h"
+#include <atomic>
 
 #include "alert.h"
+#include "boot.h"
+#include "channels.h"
 #include "credentials.h"
 #include "debug.h"
+#include "display_queue.h"
+#include "event_bus.h"
 #include "hardware.h"
+#include "json_writer.h"
+#include "metrics.h"
 #include "models.h"
+#include "mqtt.h"
+#include "profiler.h"
 #include "schedule.h"
 #include "settings.h"
+#include "text_format.h"
+#include "timed_client.h"
 #include "wifi_control.h"
 
 const unsigned int connection_timeout = 1000;
 const unsigned int tcp_timeout = 1000;
 
-enum State : uint8_t {
-    WARM_UP,
-    DISPLAY_SENSOR,
-    PENDING_ALERT,
-    DISPLAY_ALERT,
-};
-
-volatile static State current_state = WARM_UP;
-
-static SensorData sensor_data;
-static String alert_display_string = "";
-
-static const Alert Alerts[] = {
-        {ALERT_TEMPERATURE, settings.get().alert_temperature, sensor_data.temperature,  "TEMP",    "C",   1},
-        {ALERT_CO2,         settings.get().alert_co2,         sensor_data.co2,          "CO2",     "ppm", 0},
-        {ALERT_HUMIDITY,    settings.get().alert_humidity,    sensor_data.humidity,     "HUM",     "%",   0},
-        {ALERT_SENDING,     settings.get().alert_latency,     sensor_data.send_latency, "LATENCY", "s",   0},
-};
-
-static Schedule Schedules[] = {
-#ifdef PIN_FAN_PWM
-        {PIN_FAN_PWM, PWM_CHANNEL_FAN, FAN_PWM_BITS,
-         (float &) sensor_data.fan_speed, settings.get().fan_schedule},
-#endif
-#ifdef PIN_HUMIDIFIER_PWM
-        {PIN_HUMIDIFIER_PWM, PWM_CHANNEL_HUMIDIFIER, HUMIDIFIER_PWM_BITS,
-         (float &) sensor_data.humidifier_power, settings.get().humidifier_schedule},
-#endif
-};
+// Longest wait between loop iterations, for timers and watchdog. Events wake the task earlier
+const unsigned long DATA_LOOP_DELAY = 100;
+
+// Sensors are owned by data task, so calibration requested from web is executed here. Bit per zone
+static std::atomic<uint8_t> co2_calibration_requested{0};
+
+static_assert(ZONE_COUNT <= 8, "Zone calibration requests don't fit the mask");
+
+// Indexed by zone
+static SensorData sensor_data[ZONE_COUNT];
+
+// Indexed by zone and from ACTUATOR_FIRST, outputs without pin stay idle
+static Schedule Schedules[ZONE_COUNT][ACTUATOR_COUNT];
+
+// Zones are uploaded together, so upload state is shared
+static unsigned long sensor_last_send = 0;
+
+// Zones are sampled in turns spread over the update interval
+static uint8_t sample_next_zone = 0;
+static unsigned long sample_last_time = 0;
 
 static HTTPClient http;
-static WiFiClientSecure client;
+static TimedClient client;
 
-[[noreturn]] void data_loop(void *);
+void on_mqtt_ack(uint32_t latency_ms);
+
+// Own TLS connection, it stays open between uploads
+static WiFiClientSecure mqtt_connection;
+static MqttClient mqtt(mqtt_connection, on_mqtt_ack);
 
-void process_alerts() {
-    if (current_state != DISPLAY_SENSOR) return;
+// Part of MqttClient::bytes_sent() already added to metric
+static uint32_t mqtt_bytes_counted = 0;
 
-    for (auto config: Alerts) {
-        const boolean activated = alert(config.key, config.value, config.entry_prop);
-        if (activated) {
-            current_state = PENDING_ALERT;
-            alert_display_string = String("ALERT ") + config.name + ": "
-                                   + String(config.value, config.fraction) + " "
-                                   + String(config.unit);
+[[noreturn]] void data_loop(void *);
 
-            return;
+// Checked when channel values change: after sampling of the zone and after upload for latency
+void process_alerts(uint8_t zone) {
+    const auto snapshot = settings.get();
+    for (uint8_t i = 0; i < ALERT_COUNT; ++i) {
+        const auto &channel = Channels[i];
+        if (channel.id == SEND_LATENCY && zone != 0) continue;
+
+        const auto &entry = snapshot->zones[zone].alerts[i];
+        const float value = sensor_data[zone].values[i];
+
+        if (alert(zone, channel.id, value, entry)) {
+            metric_alerts.inc(zone, channel.id);
+            publish_event(EVENT_ALERT_RAISED, zone, channel.id, value);
+        } else if (alert_cleared(zone, channel.id, value, entry)) {
+            publish_event(EVENT_ALERT_CLEARED, zone, channel.id, value);
         }
     }
 }
 
-void send_sensor_data() {
-    const auto &config = settings.get();
-    if (sensor_data.last_send == 0ul || (millis() - sensor_data.last_send) > config.sensor_send_interval) {
-#ifdef DEBUG
-        Serial.println("Sending sensor data...");
-#endif
-        String result;
-        StaticJsonDocument<128> doc;
-        if (!isnan(sensor_data.temperature)) doc["Tamb"] = sensor_data.temperature;
-        if (!isnan(sensor_data.co2)) doc["CntR"] = sensor_data.co2;
-        if (!isnan(sensor_data.humidity)) doc["Hum"] = sensor_data.humidity;
-        if (!isnan(sensor_data.fan_speed)) doc["Fan"] = sensor_data.fan_speed;
-        if (!isnan(sensor_data.humidifier_power)) doc["HumR"] = sensor_data.humidifier_power;
-
-        serializeJson(doc, result);
-
-        http.setConnectTimeout(connection_timeout);
-        http.setTimeout(tcp_timeout);
-
-        http.begin(client, API_URL);
-        http.addHeader("Content-Type", "application/json");
-        http.addHeader("API-Key", API_KEY);
-
-        const auto httpResponseCode = http.POST(result);
-        if (httpResponseCode == 200) {
-            const auto now = millis();
-            sensor_data.send_latency = (float) (now - sensor_data.last_send) - (float) config.sensor_send_interval;
-            if (sensor_data.send_latency < 0ul) sensor_data.send_latency = NAN;
-
-            sensor_data.last_send = now;
+/*
+ * Send latency is the time the data task is blocked on upload: HTTP request time, failed requests included,
+ * or MQTT publish with reconnect. Zones are uploaded together, so it belongs to the controller
+ * and is kept and checked in the first zone only, with its alert settings.
+ */
+void update_send_latency(uint32_t latency_ms) {
+    sensor_data[0].values[SEND_LATENCY] = (float) latency_ms;
+    process_alerts(0);
+}
+
+// PUBACK is only read by the data loop, so latency is as coarse as DATA_LOOP_DELAY and isn't alerted on
+void on_mqtt_ack(uint32_t latency_ms) {
+    metric_upload_latency_mqtt.observe(latency_ms);
+}
+
+void write_upload_values(JsonWriter &json, const float (&values)[CHANNEL_COUNT]) {
+    for (auto &channel: Channels) {
+        if (channel.upload_key && !isnan(values[channel.id])) json.field(channel.upload_key, values[channel.id]);
+    }
+}
+
+/*
+ * Values are indexed by zone and ChannelId. Returns HTTP response code, NaN values are omitted.
+ * Single zone is sent as flat object, several zones are batched into one request as objects by zone name.
+ * Samples uploaded later than taken carry their age in ms as top level "age" field.
+ */
+int post_sensor_data(const float (&values)[ZONE_COUNT][CHANNEL_COUNT], uint32_t age_ms = 0) {
+    uint8_t payload[128 * ZONE_COUNT + 16];
+    ChunkWriter out(payload, sizeof(payload));
+    JsonWriter json(out);
+
+    json.begin_object();
+    if (age_ms > 0) json.field("age", age_ms);
+    if (ZONE_COUNT == 1) {
+        write_upload_values(json, values[0]);
+    } else {
+        for (uint8_t zone = 0; zone < ZONE_COUNT; ++zone) {
+            json.begin_object(Zones[zone].name);
+            write_upload_values(json, values[zone]);
+            json.end_object();
         }
+    }
+    json.end_object();
+
+    http.setConnectTimeout(connection_timeout);
+    http.setTimeout(tcp_timeout);
+
+    http.begin(client, API_URL);
+    http.addHeader("Content-Type", "application/json");
+    http.addHeader("API-Key", API_KEY);
+
+    client.begin_request();
+    const auto request_start = millis();
+    const auto httpResponseCode = http.POST(payload, out.written());
+    metric_upload_bytes_http.inc(client.bytes_written());
+
+    for (uint8_t i = 0; i < HTTP_PHASE_COUNT; ++i) {
+        const int64_t time = client.phase((HttpPhase) i);
+        if (time >= 0) HttpPhaseMetrics[i]->observe((uint32_t) time);
+    }
+
+    // Failed requests are timed too, so timeouts show up in the latency and phases add up to it
+    metric_upload_latency_http.observe(millis() - request_start);
+    if (httpResponseCode == 200) {
+        metric_upload_success.inc();
+    } else {
+        metric_upload_failure.inc();
+    }
 
-        http.end();
+    http.end();
 
 #ifdef DEBUG
-        if (httpResponseCode == 200) {
-            Serial.println("Sensor data sent");
-        } else {
-            Serial.print("Data API Error: ");
-            Serial.println(HTTPClient::errorToString(httpResponseCode));
-        }
-#endif
+    if (httpResponseCode == 200) {
+        Serial.println("Sensor data sent");
+    } else {
+        Serial.print("Data API Error: ");
+        Serial.println(HTTPClient::errorToString(httpResponseCode));
+    }
+
+    static const char *const PHASE_NAMES[] = {"DNS", "connect", "write", "first byte"};
+    Serial.print("Request phases, ms:");
+    for (uint8_t i = 0; i < HTTP_PHASE_COUNT; ++i) {
+        Serial.print(' ');
+        Serial.print(PHASE_NAMES[i]);
+        Serial.print(' ');
+
+        // Phase which didn't happen, e.g. connect of a reused connection
+        const int64_t time = client.phase((HttpPhase) i);
+        if (time < 0) Serial.print('-');
+        else Serial.print((float) time / 1000.0f, 1);
     }
+    Serial.println();
+#endif
+
+    return httpResponseCode;
 }
 
+void count_mqtt_bytes() {
+    const uint32_t bytes = mqtt.bytes_sent();
+    metric_upload_bytes_mqtt.inc(bytes - mqtt_bytes_counted);
+    mqtt_bytes_counted = bytes;
+}
 
-void update_sensor_data() {
-    const auto &config = settings.get();
-    if (sensor_data.last_update == 0ul || (millis() - sensor_data.last_update) > config.sensor_update_interval) {
-        sensor_data.humidity = bme.readHumidity() + config.humidity_calibration;
-        sensor_data.temperature = bme.readTemperature() + config.temperature_calibration;
-
-        auto co2 = Mhz19.getCO2(false);
-        if (co2 >= 400 && co2 <= 5000) {
-            sensor_data.co2 = (float) co2 + config.co2_calibration;
-        }
+/*
+ * Every zone is published as its own retained QoS 1 message to <MQTT_TOPIC>/<zone name>, payload is the same
+ * as a zone object of the HTTP request. Doesn't wait for PUBACK: upload succeeds when all messages are sent,
+ * broker delivers them after reconnect thanks to the persistent session. Returns false if window is full or link is lost.
+ */
+bool publish_sensor_data(const float (&values)[ZONE_COUNT][CHANNEL_COUNT]) {
+    bool success = mqtt.connected() || mqtt.connect(MQTT_HOST, MQTT_PORT, connection_timeout);
 
-        for (auto &schedule: Schedules) {
-            schedule.update(sensor_data);
-        }
+    for (uint8_t zone = 0; success && zone < ZONE_COUNT; ++zone) {
+        uint8_t payload[128];
+        ChunkWriter out(payload, sizeof(payload));
+        JsonWriter json(out);
+
+        json.begin_object();
+        write_upload_values(json, values[zone]);
+        json.end_object();
+
+        char topic[64];
+        TextBuffer topic_text(topic);
+        topic_text.text(MQTT_TOPIC).text("/").text(Zones[zone].name);
+
+        success = mqtt.publish(topic, payload, out.written(), true);
+    }
 
-        sensor_data.last_update = millis();
+    count_mqtt_bytes();
+
+    if (success) {
+        metric_upload_success.inc();
+    } else {
+        metric_upload_failure.inc();
+    }
 
 #ifdef DEBUG
-        Serial.print("Sensor Data: ");
-        Serial.print(sensor_data.temperature);
-        Serial.print(" С ");
-        Serial.print(sensor_data.co2);
-        Serial.print(" ppm ");
-        Serial.print(sensor_data.humidity);
-        Serial.println("%");
-
-#ifdef PIN_FAN_PWM
-        Serial.print("Fan PWM duty: ");
-        Serial.print(sensor_data.fan_speed);
-        Serial.println("%");
+    if (success) {
+        Serial.println("Sensor data published");
+    } else {
+        Serial.print("MQTT publish failed, in flight: ");
+        Serial.println(mqtt.inflight());
+    }
 #endif
 
-#ifdef PIN_HUMIDIFIER_PWM
-        Serial.print("Humidifier PWM duty: ");
-        Serial.print(sensor_data.humidifier_power);
-        Serial.println("%");
-#endif
-#endif
+    return success;
+}
+
+// Keeps MQTT session alive and handles acknowledgements, connection is closed when HTTP is selected
+void update_mqtt(const SettingsEntry &config) {
+    if (config.upload_transport != UPLOAD_MQTT) {
+        if (mqtt.connected()) mqtt.disconnect();
+    } else {
+        mqtt.loop();
     }
+
+    count_mqtt_bytes();
 }
 
-[[noreturn]] void data_loop(void *) {
-    for (;;) {
-        esp_task_wdt_reset();
+void send_sensor_data() {
+    const auto config = settings.get();
+    update_mqtt(*config);
 
-        update_sensor_data();
-        process_alerts();
+    // Data is sent on the next interval after reconnect
+    if (!is_connected()) return;
+
+    if (sensor_last_send == 0ul || (millis() - sensor_last_send) > config->sensor_send_interval) {
+        // Broker doesn't acknowledge messages in flight, wait for PUBACKs or resends instead of failing every iteration
+        if (config->upload_transport == UPLOAD_MQTT && mqtt.connected() && mqtt.window_free() < ZONE_COUNT) return;
 
-        if (!is_connected()) {
 #ifdef DEBUG
-            Serial.println("WiFi lost connection");
+        Serial.println("Sending sensor data...");
 #endif
-            wifi_connect();
+        const auto upload_start = millis();
+        float values[ZONE_COUNT][CHANNEL_COUNT];
+        for (uint8_t zone = 0; zone < ZONE_COUNT; ++zone) sensor_data[zone].copy_to(values[zone]);
+
+        const bool success = config->upload_transport == UPLOAD_MQTT
+                             ? publish_sensor_data(values)
+                             : post_sensor_data(values) == 200;
+
+        // Upload blocks the data task on network, it's the main source of its latency
+        const uint32_t upload_time = millis() - upload_start;
+        metric_upload_duration.observe(upload_time);
+        profile_data.blocked(upload_time * 1000);
+
+        update_send_latency(upload_time);
+        if (success) sensor_last_send = millis();
+    }
+}
+
+float sample_temperature(uint8_t zone) {
+    return bme[zone].readTemperature();
+}
+
+float sample_humidity(uint8_t zone) {
+    return bme[zone].readHumidity();
+}
+
+float sample_co2(uint8_t zone) {
+    const auto co2 = Mhz19[zone].getCO2(false);
+    return co2 >= 400 && co2 <= 5000 ? (float) co2 : NAN;
+}
+
+// Invalid reading keeps the last valid value of the channel
+void sample_sensors(uint8_t zone, const SettingsEntry &config) {
+    auto &data = sensor_data[zone];
+    for (uint8_t i = 0; i < SENSOR_COUNT; ++i) {
+        const float value = Channels[i].sample(zone);
+        if (!isnan(value)) data.values[i] = value + config.zones[zone].calibration[i];
+    }
+}
+
+void update_schedules(uint8_t zone, const SettingsEntry &config) {
+    for (uint8_t i = 0; i < ACTUATOR_COUNT; ++i) {
+        const auto &output = Zones[zone].actuators[i];
+        if (output.pin >= 0) {
+            Schedules[zone][i].update(Channels[ACTUATOR_FIRST + i], output, sensor_data[zone], config.zones[zone].schedules[i]);
         }
+    }
+}
 
-        send_sensor_data();
-        settings.timer().handle_timers();
+void calibrate_requested_co2() {
+    const uint8_t zones = co2_calibration_requested.exchange(0);
+    for (uint8_t zone = 0; zone < ZONE_COUNT; ++zone) {
+        if (!(zones & (1u << zone))) continue;
+
+        Mhz19[zone].calibrate();
 
-        delay(100);
+#ifdef DEBUG
+        Serial.print("CO2 sensor calibrated: ");
+        Serial.println(Zones[zone].name);
+#endif
     }
 }
 
-String get_current_display_string() {
-    switch (current_state) {
-        case WARM_UP:
-            return "Warming up...";
+/*
+ * One zone is sampled per turn and turns are spread evenly over the update interval,
+ * so sensor reads of different zones and buses are interleaved and an iteration blocks on a single zone.
+ */
+void update_sensor_data() {
+    const auto config = settings.get();
+    const auto turn_interval = config->sensor_update_interval / ZONE_COUNT;
+    if (sample_last_time == 0ul || (millis() - sample_last_time) > turn_interval) {
+        calibrate_requested_co2();
+
+        const uint8_t zone = sample_next_zone;
+        sample_next_zone = (zone + 1) % ZONE_COUNT;
+
+        auto &data = sensor_data[zone];
+        sample_sensors(zone, *config);
+        update_schedules(zone, *config);
 
-        case DISPLAY_ALERT:
-            return alert_display_string;
+        data.last_update = sample_last_time = millis();
 
-        case DISPLAY_SENSOR:
-        case PENDING_ALERT:
-        default:
-            return sensor_data.display_string;
+        publish_event(EVENT_SAMPLE_UPDATED, zone);
+        process_alerts(zone);
+
+        // Warm up message stays until there is something to show.
+        // Text is sent only when it changes, several zones take turns on the display
+        if (data.ready() && (data.update_string() || ZONE_COUNT > 1)) {
+            char buffer[DISPLAY_TEXT_MAX_LENGTH + 1];
+            TextBuffer text(buffer);
+            zone_display_prefix(text, zone);
+            text.text(data.display_string);
+
+            display_show_text(buffer);
+        }
+
+#ifdef DEBUG
+        Serial.print("Sensor Data ");
+        Serial.print(Zones[zone].name);
+        Serial.print(':');
+        for (auto &channel: Channels) {
+            Serial.print(' ');
+            Serial.print(channel.name);
+            Serial.print(' ');
+            Serial.print(data.values[channel.id], channel.fraction);
+            Serial.print(' ');
+            Serial.print(channel.unit);
+        }
+        Serial.println();
+#endif
     }
 }
 
-void next_step() {
-    State next;
-    switch (current_state) {
-        case WARM_UP:
-            next = sensor_data.ready() ? DISPLAY_SENSOR : WARM_UP;
-            break;
+void init_sensors() {
+    boot_phase_begin(BOOT_SENSORS);
+
+    // Zones can share a bus or UART, each of them is started once
+    uint8_t started_buses = 0;
+    uint8_t started_uarts = 0;
+
+    for (uint8_t zone = 0; zone < ZONE_COUNT; ++zone) {
+        const auto &info = Zones[zone];
+
+        auto *bus = SensorBuses[info.i2c_bus];
+        if (!(started_buses & (1u << info.i2c_bus))) {
+            bus->begin(info.sda, info.scl, 1e5);
+            started_buses |= 1u << info.i2c_bus;
+        }
+
+        bme[zone].begin(info.bme_address, bus);
+
+        auto &uart = sensor_uart(info.co2_uart);
+        if (!(started_uarts & (1u << info.co2_uart))) {
+            uart.begin(9600, SERIAL_8N1, info.co2_rx, info.co2_tx);
+            started_uarts |= 1u << info.co2_uart;
+        }
 
-        case PENDING_ALERT:
-            next = DISPLAY_ALERT;
-            break;
+        Mhz19[zone].begin(uart);
+        Mhz19[zone].setRange(5000);
+        Mhz19[zone].autoCalibration(false);
+    }
+
+    boot_phase_end(BOOT_SENSORS);
+}
 
-        case DISPLAY_SENSOR:
-        case DISPLAY_ALERT:
-        default:
-            next = DISPLAY_SENSOR;
-            break;
+void handle_data_events() {
+    Event event;
+    while (data_events.take(event)) {
+        switch (event.type) {
+            // Calibration and schedules apply on the next sample, so it's taken right away
+            case EVENT_SETTINGS_CHANGED:
+                sample_last_time = 0;
+                break;
+
+            // Upload which is due is sent by this iteration instead of the next one
+            case EVENT_LINK_UP:
+            default:
+                break;
+        }
     }
+}
+
+[[noreturn]] void data_loop(void *) {
+    // Sampling starts right away, uploads begin when network is up
+    init_sensors();
+
+    for (;;) {
+        profile_data.begin();
+        esp_task_wdt_reset();
 
-    sensor_data.update_string();
-    current_state = next;
-}
\ No newline at end of file
+        handle_data_events();
+        update_sensor_data();
+
+        send_sensor_data();
+        settings.timer().handle_timers();
+
+        profile_data.end();
+        data_events.wait(pdMS_TO_TICKS(DATA_LOOP_DELAY));
+    }
+}
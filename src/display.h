@@ -2,70 +2,186 @@
 
 #include "Arduino.h"
 
-#include "data.h"
+#include "boot.h"
+#include "channels.h"
 #include "debug.h"
+#include "display_queue.h"
+#include "event_bus.h"
 #include "hardware.h"
+#include "metrics.h"
+#include "profiler.h"
+#include "scroll_text.h"
 #include "sound.h"
 #include "settings.h"
-#include "wifi_control.h"
+#include "text_format.h"
+#include "zones.h"
+
+// Delay between frames while text is not scrolling, commands still wake the task up immediately
+const unsigned long DISPLAY_IDLE_DELAY = 1000;
 
 static uint16_t current_letter_index = 0;
 
-[[noreturn]] void ui_loop(void *) {
-    for (;;) {
-        while (xSemaphoreTake(wifi_connection_mutex, mutex_wait_time) != pdTRUE) {
-#ifdef DEBUG
-            Serial.println("Can't take mutex (ui_loop)");
-#endif
-        }
+// Text of the current scroll pass, rendered when the pass starts
+static ScrollText<width> scroll_text;
 
-        const auto &config = settings.get();
-        matrix.setIntensity(config.screen_brightness);
-        matrix.setRotation(config.screen_rotation);
-        matrix.fillScreen(LOW);
+static char display_text[DISPLAY_TEXT_MAX_LENGTH + 1] = "Warming up...";
+static char display_alert_text[DISPLAY_TEXT_MAX_LENGTH + 1] = "";
 
-        const auto &display_string = get_current_display_string();
-        const uint16_t max_index = width * display_string.length() + end_spacer - spacer;
-        if (display_string.length() == 0 || current_letter_index > max_index) {
-            current_letter_index = 0;
-            next_step();
+// Scroll text is rendered again only when the text or an alert replaces it
+static bool display_text_rendered = false;
 
-            xSemaphoreGive(wifi_connection_mutex);
-            delay(config.text_loop_delay);
-            continue;
-        }
+static bool display_warming_up = true;
+static bool display_alert_pending = false;
 
-        if (current_state == State::WARM_UP && sensor_data.ready()) {
-            current_letter_index = 0;
-            next_step();
+static bool display_glyph_active = false;
+static unsigned long display_glyph_until = 0;
 
-            xSemaphoreGive(wifi_connection_mutex);
-            delay(config.text_animation_delay);
-            continue;
-        }
+static unsigned int text_animation_delay = 0;
+static unsigned int text_loop_delay = 0;
+
+void apply_display_settings() {
+    const auto config = settings.get();
+    matrix.setIntensity(config->screen_brightness);
+    matrix.setRotation(config->screen_rotation);
+
+    text_animation_delay = config->text_animation_delay;
+    text_loop_delay = config->text_loop_delay;
+}
+
+void show_alert_event(const Event &event) {
+    const auto &channel = Channels[event.channel];
 
-        if (current_letter_index == 0 && current_state == State::DISPLAY_ALERT) {
-            play_sound(SOUND_ALERT);
+    TextBuffer text(display_alert_text);
+    text.text("ALERT ");
+    zone_display_prefix(text, event.zone);
+    text.text(channel.name).text(": ").fixed(event.value, channel.fraction).text(" ").text(channel.unit);
+
+    // Only the latest alert is shown after the current pass
+    display_alert_pending = true;
+}
+
+void handle_display_events() {
+    Event event;
+    while (ui_events.take(event)) {
+        switch (event.type) {
+            case EVENT_ALERT_RAISED:
+                show_alert_event(event);
+                break;
+
+            case EVENT_SETTINGS_CHANGED:
+                apply_display_settings();
+                break;
+
+            default:
+                break;
         }
+    }
+}
+
+void handle_display_command(const DisplayCommand &command, unsigned long &next_frame) {
+    switch (command.type) {
+        case DISPLAY_TEXT:
+            if (strcmp(display_text, command.text) != 0) {
+                memcpy(display_text, command.text, sizeof(display_text));
+                display_text_rendered = false;
+            }
 
-        int letter = current_letter_index / width;
-        int x = (matrix.width() - 1) - current_letter_index % width;
-        int y = (matrix.height() - height) / 2;
+            // First data replaces warm up message right away
+            if (display_warming_up) {
+                display_warming_up = false;
+                current_letter_index = 0;
 
-        while (x + width - spacer >= 0 && letter >= 0) {
-            if (letter < display_string.length()) {
-                matrix.drawChar((int16_t) x, (int16_t) y, display_string[letter], HIGH, LOW, 1);
+                if (!display_glyph_active) next_frame = millis();
             }
+            break;
+
+        case DISPLAY_EVENTS:
+            handle_display_events();
+            break;
+
+        case DISPLAY_GLYPH:
+            matrix.fillScreen(LOW);
+            matrix.drawChar(command.x, 0, command.glyph, HIGH, LOW, 1);
+            matrix.write();
+
+            display_glyph_active = true;
+            display_glyph_until = command.hold ? millis() + command.hold : 0;
+            next_frame = millis() + (command.hold ? command.hold : DISPLAY_IDLE_DELAY);
+            break;
+
+    }
+}
 
-            letter--;
-            x -= width;
+// Returns delay before the next frame
+unsigned long render_display_frame() {
+    if (display_glyph_active) {
+        if (display_glyph_until == 0) return DISPLAY_IDLE_DELAY;
+
+        const long left = (long) (display_glyph_until - millis());
+        if (left > 0) return left;
+
+        display_glyph_active = false;
+        current_letter_index = 0;
+    }
+
+    matrix.fillScreen(LOW);
+
+    if (current_letter_index == 0) {
+        const bool alert = display_alert_pending;
+        display_alert_pending = false;
+
+        if (alert) {
+            scroll_text.render(display_alert_text);
+            display_text_rendered = false;
+
+            play_sound(SOUND_ALERT, SOUND_PRIORITY_HIGH);
+        } else if (!display_text_rendered) {
+            scroll_text.render(display_text);
+            display_text_rendered = true;
+        }
+    }
+
+    const uint16_t max_index = scroll_text.length() + end_spacer - spacer;
+    if (scroll_text.length() == 0 || current_letter_index > max_index) {
+        current_letter_index = 0;
+        return text_loop_delay;
+    }
+
+    // Text enters from the right edge, one column per frame
+    scroll_text.draw(matrix, (int32_t) current_letter_index - (matrix.width() - 1), (matrix.height() - height) / 2);
+
+    ++current_letter_index;
+
+    matrix.write();
+    return text_animation_delay;
+}
+
+[[noreturn]] void ui_loop(void *) {
+    boot_phase_begin(BOOT_DISPLAY);
+    apply_display_settings();
+    boot_phase_end(BOOT_DISPLAY);
+
+    unsigned long next_frame = millis();
+    for (;;) {
+        // Waiting for commands is the frame delay, so they are handled without waiting for the frame end
+        const long wait = (long) (next_frame - millis());
+
+        DisplayCommand command;
+        if (xQueueReceive(display_queue, &command, wait > 0 ? pdMS_TO_TICKS(wait) : 0) == pdTRUE) {
+            profile_ui.begin();
+
+            handle_display_command(command, next_frame);
+
+            profile_ui.end();
+            continue;
         }
 
-        ++current_letter_index;
+        profile_ui.begin();
+        handle_display_events();
 
-        matrix.write();
-        delay(config.text_animation_delay);
+        const auto frame_delay = render_display_frame();
+        next_frame = millis() + frame_delay;
 
-        xSemaphoreGive(wifi_connection_mutex);
+        profile_ui.end();
     }
-}
\ No newline at end of file
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <Arduino.h>
+
+#include "debug.h"
+#include "scroll_text.h"
+
+#define DISPLAY_QUEUE_LENGTH 8
+#define DISPLAY_TEXT_MAX_LENGTH SCROLL_TEXT_MAX_LENGTH
+
+enum DisplayCommandType : uint8_t {
+    // Replace regular scrolling text, it is picked up at the next pass
+    DISPLAY_TEXT,
+
+    // Show single glyph instead of the text
+    DISPLAY_GLYPH,
+
+    // Take events from the bus subscription of the UI task
+    DISPLAY_EVENTS,
+};
+
+struct DisplayCommand {
+    DisplayCommandType type;
+
+    char glyph;
+    int8_t x;
+
+    // How long glyph stays before the text resumes, 0 keeps it until the next glyph
+    uint16_t hold;
+
+    char text[DISPLAY_TEXT_MAX_LENGTH + 1];
+};
+
+/*
+ * Matrix is owned by the UI task, other tasks only post commands here.
+ * Sending never blocks: if UI task can't keep up the command is dropped.
+ */
+static QueueHandle_t display_queue = xQueueCreate(DISPLAY_QUEUE_LENGTH, sizeof(DisplayCommand));
+
+static const DisplayCommand DISPLAY_WAKEUP_COMMAND{DISPLAY_EVENTS};
+
+void _display_send(const DisplayCommand &command) {
+    if (xQueueSend(display_queue, &command, 0) != pdTRUE) {
+#ifdef DEBUG
+        Serial.println("Display queue is full, command dropped");
+#endif
+    }
+}
+
+void _display_send_text(DisplayCommandType type, const char *text) {
+    DisplayCommand command{type};
+    strncpy(command.text, text, DISPLAY_TEXT_MAX_LENGTH);
+
+    _display_send(command);
+}
+
+inline void display_show_text(const char *text) { _display_send_text(DISPLAY_TEXT, text); }
+
+
+void display_show_glyph(char glyph, int8_t x = 0, uint16_t hold = 0) {
+    DisplayCommand command{DISPLAY_GLYPH};
+    command.glyph = glyph;
+    command.x = x;
+    command.hold = hold;
+
+    _display_send(command);
+}
+
+// UI task also takes events on every frame, so wake up dropped on full queue only delays them
+void display_wakeup() { xQueueSend(display_queue, &DISPLAY_WAKEUP_COMMAND, 0); }
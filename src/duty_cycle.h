@@ -0,0 +1,150 @@
+#pragma once
+
+#include <stdint.h>
+
+/*
+ * Scheduling of low-power modes: when to sample, when to bring the radio up and how long to sleep.
+ * It has no hardware dependencies and gets time from injected Clock, so it can run on host with simulated clock.
+ */
+
+class Clock {
+public:
+    virtual uint64_t now_ms() const = 0;
+};
+
+struct DutyCycleConfig {
+    uint32_t sample_interval;
+    uint32_t upload_interval;
+
+    // Radio is brought up when this many samples are waiting
+    uint8_t batch_size;
+};
+
+// Lives in RTC memory, so it must be plain data
+struct DutyCycleState {
+    uint64_t next_sample;
+    uint64_t last_upload;
+    uint8_t pending;
+
+    // Uploads failed in a row
+    uint8_t failures;
+};
+
+class DutyCycle {
+    const Clock &_clock;
+    DutyCycleState &_state;
+    DutyCycleConfig _config;
+
+public:
+    DutyCycle(const Clock &clock, DutyCycleState &state, const DutyCycleConfig &config)
+            : _clock(clock), _state(state), _config(config) {}
+
+    inline bool sample_due() const { return _clock.now_ms() >= _state.next_sample; }
+
+    void sampled() {
+        if (_state.pending < _config.batch_size) ++_state.pending;
+
+        // Missed samples are skipped instead of being taken back to back
+        const uint64_t now = _clock.now_ms();
+        _state.next_sample += _config.sample_interval;
+        if (_state.next_sample <= now) _state.next_sample = now + _config.sample_interval;
+    }
+
+    // Batch storage is full and lost its oldest samples
+    void dropped(uint8_t count) {
+        _state.pending = count < _state.pending ? _state.pending - count : 0;
+    }
+
+    /*
+     * Alert, full batch and full sample storage (when storage is measured in bytes rather than samples)
+     * send right away, unless previous uploads failed and the retry delay isn't over
+     */
+    bool upload_due(bool alert, bool storage_full = false) const {
+        if (_state.pending == 0) return false;
+
+        const uint64_t since_upload = _clock.now_ms() - _state.last_upload;
+        if (since_upload >= _config.upload_interval) return true;
+
+        const bool early = alert || storage_full || _state.pending >= _config.batch_size;
+        return early && since_upload >= retry_delay();
+    }
+
+    // Failed upload keeps samples. Retry delay grows with failures, so dead network doesn't drain battery
+    void uploaded(uint8_t sent) {
+        if (sent > 0) _state.failures = 0;
+        else if (_state.failures < UINT8_MAX) ++_state.failures;
+
+        _state.pending = sent < _state.pending ? _state.pending - sent : 0;
+        _state.last_upload = _clock.now_ms();
+    }
+
+    // Two sample intervals after the first failure, doubled with every next one up to the upload interval
+    uint64_t retry_delay() const {
+        if (_state.failures == 0) return 0;
+
+        const uint8_t shift = _state.failures < 16 ? _state.failures : 16;
+        const uint64_t delay = (uint64_t) _config.sample_interval << shift;
+        return delay < _config.upload_interval ? delay : _config.upload_interval;
+    }
+
+    inline uint8_t pending() const { return _state.pending; }
+
+    uint32_t sleep_duration() const {
+        const uint64_t now = _clock.now_ms();
+        return _state.next_sample > now ? (uint32_t) (_state.next_sample - now) : 0;
+    }
+};
+
+/*
+ * Rough energy model of the board. Currents are typical datasheet figures for ESP32 and are estimates only,
+ * sensors and display are not included.
+ */
+struct PowerProfile {
+    const char *name;
+
+    float active_ma;
+    float radio_ma;
+    float sleep_ma;
+};
+
+const float POWER_SUPPLY_VOLTAGE = 3.3f;
+
+// Wi-Fi without power save keeps the radio listening all the time, so it's counted as active current
+const PowerProfile POWER_PROFILE_ALWAYS_ON = {"always_on", 110.0f, 0.0f, 0.0f};
+const PowerProfile POWER_PROFILE_LIGHT_SLEEP = {"light_sleep", 40.0f, 120.0f, 0.8f};
+const PowerProfile POWER_PROFILE_DEEP_SLEEP = {"deep_sleep", 40.0f, 120.0f, 0.01f};
+
+class EnergyMeter {
+    const PowerProfile &_profile;
+
+    // Accumulated time in milliseconds, kept by caller (e.g. in RTC memory)
+    struct Totals {
+        uint64_t active;
+        uint64_t radio;
+        uint64_t sleep;
+        uint32_t samples;
+    } &_totals;
+
+public:
+    typedef Totals State;
+
+    EnergyMeter(const PowerProfile &profile, State &totals) : _profile(profile), _totals(totals) {}
+
+    inline void active(uint32_t ms) { _totals.active += ms; }
+    inline void radio(uint32_t ms) { _totals.radio += ms; }
+    inline void sleep(uint32_t ms) { _totals.sleep += ms; }
+    inline void sample() { ++_totals.samples; }
+
+    // Joules spent since power-on
+    float energy() const {
+        const float ma_ms = _profile.active_ma * (float) _totals.active
+                            + _profile.radio_ma * (float) _totals.radio
+                            + _profile.sleep_ma * (float) _totals.sleep;
+
+        return ma_ms * 1e-6f * POWER_SUPPLY_VOLTAGE;
+    }
+
+    float energy_per_sample() const {
+        return _totals.samples ? energy() / (float) _totals.samples : 0;
+    }
+};
@@ -0,0 +1,112 @@
+#pragma once
+
+#include <Arduino.h>
+
+#include "debug.h"
+#include "display_queue.h"
+#include "events.h"
+#include "metrics.h"
+#include "models.h"
+
+#define EVENT_QUEUE_LENGTH 8
+
+enum EventType : uint8_t {
+    // Zone is sampled, its sensor data and actuator duty are updated
+    EVENT_SAMPLE_UPDATED,
+
+    // Channel of the zone went out of alert range or returned into it
+    EVENT_ALERT_RAISED,
+    EVENT_ALERT_CLEARED,
+
+    // Settings snapshot is replaced
+    EVENT_SETTINGS_CHANGED,
+
+    // Wi-Fi got IP or lost it
+    EVENT_LINK_UP,
+    EVENT_LINK_DOWN,
+};
+
+#define EVENT_BIT(type) (1u << (type))
+
+struct Event {
+    EventType type;
+
+    // Sample and alert events only
+    uint8_t zone;
+    ChannelId channel;
+    float value;
+};
+
+/*
+ * Subscription to the event bus: fixed-length FreeRTOS queue of event types in the mask.
+ * Publisher calls wakeup after the event is queued, so task blocked on something else reacts right away.
+ */
+class EventQueue {
+    QueueHandle_t _queue;
+    uint32_t _mask;
+    void (*_wakeup)();
+
+public:
+    explicit EventQueue(uint32_t mask, void (*wakeup)() = nullptr)
+            : _queue(xQueueCreate(EVENT_QUEUE_LENGTH, sizeof(Event))), _mask(mask), _wakeup(wakeup) {}
+
+    inline bool accepts(EventType type) const { return _mask & EVENT_BIT(type); }
+
+    // Never blocks the publisher, returns false if queue is full
+    bool push(const Event &event) {
+        if (xQueueSend(_queue, &event, 0) != pdTRUE) return false;
+        if (_wakeup) _wakeup();
+
+        return true;
+    }
+
+    inline bool take(Event &event) { return xQueueReceive(_queue, &event, 0) == pdTRUE; }
+
+    // Waits until there is an event without taking it
+    bool wait(TickType_t timeout) {
+        Event event;
+        return xQueuePeek(_queue, &event, timeout) == pdTRUE;
+    }
+};
+
+void _event_wakeup_ui() { display_wakeup(); }
+
+void _event_wakeup_web() { xSemaphoreGive(web_task_wakeup); }
+
+// Alerts for display, settings for display configuration
+static EventQueue ui_events(EVENT_BIT(EVENT_ALERT_RAISED) | EVENT_BIT(EVENT_SETTINGS_CHANGED), _event_wakeup_ui);
+
+// New settings apply at once, upload is retried as soon as link is up
+static EventQueue data_events(EVENT_BIT(EVENT_SETTINGS_CHANGED) | EVENT_BIT(EVENT_LINK_UP));
+
+// Everything that changes status or is streamed to the Web UI
+static EventQueue web_events(EVENT_BIT(EVENT_SAMPLE_UPDATED) | EVENT_BIT(EVENT_ALERT_RAISED) | EVENT_BIT(EVENT_ALERT_CLEARED)
+                             | EVENT_BIT(EVENT_SETTINGS_CHANGED) | EVENT_BIT(EVENT_LINK_UP) | EVENT_BIT(EVENT_LINK_DOWN),
+                             _event_wakeup_web);
+
+static EventQueue *const EventSubscribers[] = {&ui_events, &data_events, &web_events};
+
+/*
+ * Event is copied into queue of every subscribed task, slow subscriber loses its own events only.
+ * Safe to call from any task and from Wi-Fi event handler.
+ */
+void publish_event(const Event &event) {
+    for (auto *subscriber: EventSubscribers) {
+        if (!subscriber->accepts(event.type)) continue;
+
+        if (!subscriber->push(event)) {
+            metric_events_dropped.inc();
+
+#ifdef DEBUG
+            Serial.print("Event queue is full, event dropped: ");
+            Serial.println(event.type);
+#endif
+        }
+    }
+}
+
+inline void publish_event(EventType type) { publish_event(Event{type, 0, CHANNEL_COUNT, NAN}); }
+
+inline void publish_event(EventType type, uint8_t zone, ChannelId channel = CHANNEL_COUNT, float value = NAN) {
+    publish_event(Event{type, zone, channel, value});
+}
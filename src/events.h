@@ -0,0 +1,36 @@
+#pragma once
+
+#include <Arduino.h>
+#include <ESPAsyncWebServer.h>
+
+#include "debug.h"
+
+#define EVENT_STREAM_MAX_SUBSCRIBERS 4
+
+// Wakes up web task when there is something to deliver or execute
+static SemaphoreHandle_t web_task_wakeup = xSemaphoreCreateBinary();
+
+/*
+ * Server-Sent Events channel.
+ * Messages are sent to subscribers by the web task, when it gets changes from the event bus.
+ */
+class EventStream {
+    AsyncEventSource _source;
+
+public:
+    explicit EventStream(const char *url) : _source(url) {
+        // Refused stream is reported to browser as error, so page can fallback to polling
+        _source.setFilter([this](AsyncWebServerRequest *) {
+            return _source.count() < EVENT_STREAM_MAX_SUBSCRIBERS;
+        });
+    }
+
+    inline AsyncEventSource &source() { return _source; }
+
+    inline bool has_subscribers() const { return _source.count() > 0; }
+
+    // Named events are ignored by the page's onmessage, so they don't mix with status
+    inline void broadcast(const char *data, const char *event = nullptr) { _source.send(data, event); }
+};
+
+static EventStream status_events("/events");
@@ -9,22 +9,8 @@
 #include <Max72xxPanel.h>
 #include <MHZ19.h>
 
-#define PIN_MATRIX_CS 5
-#define PIN_SPEAKER 15
-#define PIN_FAN_PWM 32
-#define PIN_HUMIDIFIER_PWM 33
-#define PIN_BME_SDA 25
-#define PIN_BME_SCL 26
-
-#define UART_CO2 2
-
-#define PWM_CHANNEL_FAN 5
-#define PWM_CHANNEL_HUMIDIFIER 6
-
-const unsigned int BME_ADDRESS = 0x76;
-
-const unsigned long FAN_PWM_BITS = 8;
-const unsigned long HUMIDIFIER_PWM_BITS = 8;
+#include "pins.h"
+#include "zones.h"
 
 const int numberOfHorizontalDisplays = 1;
 const int numberOfVerticalDisplays = 1;
@@ -37,7 +23,23 @@ const int height = 8;
 static Max72xxPanel matrix = Max72xxPanel(PIN_MATRIX_CS, numberOfHorizontalDisplays, numberOfVerticalDisplays);
 
 static TwoWire bmeWire(0);
-static Adafruit_BME280 bme;
+static TwoWire bmeWire1(1);
 
-static MHZ19 Mhz19;
 static HardwareSerial co2Uart(UART_CO2);
+#ifdef UART_ZONE2_CO2
+static HardwareSerial co2Uart1(UART_ZONE2_CO2);
+#endif
+
+// Indexed by controller number of ZoneInfo
+static TwoWire *const SensorBuses[] = {&bmeWire, &bmeWire1};
+
+HardwareSerial &sensor_uart(uint8_t uart) {
+#ifdef UART_ZONE2_CO2
+    if (uart == UART_ZONE2_CO2) return co2Uart1;
+#endif
+    return co2Uart;
+}
+
+// Indexed by zone
+static Adafruit_BME280 bme[ZONE_COUNT];
+static MHZ19 Mhz19[ZONE_COUNT];
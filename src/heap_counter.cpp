@@ -0,0 +1,61 @@
+#include "heap_counter.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+static std::atomic<uint32_t> allocations{0};
+
+uint32_t heap_allocations() {
+    return allocations.load(std::memory_order_relaxed);
+}
+
+#ifdef ARDUINO_ARCH_ESP32
+
+extern "C" {
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t count, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+
+void *__wrap_malloc(size_t size) {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t count, size_t size) {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    return __real_calloc(count, size);
+}
+
+// Shrinking and freeing with realloc aren't allocations, but it can't be told apart from growing in place
+void *__wrap_realloc(void *ptr, size_t size) {
+    if (size > 0) allocations.fetch_add(1, std::memory_order_relaxed);
+    return __real_realloc(ptr, size);
+}
+}
+
+#else
+
+// libc of the host isn't linked statically, so global operator new is replaced instead
+void *operator new(size_t size) {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+
+    void *ptr = malloc(size ? size : 1);
+    if (ptr == nullptr) throw std::bad_alloc();
+
+    return ptr;
+}
+
+void *operator new[](size_t size) {
+    return operator new(size);
+}
+
+void operator delete(void *ptr) noexcept {
+    free(ptr);
+}
+
+void operator delete[](void *ptr) noexcept {
+    free(ptr);
+}
+
+#endif
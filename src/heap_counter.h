@@ -0,0 +1,10 @@
+#pragma once
+
+#include <cstdint>
+
+/*
+ * Number of heap allocations since boot, including reallocations.
+ * On ESP32 malloc, calloc and realloc are wrapped by the linker (see build_flags), so C and C++ allocations
+ * of the firmware and of the prebuilt libraries are counted. Host build counts C++ allocations only.
+ */
+uint32_t heap_allocations();
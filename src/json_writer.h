@@ -0,0 +1,287 @@
+#pragma once
+
+#include <Arduino.h>
+
+#include <type_traits>
+
+/*
+ * Output for generated text which copies only [offset, offset + size) window into the buffer.
+ * Text which doesn't fit is only counted, so overflow() tells the buffer was too small.
+ * Without buffer it just counts length of the text.
+ */
+class ChunkWriter {
+    uint8_t *_buffer;
+    size_t _size;
+    size_t _offset;
+    size_t _position = 0;
+
+public:
+    ChunkWriter(uint8_t *buffer, size_t size, size_t offset = 0) : _buffer(buffer), _size(size), _offset(offset) {}
+
+    // Total length of generated text
+    inline size_t position() const { return _position; }
+
+    // Bytes copied into buffer
+    inline size_t written() const {
+        if (_position <= _offset) return 0;
+        return std::min(_position - _offset, _size);
+    }
+
+    inline bool overflow() const { return _position > _offset + _size; }
+
+    void write(const char *data, size_t length) {
+        const size_t begin = _position;
+        _position += length;
+
+        if (_buffer == nullptr || _position <= _offset || begin >= _offset + _size) return;
+
+        const size_t from = begin < _offset ? _offset - begin : 0;
+        const size_t to = std::min(length, _offset + _size - begin);
+        memcpy(_buffer + (begin + from - _offset), data + from, to - from);
+    }
+
+    inline void write(char c) { write(&c, 1); }
+};
+
+/*
+ * Streaming JSON serializer without intermediate document.
+ * Numbers are formatted exactly like ArduinoJson 6 does, so output is the same as with StaticJsonDocument.
+ */
+class JsonWriter {
+    ChunkWriter &_out;
+
+    // Bit per nesting level (up to 32), set when level already has items and needs separator
+    uint32_t _has_items = 0;
+    uint8_t _depth = 0;
+    bool _after_key = false;
+
+public:
+    explicit JsonWriter(ChunkWriter &out) : _out(out) {}
+
+    void begin_object() {
+        _separator();
+        _out.write('{');
+
+        ++_depth;
+        _has_items &= ~(1ul << _depth);
+    }
+
+    void begin_object(const char *key) {
+        _key(key);
+        begin_object();
+    }
+
+    void end_object() {
+        --_depth;
+        _out.write('}');
+    }
+
+    template<typename T>
+    void field(const char *key, T value) {
+        _key(key);
+        this->value(value);
+    }
+
+    void value(bool value) {
+        _separator();
+        _raw(value ? "true" : "false");
+    }
+
+    void value(float value) {
+        _separator();
+        _float(value);
+    }
+
+    void value(double value) {
+        _separator();
+        _float(value);
+    }
+
+    void value(const char *value) {
+        _separator();
+        _string(value);
+    }
+
+    template<typename T>
+    typename std::enable_if<std::is_integral<T>::value && std::is_signed<T>::value>::type value(T value) {
+        _separator();
+        if (value < 0) {
+            _out.write('-');
+            _unsigned((unsigned long long) (-(long long) value));
+        } else {
+            _unsigned((unsigned long long) value);
+        }
+    }
+
+    template<typename T>
+    typename std::enable_if<std::is_integral<T>::value && !std::is_signed<T>::value>::type value(T value) {
+        _separator();
+        _unsigned((unsigned long long) value);
+    }
+
+    template<typename T>
+    typename std::enable_if<std::is_enum<T>::value>::type value(T value) {
+        this->value((typename std::underlying_type<T>::type) value);
+    }
+
+private:
+    void _separator() {
+        // Value right after key doesn't need separator, it's already written before the key
+        if (_after_key) {
+            _after_key = false;
+            return;
+        }
+
+        const uint32_t bit = 1ul << _depth;
+        if (_has_items & bit) _out.write(',');
+
+        _has_items |= bit;
+    }
+
+    void _key(const char *key) {
+        _separator();
+        _string(key);
+        _out.write(':');
+
+        _after_key = true;
+    }
+
+    inline void _raw(const char *str) { _out.write(str, strlen(str)); }
+
+    void _string(const char *str) {
+        _out.write('"');
+        for (const char *c = str; *c; ++c) {
+            const char *escape = nullptr;
+            switch (*c) {
+                case '"': escape = "\\\""; break;
+                case '\\': escape = "\\\\"; break;
+                case '\b': escape = "\\b"; break;
+                case '\f': escape = "\\f"; break;
+                case '\n': escape = "\\n"; break;
+                case '\r': escape = "\\r"; break;
+                case '\t': escape = "\\t"; break;
+                default: break;
+            }
+
+            if (escape) _raw(escape);
+            else _out.write(*c);
+        }
+
+        _out.write('"');
+    }
+
+    void _unsigned(unsigned long long value) {
+        char buffer[24];
+        char *end = buffer + sizeof(buffer);
+        char *begin = end;
+
+        do {
+            *--begin = char('0' + value % 10);
+            value /= 10;
+        } while (value);
+
+        _out.write(begin, end - begin);
+    }
+
+    void _decimals(uint32_t value, int8_t width) {
+        char buffer[16];
+        char *end = buffer + sizeof(buffer);
+        char *begin = end;
+
+        while (width--) {
+            *--begin = char('0' + value % 10);
+            value /= 10;
+        }
+
+        *--begin = '.';
+        _out.write(begin, end - begin);
+    }
+
+    // Port of ArduinoJson's TextFormatter::writeFloat() with FloatParts<double>
+    void _float(double value) {
+        if (isnan(value) || isinf(value)) return _raw("null");
+
+        if (value < 0.0) {
+            _out.write('-');
+            value = -value;
+        }
+
+        uint32_t max_decimal_part = 1000000000;
+        int8_t decimal_places = 9;
+
+        int16_t exponent = _normalize(value);
+
+        uint32_t integral = uint32_t(value);
+        for (uint32_t tmp = integral; tmp >= 10; tmp /= 10) {
+            max_decimal_part /= 10;
+            decimal_places--;
+        }
+
+        double remainder = (value - double(integral)) * double(max_decimal_part);
+
+        uint32_t decimal = uint32_t(remainder);
+        remainder = remainder - double(decimal);
+
+        decimal += uint32_t(remainder * 2);
+        if (decimal >= max_decimal_part) {
+            decimal = 0;
+            integral++;
+            if (exponent && integral >= 10) {
+                exponent++;
+                integral = 1;
+            }
+        }
+
+        while (decimal % 10 == 0 && decimal_places > 0) {
+            decimal /= 10;
+            decimal_places--;
+        }
+
+        _unsigned(integral);
+        if (decimal_places) _decimals(decimal, decimal_places);
+
+        if (exponent) {
+            _out.write('e');
+            if (exponent < 0) {
+                _out.write('-');
+                _unsigned((unsigned long long) -exponent);
+            } else {
+                _unsigned((unsigned long long) exponent);
+            }
+        }
+    }
+
+    static int16_t _normalize(double &value) {
+        // 10^(2^i), 10^-(2^i) and 10^(1-2^i)
+        static const double positive[] = {1e1, 1e2, 1e4, 1e8, 1e16, 1e32, 1e64, 1e128, 1e256};
+        static const double negative[] = {1e-1, 1e-2, 1e-4, 1e-8, 1e-16, 1e-32, 1e-64, 1e-128, 1e-256};
+        static const double negative_plus_one[] = {1e0, 1e-1, 1e-3, 1e-7, 1e-15, 1e-31, 1e-63, 1e-127, 1e-255};
+
+        int16_t powers_of_10 = 0;
+
+        int8_t index = 8;
+        int bit = 1 << index;
+
+        if (value >= 1e7) {
+            for (; index >= 0; index--) {
+                if (value >= positive[index]) {
+                    value *= negative[index];
+                    powers_of_10 = int16_t(powers_of_10 + bit);
+                }
+                bit >>= 1;
+            }
+        }
+
+        if (value > 0 && value <= 1e-5) {
+            for (; index >= 0; index--) {
+                if (value < negative_plus_one[index]) {
+                    value *= positive[index];
+                    powers_of_10 = int16_t(powers_of_10 - bit);
+                }
+                bit >>= 1;
+            }
+        }
+
+        return powers_of_10;
+    }
+};
@@ -2,10 +2,12 @@
 #include <Arduino.h>
 #include <esp_task_wdt.h>
 
+#include "boot.h"
 #include "debug.h"
 #include "data.h"
 #include "display.h"
 #include "hardware.h"
+#include "power.h"
 #include "settings.h"
 #include "sound.h"
 #include "web_ui.h"
@@ -13,6 +15,9 @@
 
 #define WDT_TIMEOUT 60
 
+// Boot summary is printed when all phases are done or after this time
+const TickType_t BOOT_SUMMARY_TIMEOUT = pdMS_TO_TICKS(30000);
+
 TaskHandle_t UiTask;
 TaskHandle_t DataUpdateTask;
 TaskHandle_t WebTask;
@@ -23,26 +28,26 @@ void setup() {
     Serial.println("Initializing");
 #endif
 
+    boot_phase_begin(BOOT_SETTINGS);
     settings.begin();
-
-    const auto &config = settings.get();
-    matrix.setRotation(config.screen_rotation);
-    matrix.setIntensity(config.screen_brightness);
+#if POWER_MODE == POWER_ALWAYS_ON
+    speaker.begin();
+#endif
+    boot_phase_end(BOOT_SETTINGS);
 
     http.setReuse(true);
     client.setCACert(SSL_CERT);
 
-    bmeWire.begin(PIN_BME_SDA, PIN_BME_SCL, 1e5);
-    bme.begin(BME_ADDRESS, &bmeWire);
-
-    co2Uart.begin(9600);
-    Mhz19.begin(co2Uart);
+    mqtt_connection.setCACert(SSL_CERT);
+    mqtt.credentials(MQTT_CLIENT_ID, MQTT_USER, MQTT_PASSWORD);
 
-    Mhz19.setRange(5000);
-    Mhz19.autoCalibration(false);
+#if POWER_MODE != POWER_ALWAYS_ON
+    low_power_main();
+#endif
 
-    wifi_connect();
-    play_sound(SOUND_WIFI_ON);
+    // Everything else depends only on settings and comes up concurrently in its own task:
+    // display in UI task, sensors in data task, web server in web task and Wi-Fi in background
+    wifi_begin();
 
     xTaskCreatePinnedToCore(ui_loop, "UI", 10240, nullptr, 1, &UiTask, 0);
     xTaskCreatePinnedToCore(data_loop, "Data", 10240, nullptr, 1, &DataUpdateTask, 1);
@@ -50,6 +55,16 @@ void setup() {
 
     esp_task_wdt_init(WDT_TIMEOUT, true);
     esp_task_wdt_add(DataUpdateTask);
+
+#ifdef DEBUG
+    if (boot_wait(BOOT_ALL_BITS, BOOT_SUMMARY_TIMEOUT)) {
+        Serial.print("Boot completed in ");
+        Serial.print((long) (esp_timer_get_time() / 1000));
+        Serial.println(" ms");
+    } else {
+        Serial.println("Boot is not completed, see phases above");
+    }
+#endif
 }
 
 __attribute__((unused)) void loop() {}
\ No newline at end of file
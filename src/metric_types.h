@@ -0,0 +1,191 @@
+#pragma once
+
+#include <Arduino.h>
+#include <atomic>
+
+#include "channels.h"
+#include "zones.h"
+
+/*
+ * Metric types of the registry in metrics.h. Counters and histograms keep separate slot per core,
+ * so hot path is a single relaxed atomic add without contention between cores.
+ */
+
+enum MetricType : uint8_t {
+    COUNTER,
+    GAUGE,
+    HISTOGRAM,
+    CHANNEL_COUNTER,
+    EXTERNAL_COUNTER,
+};
+
+struct Metric {
+    const MetricType type;
+    const char *name;
+    const char *help;
+
+    // Optional label set without braces, e.g. task="UI"
+    const char *labels;
+};
+
+class Counter : public Metric {
+    std::atomic<uint32_t> _values[portNUM_PROCESSORS]{};
+
+public:
+    Counter(const char *name, const char *help, const char *labels = nullptr)
+            : Metric{MetricType::COUNTER, name, help, labels} {}
+
+    inline void inc(uint32_t amount = 1) {
+        _values[xPortGetCoreID()].fetch_add(amount, std::memory_order_relaxed);
+    }
+
+    uint32_t value() const {
+        uint32_t result = 0;
+        for (auto &value: _values) result += value.load(std::memory_order_relaxed);
+
+        return result;
+    }
+};
+
+/*
+ * Counter with series per zone and channel of the registry, label values are taken from Zones[] and Channels[].
+ * Zone label is added only when there are several zones.
+ */
+class ChannelCounter : public Metric {
+    const char *_label;
+    uint8_t _count;
+
+    std::atomic<uint32_t> _values[portNUM_PROCESSORS][ZONE_COUNT][CHANNEL_COUNT]{};
+
+public:
+    // Series are exported for channels with id below count
+    ChannelCounter(const char *name, const char *help, const char *label, uint8_t count)
+            : Metric{MetricType::CHANNEL_COUNTER, name, help, nullptr}, _label(label), _count(count) {}
+
+    inline void inc(uint8_t zone, ChannelId channel, uint32_t amount = 1) {
+        _values[xPortGetCoreID()][zone][channel].fetch_add(amount, std::memory_order_relaxed);
+    }
+
+    inline const char *label() const { return _label; }
+    inline uint8_t count() const { return _count; }
+
+    uint32_t value(uint8_t zone, uint8_t channel) const {
+        uint32_t result = 0;
+        for (auto &core: _values) result += core[zone][channel].load(std::memory_order_relaxed);
+
+        return result;
+    }
+};
+
+typedef uint32_t (*CounterFn)();
+
+// Counter kept outside of the registry (e.g. by allocator hooks), value is read at scrape time
+class ExternalCounter : public Metric {
+    CounterFn _fn;
+
+public:
+    ExternalCounter(const char *name, const char *help, CounterFn fn, const char *labels = nullptr)
+            : Metric{MetricType::EXTERNAL_COUNTER, name, help, labels}, _fn(fn) {}
+
+    inline uint32_t value() const { return _fn(); }
+};
+
+typedef float (*GaugeFn)(const void *arg);
+
+// Value is read at scrape time
+class Gauge : public Metric {
+    GaugeFn _fn;
+    const void *_arg;
+
+public:
+    Gauge(const char *name, const char *help, GaugeFn fn, const char *labels = nullptr, const void *arg = nullptr)
+            : Metric{MetricType::GAUGE, name, help, labels}, _fn(fn), _arg(arg) {}
+
+    inline float value() const { return _fn(_arg); }
+};
+
+// Largest observed value since boot, updated from hot path like a counter
+class PeakGauge : public Gauge {
+    std::atomic<uint32_t> _peak{0};
+    float _scale;
+
+    static float _read(const void *arg) {
+        auto gauge = (const PeakGauge *) arg;
+        return (float) gauge->peak() * gauge->_scale;
+    }
+
+public:
+    PeakGauge(const char *name, const char *help, float scale, const char *labels = nullptr)
+            : Gauge(name, help, _read, labels, this), _scale(scale) {}
+
+    void observe(uint32_t value) {
+        auto peak = _peak.load(std::memory_order_relaxed);
+        while (value > peak && !_peak.compare_exchange_weak(peak, value, std::memory_order_relaxed)) {}
+    }
+
+    inline uint32_t peak() const { return _peak.load(std::memory_order_relaxed); }
+};
+
+#define HISTOGRAM_MAX_BUCKETS 12
+
+class Histogram : public Metric {
+    const uint32_t *_bounds;
+    uint8_t _bucket_count;
+    float _scale;
+
+    // Last bucket is +Inf
+    std::atomic<uint32_t> _buckets[portNUM_PROCESSORS][HISTOGRAM_MAX_BUCKETS + 1]{};
+
+    // Sum is split into words, Xtensa has no lock-free 64-bit atomics. High word counts wraps of the low one,
+    // so sum of microseconds doesn't wrap after 71 minutes
+    std::atomic<uint32_t> _sum_low[portNUM_PROCESSORS]{};
+    std::atomic<uint32_t> _sum_high[portNUM_PROCESSORS]{};
+
+public:
+    // bounds are upper limits in observed units, scale converts them to exported units (e.g. 1e-6 for us -> s)
+    template<uint8_t SIZE>
+    Histogram(const char *name, const char *help, const uint32_t (&bounds)[SIZE], float scale,
+              const char *labels = nullptr)
+            : Metric{MetricType::HISTOGRAM, name, help, labels}, _bounds(bounds), _bucket_count(SIZE), _scale(scale) {
+        static_assert(SIZE <= HISTOGRAM_MAX_BUCKETS, "Too many histogram buckets");
+    }
+
+    void observe(uint32_t value) {
+        uint8_t bucket = 0;
+        while (bucket < _bucket_count && value > _bounds[bucket]) ++bucket;
+
+        const auto core = xPortGetCoreID();
+        _buckets[core][bucket].fetch_add(1, std::memory_order_relaxed);
+        const uint32_t low = _sum_low[core].fetch_add(value, std::memory_order_relaxed);
+        if (low + value < low) _sum_high[core].fetch_add(1, std::memory_order_relaxed);
+    }
+
+    inline uint8_t bucket_count() const { return _bucket_count; }
+    inline float bound(uint8_t bucket) const { return (float) _bounds[bucket] * _scale; }
+
+    uint32_t bucket(uint8_t bucket) const {
+        uint32_t result = 0;
+        for (auto &core: _buckets) result += core[bucket].load(std::memory_order_relaxed);
+
+        return result;
+    }
+
+    /*
+     * Double keeps sub-unit precision of sums over days of uptime, float doesn't.
+     * Scrape between the two increments of a wrap misses it once, next scrape is right again.
+     */
+    double sum() const {
+        uint64_t result = 0;
+        for (uint8_t core = 0; core < portNUM_PROCESSORS; ++core) {
+            uint32_t high, low;
+            do {
+                high = _sum_high[core].load(std::memory_order_relaxed);
+                low = _sum_low[core].load(std::memory_order_relaxed);
+            } while (high != _sum_high[core].load(std::memory_order_relaxed));
+
+            result += ((uint64_t) high << 32) | low;
+        }
+
+        return (double) result * _scale;
+    }
+};
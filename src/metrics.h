@@ -0,0 +1,290 @@
+#pragma once
+
+#include <Arduino.h>
+#include <WiFi.h>
+
+#include "boot.h"
+#include "channels.h"
+#include "duty_cycle.h"
+#include "heap_counter.h"
+#include "metric_types.h"
+#include "settings.h"
+#include "zones.h"
+
+/*
+ * Metrics registry exported in Prometheus text format.
+ * All metrics are static objects listed in Metrics[] at compile time, see metric_types.h.
+ */
+
+const uint32_t LOOP_DURATION_BUCKETS_US[] = {100, 500, 1000, 5000, 10000, 50000, 100000, 500000, 1000000, 5000000};
+const uint32_t UPLOAD_DURATION_BUCKETS_MS[] = {50, 100, 250, 500, 1000, 2000, 5000, 10000, 30000};
+const uint32_t HTTP_PHASE_BUCKETS_US[] = {1000, 5000, 10000, 25000, 50000, 100000, 250000, 500000, 1000000, 2500000, 5000000};
+const uint32_t WIFI_CONNECT_BUCKETS_MS[] = {100, 200, 300, 500, 1000, 2000, 5000, 10000, 30000};
+
+float metric_free_heap(const void *) { return (float) ESP.getFreeHeap(); }
+float metric_min_free_heap(const void *) { return (float) ESP.getMinFreeHeap(); }
+float metric_max_alloc_heap(const void *) { return (float) ESP.getMaxAllocHeap(); }
+float metric_uptime(const void *) { return (float) (esp_timer_get_time() / 1000000ULL); }
+
+float metric_wifi_link(const void *) { return WiFiClass::status() == WL_CONNECTED ? 1 : 0; }
+
+float metric_boot_phase_duration(const void *arg) {
+    auto phase = (const BootPhaseInfo *) arg;
+    return phase->end >= 0 ? (float) (phase->end - phase->start) / 1e6f : NAN;
+}
+
+float metric_boot_phase_end(const void *arg) {
+    auto phase = (const BootPhaseInfo *) arg;
+    return phase->end >= 0 ? (float) phase->end / 1e6f : NAN;
+}
+
+float metric_energy_per_sample(const void *) {
+    const float interval_ms = (float) settings.get()->sensor_update_interval;
+    return POWER_PROFILE_ALWAYS_ON.active_ma * interval_ms * 1e-6f * POWER_SUPPLY_VOLTAGE;
+}
+
+float metric_task_stack_free(const void *arg) {
+    auto task = xTaskGetHandle((const char *) arg);
+    return task != nullptr ? (float) uxTaskGetStackHighWaterMark(task) : NAN;
+}
+
+static Gauge metric_heap_free("monitor_heap_free_bytes", "Free heap size", metric_free_heap);
+static Gauge metric_heap_min_free("monitor_heap_min_free_bytes", "Lowest free heap size since boot", metric_min_free_heap);
+static Gauge metric_heap_max_alloc("monitor_heap_max_alloc_bytes", "Largest allocatable heap block", metric_max_alloc_heap);
+static ExternalCounter metric_heap_allocations("monitor_heap_allocations_total", "Heap allocations since boot", heap_allocations);
+static Gauge metric_uptime_seconds("monitor_uptime_seconds", "Time since boot", metric_uptime);
+
+static Gauge metric_boot_duration_settings("monitor_boot_phase_duration_seconds", "Boot phase duration", metric_boot_phase_duration, "phase=\"settings\"", &BootPhases[BOOT_SETTINGS]);
+static Gauge metric_boot_duration_display("monitor_boot_phase_duration_seconds", "Boot phase duration", metric_boot_phase_duration, "phase=\"display\"", &BootPhases[BOOT_DISPLAY]);
+static Gauge metric_boot_duration_sensors("monitor_boot_phase_duration_seconds", "Boot phase duration", metric_boot_phase_duration, "phase=\"sensors\"", &BootPhases[BOOT_SENSORS]);
+static Gauge metric_boot_duration_network("monitor_boot_phase_duration_seconds", "Boot phase duration", metric_boot_phase_duration, "phase=\"network\"", &BootPhases[BOOT_NETWORK]);
+static Gauge metric_boot_duration_web("monitor_boot_phase_duration_seconds", "Boot phase duration", metric_boot_phase_duration, "phase=\"web\"", &BootPhases[BOOT_WEB]);
+
+static Gauge metric_boot_end_settings("monitor_boot_phase_completed_seconds", "Time since boot when phase completed", metric_boot_phase_end, "phase=\"settings\"", &BootPhases[BOOT_SETTINGS]);
+static Gauge metric_boot_end_display("monitor_boot_phase_completed_seconds", "Time since boot when phase completed", metric_boot_phase_end, "phase=\"display\"", &BootPhases[BOOT_DISPLAY]);
+static Gauge metric_boot_end_sensors("monitor_boot_phase_completed_seconds", "Time since boot when phase completed", metric_boot_phase_end, "phase=\"sensors\"", &BootPhases[BOOT_SENSORS]);
+static Gauge metric_boot_end_network("monitor_boot_phase_completed_seconds", "Time since boot when phase completed", metric_boot_phase_end, "phase=\"network\"", &BootPhases[BOOT_NETWORK]);
+static Gauge metric_boot_end_web("monitor_boot_phase_completed_seconds", "Time since boot when phase completed", metric_boot_phase_end, "phase=\"web\"", &BootPhases[BOOT_WEB]);
+
+static Gauge metric_energy_sample("monitor_energy_per_sample_joules", "Estimated board energy per sensor sample", metric_energy_per_sample, "mode=\"always_on\"");
+
+static Gauge metric_stack_ui("monitor_task_stack_free_bytes", "Task stack high-water mark", metric_task_stack_free, "task=\"UI\"", "UI");
+static Gauge metric_stack_data("monitor_task_stack_free_bytes", "Task stack high-water mark", metric_task_stack_free, "task=\"Data\"", "Data");
+static Gauge metric_stack_web("monitor_task_stack_free_bytes", "Task stack high-water mark", metric_task_stack_free, "task=\"Web\"", "Web");
+
+static Histogram metric_loop_ui("monitor_loop_duration_seconds", "Task loop iteration time", LOOP_DURATION_BUCKETS_US, 1e-6f, "task=\"UI\"");
+static Histogram metric_loop_data("monitor_loop_duration_seconds", "Task loop iteration time", LOOP_DURATION_BUCKETS_US, 1e-6f, "task=\"Data\"");
+static Histogram metric_loop_web("monitor_loop_duration_seconds", "Task loop iteration time", LOOP_DURATION_BUCKETS_US, 1e-6f, "task=\"Web\"");
+
+static PeakGauge metric_loop_max_ui("monitor_loop_max_duration_seconds", "Longest task loop iteration since boot", 1e-6f, "task=\"UI\"");
+static PeakGauge metric_loop_max_data("monitor_loop_max_duration_seconds", "Longest task loop iteration since boot", 1e-6f, "task=\"Data\"");
+static PeakGauge metric_loop_max_web("monitor_loop_max_duration_seconds", "Longest task loop iteration since boot", 1e-6f, "task=\"Web\"");
+
+static Histogram metric_upload_duration("monitor_upload_duration_seconds", "Time data task is blocked on sensor data upload", UPLOAD_DURATION_BUCKETS_MS, 1e-3f);
+
+// HTTP: request to response or failure, MQTT: publish to PUBACK of a zone message, as seen by the data loop
+static Histogram metric_upload_latency_http("monitor_upload_latency_seconds", "Time until upload is acknowledged, MQTT at 100 ms resolution", UPLOAD_DURATION_BUCKETS_MS, 1e-3f, "transport=\"http\"");
+static Histogram metric_upload_latency_mqtt("monitor_upload_latency_seconds", "Time until upload is acknowledged, MQTT at 100 ms resolution", UPLOAD_DURATION_BUCKETS_MS, 1e-3f, "transport=\"mqtt\"");
+
+// Phases of HTTP upload request, see timed_client.h. Total is the HTTP upload latency above
+static Histogram metric_http_phase_dns("monitor_upload_http_phase_seconds", "HTTP upload request phase time", HTTP_PHASE_BUCKETS_US, 1e-6f, "phase=\"dns\"");
+static Histogram metric_http_phase_connect("monitor_upload_http_phase_seconds", "HTTP upload request phase time", HTTP_PHASE_BUCKETS_US, 1e-6f, "phase=\"connect\"");
+static Histogram metric_http_phase_write("monitor_upload_http_phase_seconds", "HTTP upload request phase time", HTTP_PHASE_BUCKETS_US, 1e-6f, "phase=\"write\"");
+static Histogram metric_http_phase_first_byte("monitor_upload_http_phase_seconds", "HTTP upload request phase time", HTTP_PHASE_BUCKETS_US, 1e-6f, "phase=\"first_byte\"");
+
+// Indexed by HttpPhase
+static Histogram *const HttpPhaseMetrics[] = {
+        &metric_http_phase_dns,
+        &metric_http_phase_connect,
+        &metric_http_phase_write,
+        &metric_http_phase_first_byte,
+};
+
+// TLS overhead isn't counted, HTTP is request size as HTTPClient writes it, MQTT includes connect, ping and resend
+static Counter metric_upload_bytes_http("monitor_upload_bytes_total", "Bytes sent to upload sensor data", "transport=\"http\"");
+static Counter metric_upload_bytes_mqtt("monitor_upload_bytes_total", "Bytes sent to upload sensor data", "transport=\"mqtt\"");
+
+static Counter metric_upload_success("monitor_uploads_total", "Sensor data uploads", "result=\"success\"");
+static Counter metric_upload_failure("monitor_uploads_total", "Sensor data uploads", "result=\"failure\"");
+
+static ChannelCounter metric_alerts("monitor_alerts_total", "Raised alerts", "sensor", ALERT_COUNT);
+
+static Counter metric_events_dropped("monitor_events_dropped_total", "Events dropped on full subscriber queue");
+
+static Gauge metric_wifi_connected("monitor_wifi_connected", "Wi-Fi link is up", metric_wifi_link);
+static Histogram metric_wifi_connect_time("monitor_wifi_connect_seconds", "Time from connection start to IP", WIFI_CONNECT_BUCKETS_MS, 1e-3f);
+static Counter metric_wifi_disconnects("monitor_wifi_disconnects_total", "Wi-Fi link losses");
+static Counter metric_wifi_reconnect_attempts("monitor_wifi_reconnect_attempts_total", "Wi-Fi reconnect attempts");
+static Counter metric_wifi_reconnects("monitor_wifi_reconnects_total", "Wi-Fi reconnects after lost connection");
+
+// Series of the same metric must go one after another
+static const Metric *const Metrics[] = {
+        &metric_heap_free,
+        &metric_heap_min_free,
+        &metric_heap_max_alloc,
+        &metric_heap_allocations,
+        &metric_uptime_seconds,
+
+        &metric_boot_duration_settings,
+        &metric_boot_duration_display,
+        &metric_boot_duration_sensors,
+        &metric_boot_duration_network,
+        &metric_boot_duration_web,
+
+        &metric_boot_end_settings,
+        &metric_boot_end_display,
+        &metric_boot_end_sensors,
+        &metric_boot_end_network,
+        &metric_boot_end_web,
+
+        &metric_energy_sample,
+
+        &metric_stack_ui,
+        &metric_stack_data,
+        &metric_stack_web,
+
+        &metric_loop_ui,
+        &metric_loop_data,
+        &metric_loop_web,
+
+        &metric_loop_max_ui,
+        &metric_loop_max_data,
+        &metric_loop_max_web,
+
+        &metric_upload_duration,
+
+        &metric_upload_latency_http,
+        &metric_upload_latency_mqtt,
+
+        &metric_http_phase_dns,
+        &metric_http_phase_connect,
+        &metric_http_phase_write,
+        &metric_http_phase_first_byte,
+
+        &metric_upload_bytes_http,
+        &metric_upload_bytes_mqtt,
+
+        &metric_upload_success,
+        &metric_upload_failure,
+
+        &metric_alerts,
+
+        &metric_events_dropped,
+
+        &metric_wifi_connected,
+        &metric_wifi_connect_time,
+        &metric_wifi_disconnects,
+        &metric_wifi_reconnect_attempts,
+        &metric_wifi_reconnects,
+};
+
+void _write_metric_name(Print &out, const Metric &metric, const char *suffix, const char *extra_label = nullptr) {
+    out.print(metric.name);
+    if (suffix) out.print(suffix);
+
+    if (metric.labels || extra_label) {
+        out.print('{');
+        if (metric.labels) out.print(metric.labels);
+        if (metric.labels && extra_label) out.print(',');
+        if (extra_label) out.print(extra_label);
+        out.print('}');
+    }
+
+    out.print(' ');
+}
+
+void _write_metric_value(Print &out, float value) {
+    if (isnan(value)) out.print("NaN");
+    else if (fabsf(value) < 1e9f && value == (float) (int32_t) value) out.print((int32_t) value);
+    else out.print(value, 6);
+
+    out.print('\n');
+}
+
+void write_metrics(Print &out) {
+    const char *prev_name = nullptr;
+    for (auto *metric: Metrics) {
+        if (prev_name == nullptr || strcmp(prev_name, metric->name) != 0) {
+            out.print("# HELP ");
+            out.print(metric->name);
+            out.print(' ');
+            out.print(metric->help);
+            out.print('\n');
+
+            out.print("# TYPE ");
+            out.print(metric->name);
+            out.print(metric->type == MetricType::GAUGE ? " gauge\n"
+                                                        : metric->type == MetricType::HISTOGRAM ? " histogram\n"
+                                                                                                : " counter\n");
+            prev_name = metric->name;
+        }
+
+        switch (metric->type) {
+            case MetricType::COUNTER:
+                _write_metric_name(out, *metric, nullptr);
+                out.print(((const Counter *) metric)->value());
+                out.print('\n');
+                break;
+
+            case MetricType::EXTERNAL_COUNTER:
+                _write_metric_name(out, *metric, nullptr);
+                out.print(((const ExternalCounter *) metric)->value());
+                out.print('\n');
+                break;
+
+            case MetricType::CHANNEL_COUNTER: {
+                auto *counter = (const ChannelCounter *) metric;
+
+                char label[64];
+                for (uint8_t zone = 0; zone < ZONE_COUNT; ++zone) {
+                    for (uint8_t i = 0; i < counter->count(); ++i) {
+                        if (ZONE_COUNT > 1) {
+                            snprintf(label, sizeof(label), "zone=\"%s\",%s=\"%s\"", Zones[zone].name, counter->label(), Channels[i].metric_label);
+                        } else {
+                            snprintf(label, sizeof(label), "%s=\"%s\"", counter->label(), Channels[i].metric_label);
+                        }
+
+                        _write_metric_name(out, *metric, nullptr, label);
+                        out.print(counter->value(zone, i));
+                        out.print('\n');
+                    }
+                }
+                break;
+            }
+
+            case MetricType::GAUGE:
+                _write_metric_name(out, *metric, nullptr);
+                _write_metric_value(out, ((const Gauge *) metric)->value());
+                break;
+
+            case MetricType::HISTOGRAM: {
+                auto *histogram = (const Histogram *) metric;
+
+                char le[24];
+                uint32_t count = 0;
+                for (uint8_t i = 0; i < histogram->bucket_count(); ++i) {
+                    count += histogram->bucket(i);
+
+                    snprintf(le, sizeof(le), "le=\"%g\"", histogram->bound(i));
+                    _write_metric_name(out, *metric, "_bucket", le);
+                    out.print(count);
+                    out.print('\n');
+                }
+
+                count += histogram->bucket(histogram->bucket_count());
+                _write_metric_name(out, *metric, "_bucket", "le=\"+Inf\"");
+                out.print(count);
+                out.print('\n');
+
+                _write_metric_name(out, *metric, "_sum");
+                out.print(histogram->sum(), 6);
+                out.print('\n');
+
+                _write_metric_name(out, *metric, "_count");
+                out.print(count);
+                out.print('\n');
+                break;
+            }
+        }
+    }
+}
@@ -1,6 +1,8 @@
 #pragma once
 
-#include "ArduinoJson.h"
+#include <Arduino.h>
+
+#include "text_format.h"
 
 enum ScheduleMode : uint8_t {
     PWM = 0,
@@ -10,65 +12,106 @@ enum ScheduleMode : uint8_t {
     OFF = 4,
 };
 
-enum SensorType : uint8_t {
+// How sensor data is uploaded: HTTPS POST to the Data API or MQTT publish to the broker
+enum UploadTransport : uint8_t {
+    UPLOAD_HTTP = 0,
+    UPLOAD_MQTT = 1,
+};
+
+/*
+ * Channels of the channel registry (see channels.h), grouped by kind.
+ * Sensor ids are stored in settings as schedule input, so existing ids must not change.
+ */
+enum ChannelId : uint8_t {
+    // Sampled from sensors, can be calibrated and drive schedules
     TEMPERATURE = 0,
     HUMIDITY = 1,
-    CO2 = 2
+    CO2 = 2,
+
+    // Computed by firmware
+    SEND_LATENCY = 3,
+
+    // Driven by schedules
+    FAN = 4,
+    HUMIDIFIER = 5,
+
+    CHANNEL_COUNT
 };
 
+const uint8_t SENSOR_COUNT = CO2 + 1;
+const uint8_t ALERT_COUNT = SEND_LATENCY + 1;
+const uint8_t ACTUATOR_FIRST = FAN;
+const uint8_t ACTUATOR_COUNT = CHANNEL_COUNT - ACTUATOR_FIRST;
+
+// Longest text is like "-40.0 C  4.9k ppm  100 %"
+#define SENSOR_TEXT_MAX_LENGTH 32
+
 struct SensorData {
-    volatile float humidity = NAN;
-    volatile float temperature = NAN;
-    volatile float co2 = NAN;
-    volatile float send_latency = NAN;
+    // Indexed by ChannelId, actuators report duty in percent
+    volatile float values[CHANNEL_COUNT];
     volatile unsigned long last_update = 0;
-    volatile unsigned long last_send = 0;
-    volatile float fan_speed = 0;
-    volatile float humidifier_power = 0;
 
-    String display_string = "";
+    char display_string[SENSOR_TEXT_MAX_LENGTH + 1] = "NO DATA";
 
-    bool ready() const {
-        return !isnan(humidity) || !isnan(temperature) || !isnan(co2);
+    SensorData() { clear(); }
+
+    void clear() {
+        for (uint8_t i = 0; i < CHANNEL_COUNT; ++i) values[i] = i < ACTUATOR_FIRST ? NAN : 0;
+    }
+
+    void copy_to(float (&dst)[CHANNEL_COUNT]) const {
+        for (uint8_t i = 0; i < CHANNEL_COUNT; ++i) dst[i] = values[i];
     }
 
-    float get_sensor_value(SensorType type) const {
-        switch (type) {
-            case SensorType::TEMPERATURE:
-                return temperature;
+    bool ready() const {
+        for (uint8_t i = 0; i < SENSOR_COUNT; ++i) {
+            if (!isnan(values[i])) return true;
+        }
+
+        return false;
+    }
 
-            case SensorType::HUMIDITY:
-                return humidity;
+    float get_sensor_value(ChannelId type) const {
+        return type < SENSOR_COUNT ? values[type] : NAN;
+    }
 
-            case SensorType::CO2:
-                return co2;
+    // Formats display_string in place. Returns false and keeps the text when shown values didn't change
+    bool update_string() {
+        bool changed = !_rendered_valid;
+        for (uint8_t i = 0; i < SENSOR_COUNT; ++i) {
+            const float value = values[i];
+            if (!(value == _rendered[i] || (isnan(value) && isnan(_rendered[i])))) changed = true;
 
-            default:
-                return NAN;
+            _rendered[i] = value;
         }
-    }
 
-    void update_string() {
+        if (!changed) return false;
+        _rendered_valid = true;
+
+        TextBuffer text(display_string);
         if (!ready()) {
-            display_string = "NO DATA";
-            return;
+            text.text("NO DATA");
+            return true;
         }
 
-        String co2_formatted;
-        if (!isnan(co2) && co2 >= 1000) {
-            float k = co2 / 1000.0f;
-            unsigned int fraction = 0;
-            if (k - floor(k) > 0.06) fraction = 1;
+        const float co2 = _rendered[CO2];
 
-            co2_formatted = String(k, fraction) + "k";
+        text.fixed(_rendered[TEMPERATURE], 1).text(" C  ");
+        if (!isnan(co2) && co2 >= 1000) {
+            const float k = co2 / 1000.0f;
+            text.fixed(k, k - floorf(k) > 0.06f ? 1 : 0).text("k");
         } else {
-            co2_formatted = String(co2, 0);
+            text.fixed(co2, 0);
         }
 
-        display_string = String(temperature, 1) + " C" + "  "
-                         + co2_formatted + " ppm" + "  "
-                         + String(humidity, 0) + " %";
+        text.text(" ppm  ").fixed(_rendered[HUMIDITY], 0).text(" %");
+        return true;
     }
+
+private:
+    // Sensor values display_string was formatted from
+    float _rendered[SENSOR_COUNT];
+    bool _rendered_valid = false;
 };
 
 struct AlertEntry {
@@ -80,7 +123,7 @@ struct AlertEntry {
 
 struct ScheduleEntry {
     ScheduleMode mode;
-    SensorType sensor;
+    ChannelId sensor;
 
     float min_sensor_value;
     float max_sensor_value;
@@ -0,0 +1,327 @@
+#pragma once
+
+#include <Arduino.h>
+#include <WiFiClient.h>
+
+#include "debug.h"
+
+#define MQTT_MAX_PACKET_SIZE 320
+#define MQTT_INFLIGHT_WINDOW 4
+
+// Keep alive is sent to the broker in seconds, ping is sent when nothing else was sent for this time
+const uint16_t MQTT_KEEP_ALIVE = 60;
+
+// Unacknowledged message is sent again after this time, also all of them are sent again after reconnect
+const unsigned long MQTT_RETRY_TIMEOUT = 10000;
+
+enum MqttPacketType : uint8_t {
+    MQTT_CONNECT = 1,
+    MQTT_CONNACK = 2,
+    MQTT_PUBLISH = 3,
+    MQTT_PUBACK = 4,
+    MQTT_PINGREQ = 12,
+    MQTT_PINGRESP = 13,
+    MQTT_DISCONNECT = 14,
+};
+
+// PUBLISH is kept encoded until PUBACK, so it can be sent again as is with DUP flag
+struct MqttInflight {
+    uint16_t id;
+    unsigned long sent_at;
+    unsigned long published_at;
+
+    uint16_t length;
+    uint8_t packet[MQTT_MAX_PACKET_SIZE];
+};
+
+typedef void (*MqttAckFn)(uint32_t latency_ms);
+
+/*
+ * Minimal MQTT 3.1.1 publisher over a client connection (TLS with WiFiClientSecure).
+ * Session is persistent (clean session is off), so QoS 1 messages not acknowledged before disconnect
+ * are delivered after reconnect. Up to MQTT_INFLIGHT_WINDOW messages wait for PUBACK at once,
+ * publish() doesn't wait for them. Incoming packets are handled by loop(), which has to be called regularly.
+ */
+class MqttClient {
+    WiFiClient &_client;
+    MqttAckFn _on_ack;
+
+    const char *_client_id = nullptr;
+    const char *_user = nullptr;
+    const char *_password = nullptr;
+
+    uint16_t _next_id = 1;
+    MqttInflight _inflight[MQTT_INFLIGHT_WINDOW]{};
+
+    unsigned long _last_send = 0;
+    bool _ping_pending = false;
+
+    // Incoming packet: fixed header, remaining length and up to 4 bytes of variable header are kept
+    uint8_t _rx_type = 0;
+    unsigned long _rx_started_at = 0;
+    uint32_t _rx_length = 0;
+    uint8_t _rx_length_shift = 0;
+    bool _rx_length_done = false;
+    uint32_t _rx_received = 0;
+    uint8_t _rx_body[4]{};
+
+    uint32_t _bytes_sent = 0;
+
+public:
+    MqttClient(WiFiClient &client, MqttAckFn on_ack = nullptr) : _client(client), _on_ack(on_ack) {}
+
+    void credentials(const char *client_id, const char *user, const char *password) {
+        _client_id = client_id;
+        _user = user && *user ? user : nullptr;
+        _password = password && *password ? password : nullptr;
+    }
+
+    inline bool connected() { return _client.connected(); }
+
+    // Bytes written to the connection since boot, including resent messages
+    inline uint32_t bytes_sent() const { return _bytes_sent; }
+
+    uint8_t inflight() const {
+        uint8_t count = 0;
+        for (auto &message: _inflight) {
+            if (message.id) ++count;
+        }
+
+        return count;
+    }
+
+    inline uint8_t window_free() const { return MQTT_INFLIGHT_WINDOW - inflight(); }
+
+    // Blocks until CONNACK or timeout, then sends unacknowledged messages again
+    bool connect(const char *host, uint16_t port, unsigned long timeout) {
+        _client.stop();
+        _reset_rx();
+
+        if (!_client.connect(host, port)) return false;
+        _client.setNoDelay(true);
+
+        uint8_t packet[MQTT_MAX_PACKET_SIZE];
+        size_t length = 0;
+
+        static const uint8_t protocol[] = {0, 4, 'M', 'Q', 'T', 'T', 4};
+        memcpy(packet, protocol, sizeof(protocol));
+        length += sizeof(protocol);
+
+        packet[length++] = (_user ? 0x80 : 0) | (_password ? 0x40 : 0);
+        packet[length++] = MQTT_KEEP_ALIVE >> 8;
+        packet[length++] = MQTT_KEEP_ALIVE & 0xff;
+
+        bool fits = _write_string(packet, length, _client_id);
+        if (_user) fits = fits && _write_string(packet, length, _user);
+        if (_password) fits = fits && _write_string(packet, length, _password);
+
+        if (!fits || !_send(MQTT_CONNECT << 4, packet, length)) {
+            _client.stop();
+            return false;
+        }
+
+        const auto start = millis();
+        while (_rx_type != MQTT_CONNACK || !_rx_complete()) {
+            if (!_client.connected() || millis() - start > timeout) {
+                _client.stop();
+                return false;
+            }
+
+            if (!_receive()) delay(10);
+        }
+
+        // Return code is the second byte of variable header
+        if (_rx_length < 2 || _rx_body[1] != 0) {
+#ifdef DEBUG
+            Serial.print("MQTT connection refused: ");
+            Serial.println(_rx_length < 2 ? -1 : _rx_body[1]);
+#endif
+            _client.stop();
+            return false;
+        }
+
+        _reset_rx();
+        _ping_pending = false;
+
+        for (auto &message: _inflight) {
+            if (message.id) _resend(message);
+        }
+
+        return true;
+    }
+
+    void disconnect() {
+        if (_client.connected()) _send(MQTT_DISCONNECT << 4, nullptr, 0);
+        _client.stop();
+    }
+
+    // QoS 1 publish. Returns false when window is full, packet doesn't fit or connection is lost
+    bool publish(const char *topic, const uint8_t *payload, size_t payload_length, bool retain) {
+        MqttInflight *slot = nullptr;
+        for (auto &message: _inflight) {
+            if (message.id == 0) {
+                slot = &message;
+                break;
+            }
+        }
+
+        if (slot == nullptr) return false;
+
+        uint8_t body[MQTT_MAX_PACKET_SIZE];
+        size_t body_length = 0;
+
+        const uint16_t id = _next_id;
+        if (!_write_string(body, body_length, topic) || body_length + 2 + payload_length > sizeof(body) - 5) return false;
+
+        body[body_length++] = id >> 8;
+        body[body_length++] = id & 0xff;
+        memcpy(body + body_length, payload, payload_length);
+        body_length += payload_length;
+
+        slot->length = _encode(slot->packet, (MQTT_PUBLISH << 4) | 0x02 | (retain ? 0x01 : 0), body, body_length);
+        slot->id = id;
+        slot->published_at = millis();
+
+        // Id 0 is not allowed, and it marks free slot
+        _next_id = _next_id == 0xffff ? 1 : _next_id + 1;
+
+        return _resend(*slot, false);
+    }
+
+    void loop() {
+        if (!_client.connected()) return;
+
+        while (_receive()) {
+            if (_rx_complete()) _handle_packet();
+        }
+
+        const auto now = millis();
+        for (auto &message: _inflight) {
+            if (message.id && now - message.sent_at > MQTT_RETRY_TIMEOUT) _resend(message);
+        }
+
+        if (now - _last_send > (unsigned long) MQTT_KEEP_ALIVE * 1000 / 2) {
+            // Broker closes connection after 1.5 keep alive without packets, so missing response is a dead link
+            if (_ping_pending) {
+                _client.stop();
+                return;
+            }
+
+            _ping_pending = _send(MQTT_PINGREQ << 4, nullptr, 0);
+        }
+    }
+
+private:
+    static bool _write_string(uint8_t *buffer, size_t &length, const char *str) {
+        const size_t str_length = strlen(str);
+        if (length + 2 + str_length > MQTT_MAX_PACKET_SIZE - 5) return false;
+
+        buffer[length++] = str_length >> 8;
+        buffer[length++] = str_length & 0xff;
+        memcpy(buffer + length, str, str_length);
+        length += str_length;
+
+        return true;
+    }
+
+    // Fixed header with variable length encoding of the remaining length, returns packet length
+    static size_t _encode(uint8_t *packet, uint8_t header, const uint8_t *body, size_t body_length) {
+        size_t length = 0;
+        packet[length++] = header;
+
+        size_t remaining = body_length;
+        do {
+            uint8_t digit = remaining % 128;
+            remaining /= 128;
+            if (remaining) digit |= 0x80;
+
+            packet[length++] = digit;
+        } while (remaining);
+
+        if (body_length) memcpy(packet + length, body, body_length);
+        return length + body_length;
+    }
+
+    bool _write(const uint8_t *packet, size_t length) {
+        const auto written = _client.write(packet, length);
+        _bytes_sent += written;
+
+        if (written != length) {
+            _client.stop();
+            return false;
+        }
+
+        _last_send = millis();
+        return true;
+    }
+
+    bool _send(uint8_t header, const uint8_t *body, size_t body_length) {
+        uint8_t packet[MQTT_MAX_PACKET_SIZE];
+        return _write(packet, _encode(packet, header, body, body_length));
+    }
+
+    bool _resend(MqttInflight &message, bool duplicate = true) {
+        if (duplicate) message.packet[0] |= 0x08;
+
+        message.sent_at = millis();
+        return _client.connected() && _write(message.packet, message.length);
+    }
+
+    void _reset_rx() {
+        _rx_type = 0;
+        _rx_length = 0;
+        _rx_length_shift = 0;
+        _rx_length_done = false;
+        _rx_received = 0;
+    }
+
+    inline bool _rx_complete() const { return _rx_length_done && _rx_received == _rx_length; }
+
+    // Reads one byte of incoming packet, returns false if there is nothing to read
+    bool _receive() {
+        if (_rx_complete()) _reset_rx();
+        if (_client.available() <= 0) return false;
+
+        const int c = _client.read();
+        if (c < 0) return false;
+
+        if (_rx_type == 0) {
+            // Packet is handled after it's read whole, acknowledgement latency is counted to its first byte
+            _rx_type = (uint8_t) c >> 4;
+            _rx_started_at = millis();
+        } else if (!_rx_length_done) {
+            _rx_length |= (uint32_t) (c & 0x7f) << _rx_length_shift;
+            _rx_length_shift += 7;
+            _rx_length_done = !(c & 0x80);
+        } else {
+            // Packets we don't handle are skipped, only their start is kept
+            if (_rx_received < sizeof(_rx_body)) _rx_body[_rx_received] = (uint8_t) c;
+            ++_rx_received;
+        }
+
+        return true;
+    }
+
+    void _handle_packet() {
+        switch (_rx_type) {
+            case MQTT_PUBACK: {
+                const uint16_t id = (_rx_body[0] << 8) | _rx_body[1];
+                for (auto &message: _inflight) {
+                    if (message.id != id) continue;
+
+                    message.id = 0;
+                    if (_on_ack) _on_ack(_rx_started_at - message.published_at);
+                    break;
+                }
+                break;
+            }
+
+            case MQTT_PINGRESP:
+                _ping_pending = false;
+                break;
+
+            default:
+                break;
+        }
+    }
+};
@@ -0,0 +1,37 @@
+#pragma once
+
+// Board wiring, kept apart from hardware.h so channel registry can use it without instantiating the drivers
+
+#define PIN_MATRIX_CS 5
+#define PIN_SPEAKER 15
+#define PIN_FAN_PWM 32
+#define PIN_HUMIDIFIER_PWM 33
+#define PIN_BME_SDA 25
+#define PIN_BME_SCL 26
+
+#define UART_CO2 2
+
+const unsigned int BME_ADDRESS = 0x76;
+
+// Channels 2n and 2n + 1 share LEDC timer, so speaker tone doesn't change PWM frequency of the others
+#define PWM_CHANNEL_SPEAKER 0
+#define PWM_CHANNEL_FAN 5
+#define PWM_CHANNEL_HUMIDIFIER 6
+
+const unsigned long FAN_PWM_BITS = 8;
+const unsigned long HUMIDIFIER_PWM_BITS = 8;
+
+// Second zone: BME280 on the second I2C controller, MH-Z19 on UART1 and own pair of PWM outputs
+#ifdef MULTI_ZONE
+#define PIN_ZONE2_BME_SDA 21
+#define PIN_ZONE2_BME_SCL 22
+#define PIN_ZONE2_CO2_RX 18
+#define PIN_ZONE2_CO2_TX 19
+#define PIN_ZONE2_FAN_PWM 27
+#define PIN_ZONE2_HUMIDIFIER_PWM 14
+
+#define UART_ZONE2_CO2 1
+
+#define PWM_CHANNEL_ZONE2_FAN 8
+#define PWM_CHANNEL_ZONE2_HUMIDIFIER 10
+#endif
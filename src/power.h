@@ -0,0 +1,234 @@
+#pragma once
+
+#include <Arduino.h>
+#include <esp_sleep.h>
+#include <sys/time.h>
+
+#include "data.h"
+#include "debug.h"
+#include "duty_cycle.h"
+#include "hardware.h"
+#include "series_codec.h"
+#include "settings.h"
+#include "wifi_control.h"
+
+#define POWER_ALWAYS_ON 0
+#define POWER_LIGHT_SLEEP 1
+#define POWER_DEEP_SLEEP 2
+
+// Select with build flag, e.g. -DPOWER_MODE=POWER_DEEP_SLEEP
+#ifndef POWER_MODE
+#define POWER_MODE POWER_ALWAYS_ON
+#endif
+
+#define POWER_BATCH_SIZE 32
+
+// Same RTC memory as 16 raw samples took, compressed samples of a slowly changing room take about 5 bytes per zone
+#define POWER_BATCH_BYTES (16 * SENSOR_COUNT * sizeof(float) * ZONE_COUNT)
+
+const unsigned long POWER_WIFI_CONNECT_TIMEOUT = 10000;
+
+// Sensor channels only, indexed by zone and ChannelId
+struct PowerSample {
+    float values[ZONE_COUNT][SENSOR_COUNT];
+};
+
+static_assert(ZONE_COUNT * SENSOR_COUNT <= SERIES_MAX_CHANNELS, "Batch sample doesn't fit series format");
+static_assert(POWER_BATCH_BYTES >= SERIES_MAX_SAMPLE_SIZE(ZONE_COUNT * SENSOR_COUNT), "Batch can't hold a sample");
+
+// Survives deep sleep, so samples are collected across wake ups
+RTC_DATA_ATTR static DutyCycleState power_duty_state;
+RTC_DATA_ATTR static SeriesBlock<POWER_BATCH_BYTES> power_samples;
+RTC_DATA_ATTR static EnergyMeter::State power_energy;
+
+// Values are kept with one decimal digit more than displayed
+SeriesFormat power_series_format() {
+    SeriesFormat format{};
+    format.channels = ZONE_COUNT * SENSOR_COUNT;
+
+    for (uint8_t zone = 0; zone < ZONE_COUNT; ++zone) {
+        for (uint8_t i = 0; i < SENSOR_COUNT; ++i) {
+            float scale = 10;
+            for (uint8_t digit = 0; digit < Channels[i].fraction; ++digit) scale *= 10;
+
+            format.scale[zone * SENSOR_COUNT + i] = scale;
+        }
+    }
+
+    return format;
+}
+
+static const SeriesFormat power_format = power_series_format();
+
+// Radio is brought up when the next sample might not fit
+bool power_batch_full() {
+    return (size_t) power_samples.state.length + SERIES_MAX_SAMPLE_SIZE(ZONE_COUNT * SENSOR_COUNT) > POWER_BATCH_BYTES;
+}
+
+// RTC clock keeps running in sleep, unlike millis()
+class RtcClock : public Clock {
+public:
+    uint64_t now_ms() const override {
+        timeval tv{};
+        gettimeofday(&tv, nullptr);
+
+        return (uint64_t) tv.tv_sec * 1000ull + tv.tv_usec / 1000;
+    }
+};
+
+static RtcClock rtc_clock;
+
+// Returns true if sample raises an alert
+bool power_take_sample(DutyCycle &cycle) {
+    const auto config = settings.get();
+
+    // Every sample is taken from scratch, invalid readings are stored as NaN
+    for (uint8_t zone = 0; zone < ZONE_COUNT; ++zone) {
+        sensor_data[zone].clear();
+
+        bme[zone].takeForcedMeasurement();
+        sample_sensors(zone, *config);
+    }
+
+    PowerSample sample{};
+    for (uint8_t zone = 0; zone < ZONE_COUNT; ++zone) {
+        for (uint8_t i = 0; i < SENSOR_COUNT; ++i) sample.values[zone][i] = sensor_data[zone].values[i];
+    }
+
+    // Oldest samples are dropped when batch can't be uploaded for too long
+    SeriesEncoder encoder(power_format, power_samples);
+    if (cycle.pending() >= POWER_BATCH_SIZE) {
+        series_drop_front(power_format, power_samples, 1);
+        cycle.dropped(1);
+    }
+
+    while (!encoder.append((uint32_t) rtc_clock.now_ms(), &sample.values[0][0])) {
+        series_drop_front(power_format, power_samples, 1);
+        cycle.dropped(1);
+    }
+
+    cycle.sampled();
+
+    // Alert intervals are not tracked across sleep, every sample out of range is uploaded right away
+    bool alert = false;
+    for (uint8_t zone = 0; zone < ZONE_COUNT; ++zone) {
+        for (uint8_t i = 0; i < SENSOR_COUNT; ++i) {
+            const auto &entry = config->zones[zone].alerts[i];
+            const float value = sample.values[zone][i];
+            if (entry.enabled && (value < entry.min || value > entry.max)) {
+                metric_alerts.inc(zone, Channels[i].id);
+                alert = true;
+            }
+        }
+    }
+
+    return alert;
+}
+
+void power_upload_batch(DutyCycle &cycle) {
+    uint8_t sent = 0;
+
+    wifi_begin();
+    if (wifi_wait_connected(POWER_WIFI_CONNECT_TIMEOUT)) {
+        SeriesDecoder decoder(power_format, power_samples);
+
+        uint32_t time;
+        PowerSample sample{};
+        while (decoder.next(time, &sample.values[0][0])) {
+            // Schedules are off on battery, so actuator channels aren't reported
+            float values[ZONE_COUNT][CHANNEL_COUNT];
+            for (uint8_t zone = 0; zone < ZONE_COUNT; ++zone) {
+                for (uint8_t i = 0; i < CHANNEL_COUNT; ++i) {
+                    values[zone][i] = i < SENSOR_COUNT ? sample.values[zone][i] : NAN;
+                }
+            }
+
+            // Taken for every request, so it stays right when earlier requests were slow. Wrap of 32-bit times cancels out
+            const uint32_t age = (uint32_t) rtc_clock.now_ms() - time;
+            if (post_sensor_data(values, age) != 200) break;
+            ++sent;
+        }
+    }
+
+    wifi_end();
+
+    series_drop_front(power_format, power_samples, sent);
+    cycle.uploaded(sent);
+
+#ifdef DEBUG
+    Serial.print("Uploaded ");
+    Serial.print(sent);
+    Serial.print(" samples, ");
+    Serial.print(cycle.pending());
+    Serial.print(" left in ");
+    Serial.print(power_samples.state.length);
+    Serial.println(" bytes");
+#endif
+}
+
+/*
+ * Main loop of battery powered unit: sample on timer wake up, keep samples in RTC memory,
+ * bring the radio up only to upload a batch or an alert. Display, web server and schedules are not running.
+ */
+[[noreturn]] void low_power_main() {
+    EnergyMeter energy(POWER_MODE == POWER_DEEP_SLEEP ? POWER_PROFILE_DEEP_SLEEP : POWER_PROFILE_LIGHT_SLEEP, power_energy);
+
+    matrix.shutdown(true);
+
+    init_sensors();
+    for (auto &sensor: bme) sensor.setSampling(Adafruit_BME280::MODE_FORCED);
+
+    for (;;) {
+        // After deep sleep the whole boot is the awake time
+        const unsigned long awake_start = POWER_MODE == POWER_DEEP_SLEEP ? 0 : millis();
+
+        DutyCycleConfig config{};
+        {
+            const auto snapshot = settings.get();
+            config.sample_interval = snapshot->sensor_update_interval;
+            config.upload_interval = snapshot->sensor_send_interval;
+            config.batch_size = POWER_BATCH_SIZE;
+        }
+
+        DutyCycle cycle(rtc_clock, power_duty_state, config);
+
+        bool alert = false;
+        if (cycle.sample_due()) {
+            alert = power_take_sample(cycle);
+            energy.sample();
+        }
+
+        unsigned long radio_time = 0;
+        if (cycle.upload_due(alert, power_batch_full())) {
+            const auto radio_start = millis();
+            power_upload_batch(cycle);
+            radio_time = millis() - radio_start;
+        }
+
+        const auto sleep_time = cycle.sleep_duration();
+
+        energy.active(millis() - awake_start - radio_time);
+        energy.radio(radio_time);
+        energy.sleep(sleep_time);
+
+#ifdef DEBUG
+        Serial.print("Energy per sample (");
+        Serial.print(POWER_MODE == POWER_DEEP_SLEEP ? POWER_PROFILE_DEEP_SLEEP.name : POWER_PROFILE_LIGHT_SLEEP.name);
+        Serial.print("): ");
+        Serial.print(energy.energy_per_sample() * 1000.0f, 3);
+        Serial.print(" mJ, sleeping for ");
+        Serial.print(sleep_time);
+        Serial.println(" ms");
+        Serial.flush();
+#endif
+
+        if (sleep_time == 0) continue;
+
+        esp_sleep_enable_timer_wakeup((uint64_t) sleep_time * 1000ull);
+        if (POWER_MODE == POWER_DEEP_SLEEP) {
+            esp_deep_sleep_start();
+        } else {
+            esp_light_sleep_start();
+        }
+    }
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <Arduino.h>
+
+#include "metrics.h"
+#include "task_profile.h"
+
+// Profiled firmware tasks, see task_profile.h
+static TaskProfile profile_ui("UI", metric_loop_ui, metric_loop_max_ui);
+static TaskProfile profile_data("Data", metric_loop_data, metric_loop_max_data);
+static TaskProfile profile_web("Web", metric_loop_web, metric_loop_max_web);
+
+static TaskProfile *const Profiles[PROFILE_TASK_COUNT] = {&profile_ui, &profile_data, &profile_web};
+
+void _read_runtime_stats(ProfileState &state) {
+    state.total_runtime = 0;
+    state.runtime_count = 0;
+
+#if PROFILE_RUNTIME_STATS
+    TaskStatus_t tasks[PROFILE_MAX_RUNTIME_TASKS];
+
+    // Returns nothing when tasks don't fit
+    const auto count = uxTaskGetSystemState(tasks, PROFILE_MAX_RUNTIME_TASKS, &state.total_runtime);
+    for (UBaseType_t i = 0; i < count; ++i) {
+        auto &entry = state.runtime[state.runtime_count++];
+        strncpy(entry.task, tasks[i].pcTaskName, sizeof(entry.task) - 1);
+        entry.task[sizeof(entry.task) - 1] = '\0';
+
+#if configTASKLIST_INCLUDE_COREID
+        entry.core = tasks[i].xCoreID < portNUM_PROCESSORS ? (int8_t) tasks[i].xCoreID : -1;
+#else
+        entry.core = -1;
+#endif
+        entry.runtime = tasks[i].ulRunTimeCounter;
+        entry.stack_free = tasks[i].usStackHighWaterMark;
+    }
+#endif
+}
+
+ProfileState current_profile() {
+    ProfileState state{};
+    state.uptime_ms = (uint32_t) (esp_timer_get_time() / 1000);
+
+    for (uint8_t i = 0; i < PROFILE_TASK_COUNT; ++i) {
+        const auto &profile = *Profiles[i];
+        state.tasks[i] = {
+                profile.task,
+                profile.core(),
+                profile.iterations(),
+                profile.busy_ms(),
+                profile.blocked_ms(),
+                profile.max_us(),
+                metric_task_stack_free(profile.task)
+        };
+    }
+
+    _read_runtime_stats(state);
+    return state;
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <Arduino.h>
+#include <Adafruit_GFX.h>
+#include <Max72xxPanel.h>
+
+#define SCROLL_TEXT_MAX_LENGTH 64
+#define SCROLL_GLYPH_HEIGHT 8
+
+/*
+ * Text rendered once into packed column bitmap (byte per column, LSB is the top pixel).
+ * Scrolling just copies visible columns into the panel buffer, so no font rendering happens per frame.
+ */
+template<uint8_t GLYPH_WIDTH>
+class ScrollText {
+    // Glyphs are rendered with Adafruit_GFX on first use and kept transposed to columns
+    static uint8_t _glyphs[256][GLYPH_WIDTH];
+    static uint32_t _glyph_ready[256 / 32];
+
+    uint8_t _columns[SCROLL_TEXT_MAX_LENGTH * GLYPH_WIDTH]{};
+    uint16_t _length = 0;
+
+public:
+    // Width of rendered text in columns
+    inline uint16_t length() const { return _length; }
+
+    void render(const char *text) {
+        uint8_t *ptr = _columns;
+        for (uint16_t i = 0; i < SCROLL_TEXT_MAX_LENGTH && text[i]; ++i) {
+            const uint8_t *glyph = _glyph((uint8_t) text[i]);
+            memcpy(ptr, glyph, GLYPH_WIDTH);
+            ptr += GLYPH_WIDTH;
+        }
+
+        _length = ptr - _columns;
+    }
+
+    // Draws text so its column `offset` is at the panel's x = 0
+    void draw(Max72xxPanel &panel, int32_t offset, int16_t y) const {
+        for (int16_t x = 0; x < panel.width(); ++x) {
+            const int32_t column = offset + x;
+            panel.drawColumn(x, y, column >= 0 && column < _length ? _columns[column] : 0);
+        }
+    }
+
+private:
+    static const uint8_t *_glyph(uint8_t c) {
+        const uint32_t bit = 1ul << (c & 31);
+        if (_glyph_ready[c >> 5] & bit) return _glyphs[c];
+
+        GFXcanvas1 canvas(GLYPH_WIDTH, SCROLL_GLYPH_HEIGHT);
+        canvas.fillScreen(LOW);
+        canvas.drawChar(0, 0, c, HIGH, LOW, 1);
+
+        for (uint8_t x = 0; x < GLYPH_WIDTH; ++x) {
+            uint8_t column = 0;
+            for (uint8_t y = 0; y < SCROLL_GLYPH_HEIGHT; ++y) {
+                if (canvas.getPixel(x, y)) column |= 1 << y;
+            }
+
+            _glyphs[c][x] = column;
+        }
+
+        _glyph_ready[c >> 5] |= bit;
+        return _glyphs[c];
+    }
+};
+
+template<uint8_t GLYPH_WIDTH>
+uint8_t ScrollText<GLYPH_WIDTH>::_glyphs[256][GLYPH_WIDTH];
+
+template<uint8_t GLYPH_WIDTH>
+uint32_t ScrollText<GLYPH_WIDTH>::_glyph_ready[256 / 32];
@@ -0,0 +1,211 @@
+#pragma once
+
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+
+/*
+ * Streaming compression of sample series: timestamps as delta-of-delta, values as fixed-point deltas
+ * from the previous sample of the channel, both written as zigzag varints. Slowly changing periodic samples
+ * take a byte per timestamp and channel instead of full floats. NaN values are marked in a per-sample mask
+ * and don't break the deltas. It has no hardware dependencies, so it can run on host.
+ *
+ * Sample layout: varint(time) for the first sample, zigzag(delta-of-delta) for following ones,
+ * varint(NaN mask), then zigzag(value - previous value) for every channel not in the mask.
+ * Absolute values are deltas from zero, so first sample is encoded the same way.
+ */
+
+#define SERIES_MAX_CHANNELS 16
+
+// Longest encoded sample: varints of time and mask and a varint per channel
+#define SERIES_MAX_SAMPLE_SIZE(channels) (5 + 3 + 5 * (channels))
+
+struct SeriesFormat {
+    uint8_t channels;
+
+    // Value is stored as round(value * scale), e.g. 100 keeps two decimal digits
+    float scale[SERIES_MAX_CHANNELS];
+};
+
+// Encoder state kept next to the encoded bytes. Plain data, so a block can live in RTC memory
+struct SeriesState {
+    uint16_t length;
+    uint16_t count;
+
+    uint32_t last_time;
+    int32_t last_delta;
+    int32_t last[SERIES_MAX_CHANNELS];
+};
+
+template<size_t SIZE>
+struct SeriesBlock {
+    SeriesState state;
+    uint8_t data[SIZE];
+};
+
+inline uint32_t _series_zigzag(int32_t value) { return ((uint32_t) value << 1) ^ (uint32_t) (value >> 31); }
+
+inline int32_t _series_unzigzag(uint32_t value) { return (int32_t) (value >> 1) ^ -(int32_t) (value & 1); }
+
+inline size_t _series_put(uint8_t *out, uint32_t value) {
+    size_t length = 0;
+    while (value >= 0x80) {
+        out[length++] = (uint8_t) (value | 0x80);
+        value >>= 7;
+    }
+
+    out[length++] = (uint8_t) value;
+    return length;
+}
+
+class SeriesEncoder {
+    const SeriesFormat &_format;
+    SeriesState &_state;
+    uint8_t *_data;
+    size_t _size;
+
+public:
+    SeriesEncoder(const SeriesFormat &format, SeriesState &state, uint8_t *data, size_t size)
+            : _format(format), _state(state), _data(data), _size(size) {}
+
+    template<size_t SIZE>
+    SeriesEncoder(const SeriesFormat &format, SeriesBlock<SIZE> &block)
+            : SeriesEncoder(format, block.state, block.data, SIZE) {}
+
+    inline uint16_t count() const { return _state.count; }
+    inline size_t length() const { return _state.length; }
+
+    void clear() { memset(&_state, 0, sizeof(_state)); }
+
+    // Sample is written whole or not at all, returns false when it doesn't fit
+    bool append(uint32_t time, const float *values) {
+        uint8_t sample[SERIES_MAX_SAMPLE_SIZE(SERIES_MAX_CHANNELS)];
+        size_t length = 0;
+
+        int32_t delta = 0;
+        if (_state.count == 0) {
+            length += _series_put(sample, time);
+        } else {
+            delta = (int32_t) (time - _state.last_time);
+            length += _series_put(sample, _series_zigzag(delta - _state.last_delta));
+        }
+
+        uint32_t mask = 0;
+        int32_t fixed[SERIES_MAX_CHANNELS];
+        for (uint8_t i = 0; i < _format.channels; ++i) {
+            if (isnan(values[i])) {
+                mask |= 1u << i;
+                fixed[i] = _state.last[i];
+            } else {
+                fixed[i] = (int32_t) lroundf(values[i] * _format.scale[i]);
+            }
+        }
+
+        length += _series_put(sample + length, mask);
+        for (uint8_t i = 0; i < _format.channels; ++i) {
+            if (!(mask & (1u << i))) length += _series_put(sample + length, _series_zigzag(fixed[i] - _state.last[i]));
+        }
+
+        if (_state.length + length > _size) return false;
+
+        memcpy(_data + _state.length, sample, length);
+        _state.length += length;
+        ++_state.count;
+
+        _state.last_time = time;
+        _state.last_delta = delta;
+        memcpy(_state.last, fixed, sizeof(fixed[0]) * _format.channels);
+
+        return true;
+    }
+};
+
+class SeriesDecoder {
+    const SeriesFormat &_format;
+    const uint8_t *_data;
+    size_t _length;
+    uint16_t _count;
+
+    size_t _position = 0;
+    uint16_t _index = 0;
+
+    uint32_t _time = 0;
+    int32_t _delta = 0;
+    int32_t _last[SERIES_MAX_CHANNELS]{};
+
+public:
+    SeriesDecoder(const SeriesFormat &format, const SeriesState &state, const uint8_t *data)
+            : _format(format), _data(data), _length(state.length), _count(state.count) {}
+
+    template<size_t SIZE>
+    SeriesDecoder(const SeriesFormat &format, const SeriesBlock<SIZE> &block)
+            : SeriesDecoder(format, block.state, block.data) {}
+
+    inline uint16_t remaining() const { return _count - _index; }
+
+    // Missing values are NaN. Returns false after the last sample or on truncated data
+    bool next(uint32_t &time, float *values) {
+        if (_index >= _count) return false;
+
+        uint32_t word;
+        if (!_get(word)) return false;
+
+        if (_index == 0) {
+            _time = word;
+        } else {
+            _delta += _series_unzigzag(word);
+            _time += (uint32_t) _delta;
+        }
+
+        uint32_t mask;
+        if (!_get(mask)) return false;
+
+        for (uint8_t i = 0; i < _format.channels; ++i) {
+            if (mask & (1u << i)) {
+                values[i] = NAN;
+                continue;
+            }
+
+            if (!_get(word)) return false;
+
+            _last[i] += _series_unzigzag(word);
+            values[i] = (float) _last[i] / _format.scale[i];
+        }
+
+        time = _time;
+        ++_index;
+
+        return true;
+    }
+
+private:
+    bool _get(uint32_t &value) {
+        value = 0;
+        for (uint8_t shift = 0; shift < 35 && _position < _length; shift += 7) {
+            const uint8_t byte = _data[_position++];
+            value |= (uint32_t) (byte & 0x7f) << shift;
+
+            if (!(byte & 0x80)) return true;
+        }
+
+        return false;
+    }
+};
+
+// Removes oldest samples by encoding the rest again, as the first kept sample has to become absolute
+template<size_t SIZE>
+void series_drop_front(const SeriesFormat &format, SeriesBlock<SIZE> &block, uint16_t count) {
+    if (count == 0) return;
+
+    SeriesBlock<SIZE> rest{};
+    SeriesEncoder encoder(format, rest);
+    SeriesDecoder decoder(format, block);
+
+    uint32_t time;
+    float values[SERIES_MAX_CHANNELS];
+    for (uint16_t index = 0; decoder.next(time, values); ++index) {
+        if (index >= count) encoder.append(time, values);
+    }
+
+    block = rest;
+}
@@ -1,23 +1,18 @@
-#include <ArduinoJson.h>
-#include <WebServer.h>
+#include <ESPAsyncWebServer.h>
 
 #include "settings.h"
 
 
-const char *TEMP_CALIBRATION = "t_cal";
-const char *HUMIDITY_CALIBRATION = "h_cal";
-const char *CO2_CALIBRATION = "co2_cal";
 const char *TEXT_ANIMATION_DELAY = "t_anim_delay";
 const char *TEXT_LOOP_DELAY = "t_loop_delay";
 const char *WIFI_MAX_CONNECT_ATTEMPTS = "wifi_max_attempts";
 const char *SENSOR_UPDATE_INTERVAL = "upd_interval";
 const char *SENSOR_SEND_INTERVAL = "send_int";
+const char *UPLOAD_TRANSPORT = "transport";
 const char *SETTINGS_SAVE_INTERVAL = "save_int";
 const char *SCREEN_ROTATION = "s_rot";
 const char *SCREEN_BRIGHTNESS = "s_brt";
 const char *SOUND_INDICATION = "snd";
-const char *SCHEDULE_FAN = "fan";
-const char *SCHEDULE_HUMIDIFIER = "humr";
 const char *SCHEDULE_PWM_FREQUENCY = "freq";
 const char *SCHEDULE_MODE = "mode";
 const char *SCHEDULE_SENSOR = "sensor";
@@ -28,18 +23,18 @@ const char *SCHEDULE_MAX_SENSOR_VALUE = "max_v";
 const char *SCHEDULE_MAX_ACTIVE_TIME = "max_act_time";
 const char *SCHEDULE_ACTIVE_TIME_WINDOW = "act_time_w";
 const char *SCHEDULE_ACTIVATION_OFFSET = "act_offset";
-const char *ALERT_TEMPERATURE = "alert_temp";
-const char *ALERT_HUMIDITY = "alert_hum";
-const char *ALERT_CO2 = "alert_co2";
-const char *ALERT_SEND_LAT = "alert_lat";
 const char *ALERT_ENABLED = "enabled";
 const char *ALERT_INTERVAL = "int";
 const char *ALERT_MIN = "min";
 const char *ALERT_MAX = "max";
+const char *ZONE = "zone";
+const char *ZONES = "zones";
 
 volatile boolean Settings::_initialized = false;
 
-Settings::Settings(Timer &timer) : _timer(timer) {}
+Settings::Settings(Timer &timer) : _current(&_slots[0]), _write_mutex(xSemaphoreCreateMutex()), _timer(timer) {
+    for (auto &readers: _readers) readers = 0;
+}
 
 void Settings::begin() {
     if (!Settings::_initialized) {
@@ -56,92 +51,159 @@ void Settings::begin() {
 #endif
     }
 
-    EEPROM.get(Settings::_offset, _data);
-    if (_data.version != SETTINGS_VERSION || _data.header != SETTINGS_HEADER) {
+    auto *draft = _begin_update();
+    EEPROM.get(Settings::_offset, *draft);
+    if (draft->version != SETTINGS_VERSION || draft->header != SETTINGS_HEADER) {
 #ifdef DEBUG
         Serial.print("Stored settings version: ");
-        Serial.print(_data.version);
+        Serial.print(draft->version);
         Serial.print(" header:");
-        Serial.println(_data.header, HEX);
+        Serial.println(draft->header, HEX);
 
         Serial.println("Create new settings...");
 #endif
 
-        _data = SettingsEntry();
+        *draft = SettingsEntry();
+    }
+
+    _current = draft;
+    _end_update(draft, false);
+}
+
+SettingsSnapshot Settings::get() const {
+    for (;;) {
+        auto *entry = _current.load();
+        auto &readers = _readers[entry - _slots];
+
+        readers.fetch_add(1);
+
+        // Writer could retire and reuse slot between load and pin, so verify it's still published
+        if (_current.load() == entry) return {entry, &readers};
+
+        readers.fetch_sub(1);
+    }
+}
+
+SettingsEntry *Settings::_begin_update() {
+    while (xSemaphoreTake(_write_mutex, portMAX_DELAY) != pdTRUE) {
+#ifdef DEBUG
+        Serial.println("Can't take mutex (settings)");
+#endif
+    }
+
+    auto *current = _current.load();
+    for (;;) {
+        for (int i = 0; i < SETTINGS_SNAPSHOT_COUNT; ++i) {
+            auto *slot = &_slots[i];
+            if (slot == current || _readers[i].load() != 0) continue;
+
+            *slot = *current;
+            return slot;
+        }
+
+#ifdef DEBUG
+        Serial.println("All settings snapshots are in use, waiting for readers...");
+#endif
+
+        delay(1);
     }
 }
 
+void Settings::_end_update(SettingsEntry *draft, bool publish) {
+    if (publish) {
+        _current = draft;
+        _commit();
+    }
+
+    xSemaphoreGive(_write_mutex);
+}
+
 void Settings::update_settings(update_fn fn) {
-    fn(_data);
-    _commit();
+    auto *draft = _begin_update();
+    fn(*draft);
+    _end_update(draft, true);
 }
 
-JsonObject write_alert(JsonObject obj, const AlertEntry &entry) {
-    obj[ALERT_ENABLED] = entry.enabled;
-    obj[ALERT_INTERVAL] = entry.alert_interval;
-    obj[ALERT_MIN] = entry.min;
-    obj[ALERT_MAX] = entry.max;
+void write_alert(JsonWriter &json, const char *key, const AlertEntry &entry) {
+    json.begin_object(key);
+    json.field(ALERT_ENABLED, entry.enabled);
+    json.field(ALERT_INTERVAL, entry.alert_interval);
+    json.field(ALERT_MIN, entry.min);
+    json.field(ALERT_MAX, entry.max);
+    json.end_object();
+}
 
-    return obj;
+void write_schedule(JsonWriter &json, const char *key, const ScheduleEntry &entry) {
+    json.begin_object(key);
+    json.field(SCHEDULE_MODE, entry.mode);
+    json.field(SCHEDULE_SENSOR, entry.sensor);
+    json.field(SCHEDULE_MIN_SENSOR_VALUE, entry.min_sensor_value);
+    json.field(SCHEDULE_MAX_SENSOR_VALUE, entry.max_sensor_value);
+    json.field(SCHEDULE_MAX_ACTIVE_TIME, entry.max_active_time);
+    json.field(SCHEDULE_ACTIVE_TIME_WINDOW, entry.active_time_window);
+    json.field(SCHEDULE_ACTIVATION_OFFSET, entry.activation_offset);
+    json.field(SCHEDULE_PWM_FREQUENCY, entry.pwm_frequency);
+    json.field(SCHEDULE_MIN_DUTY, entry.min_duty);
+    json.field(SCHEDULE_MAX_DUTY, entry.max_duty);
+    json.end_object();
 }
 
-JsonObject write_schedule(JsonObject obj, const ScheduleEntry &entry) {
-    obj[SCHEDULE_MODE] = entry.mode;
-    obj[SCHEDULE_SENSOR] = entry.sensor;
-    obj[SCHEDULE_MIN_SENSOR_VALUE] = entry.min_sensor_value;
-    obj[SCHEDULE_MAX_SENSOR_VALUE] = entry.max_sensor_value;
-    obj[SCHEDULE_MAX_ACTIVE_TIME] = entry.max_active_time;
-    obj[SCHEDULE_ACTIVE_TIME_WINDOW] = entry.active_time_window;
-    obj[SCHEDULE_ACTIVATION_OFFSET] = entry.activation_offset;
-    obj[SCHEDULE_PWM_FREQUENCY] = entry.pwm_frequency;
-    obj[SCHEDULE_MIN_DUTY] = entry.min_duty;
-    obj[SCHEDULE_MAX_DUTY] = entry.max_duty;
-
-    return obj;
+void write_zone(JsonWriter &json, const ZoneSettings &zone) {
+    for (uint8_t i = 0; i < SENSOR_COUNT; ++i) {
+        json.field(Channels[i].calibration_key, zone.calibration[i]);
+    }
+
+    for (uint8_t i = 0; i < ACTUATOR_COUNT; ++i) {
+        write_schedule(json, Channels[ACTUATOR_FIRST + i].key, zone.schedules[i]);
+    }
+
+    for (uint8_t i = 0; i < ALERT_COUNT; ++i) {
+        write_alert(json, Channels[i].alert_key, zone.alerts[i]);
+    }
 }
 
-String Settings::json() const {
-    StaticJsonDocument<1024> doc;
-
-    doc[TEMP_CALIBRATION] = _data.temperature_calibration;
-    doc[HUMIDITY_CALIBRATION] = _data.humidity_calibration;
-    doc[CO2_CALIBRATION] = _data.co2_calibration;
-    doc[TEXT_ANIMATION_DELAY] = _data.text_animation_delay;
-    doc[TEXT_LOOP_DELAY] = _data.text_loop_delay;
-    doc[WIFI_MAX_CONNECT_ATTEMPTS] = _data.wifi_max_connect_attempts;
-    doc[SENSOR_UPDATE_INTERVAL] = _data.sensor_update_interval;
-    doc[SENSOR_SEND_INTERVAL] = _data.sensor_send_interval;
-    doc[SETTINGS_SAVE_INTERVAL] = _data.settings_save_interval;
-    doc[SCREEN_ROTATION] = _data.screen_rotation;
-    doc[SCREEN_BRIGHTNESS] = _data.screen_brightness;
-    doc[SOUND_INDICATION] = _data.sound_indication;
-
-    write_schedule(doc.createNestedObject(SCHEDULE_FAN), _data.fan_schedule);
-    write_schedule(doc.createNestedObject(SCHEDULE_HUMIDIFIER), _data.humidifier_schedule);
-
-    write_alert(doc.createNestedObject(ALERT_TEMPERATURE), _data.alert_temperature);
-    write_alert(doc.createNestedObject(ALERT_CO2), _data.alert_co2);
-    write_alert(doc.createNestedObject(ALERT_HUMIDITY), _data.alert_humidity);
-    write_alert(doc.createNestedObject(ALERT_SEND_LAT), _data.alert_latency);
-
-    String result;
-    serializeJson(doc, result);
-
-    return result;
+// First zone is written at top level, so single zone layout is the same as before zones
+void Settings::json(JsonWriter &json, const SettingsEntry &data) {
+    json.begin_object();
+
+    json.field(TEXT_ANIMATION_DELAY, data.text_animation_delay);
+    json.field(TEXT_LOOP_DELAY, data.text_loop_delay);
+    json.field(WIFI_MAX_CONNECT_ATTEMPTS, data.wifi_max_connect_attempts);
+    json.field(SENSOR_UPDATE_INTERVAL, data.sensor_update_interval);
+    json.field(SENSOR_SEND_INTERVAL, data.sensor_send_interval);
+    json.field(UPLOAD_TRANSPORT, data.upload_transport);
+    json.field(SETTINGS_SAVE_INTERVAL, data.settings_save_interval);
+    json.field(SCREEN_ROTATION, data.screen_rotation);
+    json.field(SCREEN_BRIGHTNESS, data.screen_brightness);
+    json.field(SOUND_INDICATION, data.sound_indication);
+
+    write_zone(json, data.zones[0]);
+
+    if (ZONE_COUNT > 1) {
+        json.begin_object(ZONES);
+        for (uint8_t zone = 1; zone < ZONE_COUNT; ++zone) {
+            json.begin_object(Zones[zone].name);
+            write_zone(json, data.zones[zone]);
+            json.end_object();
+        }
+        json.end_object();
+    }
+
+    json.end_object();
 }
 
-boolean updateFieldFromRequest(WebServer &server, const char *fieldName, float &target) {
-    if (server.hasArg(fieldName)) {
-        target = server.arg(fieldName).toFloat();
+boolean updateFieldFromRequest(AsyncWebServerRequest *request, const char *fieldName, float &target) {
+    if (request->hasArg(fieldName)) {
+        target = request->arg(fieldName).toFloat();
         return true;
     }
 
     return false;
 }
 
-boolean updateFieldFromRequest(WebServer &server, const char *fieldName, boolean &target) {
-    if (server.hasArg(fieldName)) {
-        target = server.arg(fieldName).toInt() == 1;
+boolean updateFieldFromRequest(AsyncWebServerRequest *request, const char *fieldName, boolean &target) {
+    if (request->hasArg(fieldName)) {
+        target = request->arg(fieldName).toInt() == 1;
         return true;
     }
 
@@ -149,84 +211,95 @@ boolean updateFieldFromRequest(WebServer &server, const char *fieldName, boolean
 }
 
 template<typename T, typename = std::enable_if<std::is_enum<T>::value || std::is_integral<T>::value>>
-boolean updateFieldFromRequest(WebServer &server, const char *fieldName, T &target) {
-    if (server.hasArg(fieldName)) {
-        target = (T) server.arg(fieldName).toInt();
+boolean updateFieldFromRequest(AsyncWebServerRequest *request, const char *fieldName, T &target) {
+    if (request->hasArg(fieldName)) {
+        target = (T) request->arg(fieldName).toInt();
         return true;
     }
 
     return false;
 }
 
-boolean readAlert(WebServer &server, AlertEntry &entry) {
+boolean readAlert(AsyncWebServerRequest *request, AlertEntry &entry) {
     boolean ret = false;
 
-    ret = updateFieldFromRequest(server, ALERT_ENABLED, entry.enabled) || ret;
-    ret = updateFieldFromRequest(server, ALERT_INTERVAL, entry.alert_interval) || ret;
-    ret = updateFieldFromRequest(server, ALERT_MIN, entry.min) || ret;
-    ret = updateFieldFromRequest(server, ALERT_MAX, entry.max) || ret;
+    ret = updateFieldFromRequest(request, ALERT_ENABLED, entry.enabled) || ret;
+    ret = updateFieldFromRequest(request, ALERT_INTERVAL, entry.alert_interval) || ret;
+    ret = updateFieldFromRequest(request, ALERT_MIN, entry.min) || ret;
+    ret = updateFieldFromRequest(request, ALERT_MAX, entry.max) || ret;
 
     return ret;
 }
 
-boolean readSchedule(WebServer &server, ScheduleEntry &entry) {
+boolean readSchedule(AsyncWebServerRequest *request, ScheduleEntry &entry) {
     boolean ret = false;
 
-    ret = updateFieldFromRequest(server, SCHEDULE_PWM_FREQUENCY, entry.pwm_frequency) || ret;
-    ret = updateFieldFromRequest(server, SCHEDULE_MODE, entry.mode) || ret;
-    ret = updateFieldFromRequest(server, SCHEDULE_SENSOR, entry.sensor) || ret;
-    ret = updateFieldFromRequest(server, SCHEDULE_MIN_DUTY, entry.min_duty) || ret;
-    ret = updateFieldFromRequest(server, SCHEDULE_MAX_DUTY, entry.max_duty) || ret;
-    ret = updateFieldFromRequest(server, SCHEDULE_MIN_SENSOR_VALUE, entry.min_sensor_value) || ret;
-    ret = updateFieldFromRequest(server, SCHEDULE_MAX_SENSOR_VALUE, entry.max_sensor_value) || ret;
-    ret = updateFieldFromRequest(server, SCHEDULE_MAX_ACTIVE_TIME, entry.max_active_time) || ret;
-    ret = updateFieldFromRequest(server, SCHEDULE_ACTIVE_TIME_WINDOW, entry.active_time_window) || ret;
-    ret = updateFieldFromRequest(server, SCHEDULE_ACTIVATION_OFFSET, entry.activation_offset) || ret;
+    ret = updateFieldFromRequest(request, SCHEDULE_PWM_FREQUENCY, entry.pwm_frequency) || ret;
+    ret = updateFieldFromRequest(request, SCHEDULE_MODE, entry.mode) || ret;
+    ret = updateFieldFromRequest(request, SCHEDULE_SENSOR, entry.sensor) || ret;
+    ret = updateFieldFromRequest(request, SCHEDULE_MIN_DUTY, entry.min_duty) || ret;
+    ret = updateFieldFromRequest(request, SCHEDULE_MAX_DUTY, entry.max_duty) || ret;
+    ret = updateFieldFromRequest(request, SCHEDULE_MIN_SENSOR_VALUE, entry.min_sensor_value) || ret;
+    ret = updateFieldFromRequest(request, SCHEDULE_MAX_SENSOR_VALUE, entry.max_sensor_value) || ret;
+    ret = updateFieldFromRequest(request, SCHEDULE_MAX_ACTIVE_TIME, entry.max_active_time) || ret;
+    ret = updateFieldFromRequest(request, SCHEDULE_ACTIVE_TIME_WINDOW, entry.active_time_window) || ret;
+    ret = updateFieldFromRequest(request, SCHEDULE_ACTIVATION_OFFSET, entry.activation_offset) || ret;
 
     return ret;
 }
 
-bool Settings::update_settings(WebServer &server) {
+boolean readZone(AsyncWebServerRequest *request, ZoneSettings &zone) {
     boolean ret = false;
 
-    ret = updateFieldFromRequest(server, TEMP_CALIBRATION, _data.temperature_calibration) || ret;
-    ret = updateFieldFromRequest(server, HUMIDITY_CALIBRATION, _data.humidity_calibration) || ret;
-    ret = updateFieldFromRequest(server, CO2_CALIBRATION, _data.co2_calibration) || ret;
-    ret = updateFieldFromRequest(server, TEXT_ANIMATION_DELAY, _data.text_animation_delay) || ret;
-    ret = updateFieldFromRequest(server, TEXT_LOOP_DELAY, _data.text_loop_delay) || ret;
-    ret = updateFieldFromRequest(server, WIFI_MAX_CONNECT_ATTEMPTS, _data.wifi_max_connect_attempts) || ret;
-    ret = updateFieldFromRequest(server, SENSOR_UPDATE_INTERVAL, _data.sensor_update_interval) || ret;
-    ret = updateFieldFromRequest(server, SENSOR_SEND_INTERVAL, _data.sensor_send_interval) || ret;
-    ret = updateFieldFromRequest(server, SETTINGS_SAVE_INTERVAL, _data.settings_save_interval) || ret;
-    ret = updateFieldFromRequest(server, SCREEN_ROTATION, _data.screen_rotation) || ret;
-    ret = updateFieldFromRequest(server, SCREEN_BRIGHTNESS, _data.screen_brightness) || ret;
-    ret = updateFieldFromRequest(server, SOUND_INDICATION, _data.sound_indication) || ret;
-
-    if (server.hasArg(SCHEDULE_FAN)) {
-        ret = readSchedule(server, _data.fan_schedule) || ret;
+    for (uint8_t i = 0; i < SENSOR_COUNT; ++i) {
+        ret = updateFieldFromRequest(request, Channels[i].calibration_key, zone.calibration[i]) || ret;
     }
 
-    if (server.hasArg(SCHEDULE_HUMIDIFIER)) {
-        ret = readSchedule(server, _data.humidifier_schedule) || ret;
+    // Schedule and alert fields aren't prefixed, group to update is marked by its key in the request
+    for (uint8_t i = 0; i < ACTUATOR_COUNT; ++i) {
+        if (request->hasArg(Channels[ACTUATOR_FIRST + i].key)) {
+            ret = readSchedule(request, zone.schedules[i]) || ret;
+        }
     }
 
-    if (server.hasArg(ALERT_TEMPERATURE)) {
-        ret = readAlert(server, _data.alert_temperature) || ret;
+    for (uint8_t i = 0; i < ALERT_COUNT; ++i) {
+        if (request->hasArg(Channels[i].alert_key)) {
+            ret = readAlert(request, zone.alerts[i]) || ret;
+        }
     }
 
-    if (server.hasArg(ALERT_CO2)) {
-        ret = readAlert(server, _data.alert_co2) || ret;
-    }
+    return ret;
+}
 
-    if (server.hasArg(ALERT_HUMIDITY)) {
-        ret = readAlert(server, _data.alert_humidity) || ret;
-    }
+// Zone is selected by its name, first zone by default
+int find_zone(AsyncWebServerRequest *request) {
+    if (!request->hasArg(ZONE)) return 0;
 
-    if (server.hasArg(ALERT_SEND_LAT)) {
-        ret = readAlert(server, _data.alert_latency) || ret;
-    }
+    return zone_by_name(request->arg(ZONE));
+}
+
+bool Settings::update_settings(AsyncWebServerRequest *request) {
+    const int zone = find_zone(request);
+    if (zone < 0) return false;
+
+    // All fields of the request are applied to the private copy and published at once
+    auto *draft = _begin_update();
+    boolean ret = false;
+
+    ret = updateFieldFromRequest(request, TEXT_ANIMATION_DELAY, draft->text_animation_delay) || ret;
+    ret = updateFieldFromRequest(request, TEXT_LOOP_DELAY, draft->text_loop_delay) || ret;
+    ret = updateFieldFromRequest(request, WIFI_MAX_CONNECT_ATTEMPTS, draft->wifi_max_connect_attempts) || ret;
+    ret = updateFieldFromRequest(request, SENSOR_UPDATE_INTERVAL, draft->sensor_update_interval) || ret;
+    ret = updateFieldFromRequest(request, SENSOR_SEND_INTERVAL, draft->sensor_send_interval) || ret;
+    ret = updateFieldFromRequest(request, UPLOAD_TRANSPORT, draft->upload_transport) || ret;
+    ret = updateFieldFromRequest(request, SETTINGS_SAVE_INTERVAL, draft->settings_save_interval) || ret;
+    ret = updateFieldFromRequest(request, SCREEN_ROTATION, draft->screen_rotation) || ret;
+    ret = updateFieldFromRequest(request, SCREEN_BRIGHTNESS, draft->screen_brightness) || ret;
+    ret = updateFieldFromRequest(request, SOUND_INDICATION, draft->sound_indication) || ret;
+
+    ret = readZone(request, draft->zones[zone]) || ret;
 
-    if (ret) _commit();
+    _end_update(draft, ret);
     return ret;
 }
 
@@ -260,8 +333,8 @@ void Settings::_commit() {
     _save_timer_id = (long) _timer.add_timeout([](void *param) {
         auto *self = (Settings *) param;
         self->_save_timer_id = -1;
-        _settings_commit_impl(Settings::_offset, self->_data);
-    }, _data.settings_save_interval, this);
+        _settings_commit_impl(Settings::_offset, *self->get());
+    }, _current.load()->settings_save_interval, this);
 }
 
 void Settings::force_save() {
@@ -272,5 +345,5 @@ void Settings::force_save() {
         _timer.clear_timeout(_save_timer_id);
     }
 
-    _settings_commit_impl(Settings::_offset, _data);
+    _settings_commit_impl(Settings::_offset, *get());
 }
@@ -1,30 +1,46 @@
 #pragma once
 
+#include <atomic>
 #include <EEPROM.h>
 
+#include "channels.h"
 #include "debug.h"
+#include "json_writer.h"
 #include "models.h"
 #include "timer.h"
+#include "zones.h"
 
 #define SETTINGS_HEADER (int) 0xffaabbcc
-#define SETTINGS_VERSION (int) 9
+#define SETTINGS_VERSION (int) 12
 
-class WebServer;
+#define SETTINGS_SNAPSHOT_COUNT 4
+
+class AsyncWebServerRequest;
+
+// Per channel settings of a zone, indexed by ChannelId (schedules from ACTUATOR_FIRST), defaults come from Channels[]
+struct ZoneSettings {
+    float calibration[SENSOR_COUNT];
+    AlertEntry alerts[ALERT_COUNT];
+    ScheduleEntry schedules[ACTUATOR_COUNT];
+
+    ZoneSettings() {
+        for (uint8_t i = 0; i < SENSOR_COUNT; ++i) calibration[i] = 0.0f;
+        for (uint8_t i = 0; i < ALERT_COUNT; ++i) alerts[i] = Channels[i].alert;
+        for (uint8_t i = 0; i < ACTUATOR_COUNT; ++i) schedules[i] = Channels[ACTUATOR_FIRST + i].schedule;
+    }
+};
 
 struct SettingsEntry {
     int header = SETTINGS_HEADER;
     int version = SETTINGS_VERSION;
 
-    float temperature_calibration = 0.0f;
-    float humidity_calibration = 0.0f;
-    float co2_calibration = 0.0f;
-
     unsigned int text_animation_delay = 80;
     unsigned int text_loop_delay = 3000;
     unsigned int wifi_max_connect_attempts = 600;
 
     unsigned long sensor_update_interval = (unsigned long) 5 * 1000;
     unsigned long sensor_send_interval = (unsigned long) 15 * 1000;
+    UploadTransport upload_transport = UPLOAD_HTTP;
 
     unsigned long settings_save_interval = 15000;
 
@@ -33,22 +49,53 @@ struct SettingsEntry {
 
     boolean sound_indication = true;
 
-    AlertEntry alert_temperature = {true, (unsigned long) 5 * 60 * 1000, 22, 24};
-    AlertEntry alert_co2 = {true, (unsigned long) 5 * 60 * 1000, 400, 1500};
-    AlertEntry alert_humidity = {true, (unsigned long) 5 * 60 * 1000, 80, 100};
-    AlertEntry alert_latency = {true, (unsigned long) 5 * 60 * 1000, 0, 60000};
-
-    ScheduleEntry fan_schedule = {ScheduleMode::PWM, SensorType::CO2, 500, 1000, 480, 3600, 0, 26000, 0, 1};
-    ScheduleEntry humidifier_schedule = {ScheduleMode::PWM, SensorType::HUMIDITY, 100, 80, 480, 3600, 0, 26000, 0, 1};
+    // Indexed by zone
+    ZoneSettings zones[ZONE_COUNT];
 };
 
 typedef void (*update_fn)(SettingsEntry &data);
 
+/*
+ * Read-only handle to a published settings snapshot.
+ * Snapshot slot can't be reused by writer while any handle to it is alive,
+ * so keep handles short-lived: take one per loop iteration / request.
+ */
+class SettingsSnapshot {
+    const SettingsEntry *_entry;
+    std::atomic<uint8_t> *_readers;
+
+public:
+    SettingsSnapshot(const SettingsEntry *entry, std::atomic<uint8_t> *readers) : _entry(entry), _readers(readers) {}
+
+    SettingsSnapshot(const SettingsSnapshot &other) : _entry(other._entry), _readers(other._readers) {
+        _readers->fetch_add(1);
+    }
+
+    SettingsSnapshot(SettingsSnapshot &&other) noexcept: _entry(other._entry), _readers(other._readers) {
+        other._readers = nullptr;
+    }
+
+    SettingsSnapshot &operator=(const SettingsSnapshot &) = delete;
+
+    ~SettingsSnapshot() {
+        if (_readers != nullptr) _readers->fetch_sub(1);
+    }
+
+    inline const SettingsEntry *operator->() const { return _entry; }
+    inline const SettingsEntry &operator*() const { return *_entry; }
+};
+
 class Settings {
     static const int _offset = 0;
     volatile static boolean _initialized;
 
-    SettingsEntry _data;
+    // Readers never lock: they pin current slot with reader counter and writers publish modified copy
+    // into a free slot with single atomic pointer swap. Retired slot is reclaimed once its readers are gone.
+    SettingsEntry _slots[SETTINGS_SNAPSHOT_COUNT];
+    mutable std::atomic<uint8_t> _readers[SETTINGS_SNAPSHOT_COUNT];
+    std::atomic<SettingsEntry *> _current;
+
+    SemaphoreHandle_t _write_mutex;
     Timer &_timer;
 
     long _save_timer_id = -1;
@@ -60,11 +107,11 @@ public:
 
     void begin();
 
-    inline const SettingsEntry &get() const { return _data; }
+    SettingsSnapshot get() const;
 
-    String json() const;
+    static void json(JsonWriter &json, const SettingsEntry &data);
 
-    boolean update_settings(WebServer &server);
+    boolean update_settings(AsyncWebServerRequest *request);
 
     void update_settings(update_fn fn);
 
@@ -75,6 +122,10 @@ public:
     void force_save();
 
 private:
+    SettingsEntry *_begin_update();
+
+    void _end_update(SettingsEntry *draft, bool publish);
+
     void _commit();
 };
 
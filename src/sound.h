@@ -1,9 +1,15 @@
 #pragma once
 
 #include <Arduino.h>
+#include <esp_timer.h>
+
+#include "debug.h"
 #include "hardware.h"
 #include "settings.h"
 
+#define SOUND_QUEUE_LENGTH 4
+
+// Pairs of frequency (Hz) and duration (ms)
 const unsigned int SOUND_WIFI_ON[] = {
         880, 120,
         1046, 240
@@ -20,13 +26,164 @@ const unsigned int SOUND_ALERT[] = {
         698, 120
 };
 
-template<unsigned long SIZE>
-void play_sound(const unsigned int (&notes)[SIZE]) {
-    if (!settings.get().sound_indication) return;
+enum SoundPriority : uint8_t {
+    SOUND_PRIORITY_LOW,
+    SOUND_PRIORITY_NORMAL,
+    SOUND_PRIORITY_HIGH,
+};
+
+struct SoundSequence {
+    const unsigned int *notes;
+    uint16_t size;
+    SoundPriority priority;
+};
+
+/*
+ * Background melody player. Notes are generated by LEDC and switched by one-shot esp_timer,
+ * so callers never wait for the melody to finish.
+ * Sequence with higher priority interrupts the playing one, otherwise it waits in the queue.
+ */
+class SoundPlayer {
+    uint8_t _pin;
+    uint8_t _channel;
+
+    esp_timer_handle_t _timer = nullptr;
+    SemaphoreHandle_t _mutex = nullptr;
+
+    SoundSequence _current{};
+    uint16_t _position = 0;
+    volatile bool _playing = false;
+    int64_t _note_end = 0;
+
+    SoundSequence _queue[SOUND_QUEUE_LENGTH]{};
+    uint8_t _queue_size = 0;
+
+public:
+    SoundPlayer(uint8_t pin, uint8_t channel) : _pin(pin), _channel(channel) {}
+
+    void begin() {
+        _mutex = xSemaphoreCreateMutex();
+
+        ledcSetup(_channel, 1000, 8);
+        ledcAttachPin(_pin, _channel);
+        ledcWriteTone(_channel, 0);
 
-    for (unsigned long i = 0; i < SIZE; i += 2) {
-        tone(PIN_SPEAKER, notes[i]);
-        delay(notes[i + 1]);
-        noTone(PIN_SPEAKER);
+        esp_timer_create_args_t args{};
+        args.callback = _on_timer;
+        args.arg = this;
+        args.name = "sound";
+
+        esp_timer_create(&args, &_timer);
+    }
+
+    void play(const unsigned int *notes, uint16_t size, SoundPriority priority) {
+        if (_timer == nullptr || size < 2) return;
+
+        xSemaphoreTake(_mutex, portMAX_DELAY);
+
+        const SoundSequence sequence{notes, size, priority};
+        if (!_playing) {
+            _start(sequence);
+        } else if (priority > _current.priority) {
+            // Interrupted sequence is dropped, it would be out of place after the more important one
+            esp_timer_stop(_timer);
+            _start(sequence);
+        } else {
+            _enqueue(sequence);
+        }
+
+        xSemaphoreGive(_mutex);
     }
-}
\ No newline at end of file
+
+    inline bool playing() const { return _playing; }
+
+    // Use before actions which stop the sound, like restart
+    void wait() const {
+        while (_playing) delay(10);
+    }
+
+private:
+    static void _on_timer(void *arg) {
+        auto *self = (SoundPlayer *) arg;
+
+        xSemaphoreTake(self->_mutex, portMAX_DELAY);
+
+        // Sequence could be replaced while callback was waiting for the mutex, its timer is still pending then
+        if (self->_playing && esp_timer_get_time() >= self->_note_end) {
+            self->_next_note();
+        }
+
+        xSemaphoreGive(self->_mutex);
+    }
+
+    void _start(const SoundSequence &sequence) {
+        _current = sequence;
+        _position = 0;
+        _playing = true;
+
+        _next_note();
+    }
+
+    void _next_note() {
+        if (_position + 1 >= _current.size) {
+            ledcWriteTone(_channel, 0);
+            _playing = false;
+
+            if (_queue_size > 0) _start(_dequeue());
+            return;
+        }
+
+        const auto frequency = _current.notes[_position];
+        const auto duration_us = (uint64_t) _current.notes[_position + 1] * 1000;
+        _position += 2;
+
+        ledcWriteTone(_channel, frequency);
+
+        _note_end = esp_timer_get_time() + (int64_t) duration_us;
+        esp_timer_start_once(_timer, duration_us);
+    }
+
+    void _enqueue(const SoundSequence &sequence) {
+        if (_queue_size < SOUND_QUEUE_LENGTH) {
+            _queue[_queue_size++] = sequence;
+            return;
+        }
+
+        // Queue is full: replace the newest of the least important sequences if it's less important
+        uint8_t lowest = 0;
+        for (uint8_t i = 1; i < _queue_size; ++i) {
+            if (_queue[i].priority <= _queue[lowest].priority) lowest = i;
+        }
+
+        if (_queue[lowest].priority < sequence.priority) {
+            _queue[lowest] = sequence;
+        } else {
+#ifdef DEBUG
+            Serial.println("Sound queue is full, sequence dropped");
+#endif
+        }
+    }
+
+    // The most important sequence, first queued among equal ones
+    SoundSequence _dequeue() {
+        uint8_t best = 0;
+        for (uint8_t i = 1; i < _queue_size; ++i) {
+            if (_queue[i].priority > _queue[best].priority) best = i;
+        }
+
+        const auto result = _queue[best];
+        for (uint8_t i = best + 1; i < _queue_size; ++i) _queue[i - 1] = _queue[i];
+        --_queue_size;
+
+        return result;
+    }
+};
+
+static SoundPlayer speaker(PIN_SPEAKER, PWM_CHANNEL_SPEAKER);
+
+template<unsigned long SIZE>
+void play_sound(const unsigned int (&notes)[SIZE], SoundPriority priority = SOUND_PRIORITY_NORMAL) {
+    if (!settings.get()->sound_indication) return;
+
+    speaker.play(notes, SIZE, priority);
+}
@@ -0,0 +1,186 @@
+#pragma once
+
+#include <Arduino.h>
+#include <atomic>
+
+#include "json_writer.h"
+#include "metric_types.h"
+
+/*
+ * Loop profiling of the firmware tasks. Every iteration of a task loop is measured between begin() and end(),
+ * which feeds loop metrics and accumulates time the task was busy. Time the iteration spent waiting for network
+ * is reported by blocked(), so it can be told apart from CPU time.
+ *
+ * When FreeRTOS run-time stats are enabled in SDK config, they are reported too and used for core utilization.
+ * Otherwise utilization is estimated from the profiled tasks only.
+ */
+
+#if configGENERATE_RUN_TIME_STATS && configUSE_TRACE_FACILITY
+#define PROFILE_RUNTIME_STATS 1
+#else
+#define PROFILE_RUNTIME_STATS 0
+#endif
+
+#define PROFILE_TASK_COUNT 3
+#define PROFILE_MAX_RUNTIME_TASKS 24
+
+class TaskProfile {
+    Histogram &_duration;
+    PeakGauge &_peak;
+
+    // Written only by the owning task, sub-millisecond remainders of the totals
+    unsigned long _start = 0;
+    uint32_t _busy_us = 0;
+    uint32_t _blocked_us = 0;
+
+    // Totals are in milliseconds to last for 49 days
+    std::atomic<uint32_t> _iterations{0};
+    std::atomic<uint32_t> _busy_ms{0};
+    std::atomic<uint32_t> _blocked_ms{0};
+    std::atomic<int8_t> _core{-1};
+
+    static void _accumulate(uint32_t &remainder_us, std::atomic<uint32_t> &total_ms, uint32_t us) {
+        remainder_us += us;
+        if (remainder_us >= 1000) {
+            total_ms.fetch_add(remainder_us / 1000, std::memory_order_relaxed);
+            remainder_us %= 1000;
+        }
+    }
+
+public:
+    const char *const task;
+
+    TaskProfile(const char *task, Histogram &duration, PeakGauge &peak) : _duration(duration), _peak(peak), task(task) {}
+
+    inline void begin() { _start = micros(); }
+
+    void end() {
+        const uint32_t elapsed = micros() - _start;
+        _duration.observe(elapsed);
+        _peak.observe(elapsed);
+
+        _iterations.fetch_add(1, std::memory_order_relaxed);
+        _core.store((int8_t) xPortGetCoreID(), std::memory_order_relaxed);
+        _accumulate(_busy_us, _busy_ms, elapsed);
+    }
+
+    // Part of the current iteration spent waiting for I/O
+    inline void blocked(uint32_t us) { _accumulate(_blocked_us, _blocked_ms, us); }
+
+    inline int8_t core() const { return _core.load(std::memory_order_relaxed); }
+    inline uint32_t iterations() const { return _iterations.load(std::memory_order_relaxed); }
+    inline uint32_t busy_ms() const { return _busy_ms.load(std::memory_order_relaxed); }
+    inline uint32_t blocked_ms() const { return _blocked_ms.load(std::memory_order_relaxed); }
+    inline uint32_t max_us() const { return _peak.peak(); }
+};
+
+static const char *const PROFILE_CORE_KEYS[] = {"0", "1"};
+
+struct TaskProfileState {
+    const char *task;
+    int8_t core;
+    uint32_t iterations;
+    uint32_t busy_ms;
+    uint32_t blocked_ms;
+    uint32_t max_us;
+    float stack_free;
+};
+
+struct RuntimeState {
+    char task[configMAX_TASK_NAME_LEN];
+    int8_t core;
+    uint32_t runtime;
+    uint32_t stack_free;
+};
+
+struct ProfileState {
+    uint32_t uptime_ms;
+    TaskProfileState tasks[PROFILE_TASK_COUNT];
+
+    uint32_t total_runtime;
+    uint8_t runtime_count;
+    RuntimeState runtime[PROFILE_MAX_RUNTIME_TASKS];
+};
+
+// Rounded to tenth, in double so it is printed without float noise
+inline double _profile_percent(uint32_t value, uint32_t total) {
+    return total > 0 ? round((double) value * 1000 / total) / 10 : NAN;
+}
+
+inline uint32_t _profile_cpu_ms(const TaskProfileState &task) {
+    return task.busy_ms > task.blocked_ms ? task.busy_ms - task.blocked_ms : 0;
+}
+
+// Busy share of each core: idle tasks' run time when run-time stats have core ids, profiled tasks otherwise
+inline void _core_utilization(const ProfileState &state, double (&result)[portNUM_PROCESSORS]) {
+    uint32_t idle[portNUM_PROCESSORS]{};
+    bool has_idle = false;
+
+    for (uint8_t i = 0; i < state.runtime_count; ++i) {
+        auto &entry = state.runtime[i];
+        if (entry.core >= 0 && strncmp(entry.task, "IDLE", 4) == 0) {
+            idle[entry.core] += entry.runtime;
+            has_idle = true;
+        }
+    }
+
+    for (uint8_t core = 0; core < portNUM_PROCESSORS; ++core) {
+        if (has_idle) {
+            result[core] = _profile_percent(state.total_runtime - idle[core], state.total_runtime);
+            continue;
+        }
+
+        uint32_t busy = 0;
+        for (auto &task: state.tasks) {
+            if (task.core == core) busy += _profile_cpu_ms(task);
+        }
+
+        result[core] = _profile_percent(busy, state.uptime_ms);
+    }
+}
+
+// Layout of /profile. Times are since boot, percents are of a single core
+inline void profile_json(JsonWriter &json, const ProfileState &state) {
+    json.begin_object();
+    json.field("uptime", state.uptime_ms);
+
+    json.begin_object("tasks");
+    for (auto &task: state.tasks) {
+        json.begin_object(task.task);
+        json.field("core", task.core);
+        json.field("iterations", task.iterations);
+        json.field("avg_us", task.iterations ? (uint32_t) ((uint64_t) task.busy_ms * 1000 / task.iterations) : 0u);
+        json.field("max_us", task.max_us);
+        json.field("busy", _profile_percent(task.busy_ms, state.uptime_ms));
+        json.field("blocked_ms", task.blocked_ms);
+        json.field("cpu", _profile_percent(_profile_cpu_ms(task), state.uptime_ms));
+        json.field("stack_free", task.stack_free);
+        json.end_object();
+    }
+    json.end_object();
+
+    double cores[portNUM_PROCESSORS];
+    _core_utilization(state, cores);
+
+    json.begin_object("cores");
+    for (uint8_t core = 0; core < portNUM_PROCESSORS; ++core) {
+        json.field(PROFILE_CORE_KEYS[core], cores[core]);
+    }
+    json.end_object();
+
+    if (state.runtime_count) {
+        json.begin_object("runtime");
+        for (uint8_t i = 0; i < state.runtime_count; ++i) {
+            auto &entry = state.runtime[i];
+
+            json.begin_object(entry.task);
+            json.field("core", entry.core);
+            json.field("cpu", _profile_percent(entry.runtime, state.total_runtime));
+            json.field("stack_free", entry.stack_free);
+            json.end_object();
+        }
+        json.end_object();
+    }
+
+    json.end_object();
+}
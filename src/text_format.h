@@ -0,0 +1,75 @@
+#pragma once
+
+#include <Arduino.h>
+
+/*
+ * Text formatting into fixed char buffer without heap allocations.
+ * Numbers are formatted with integer math, text that doesn't fit is truncated and always null-terminated.
+ */
+class TextBuffer {
+    char *_buffer;
+    size_t _size;
+    size_t _length = 0;
+
+public:
+    TextBuffer(char *buffer, size_t size) : _buffer(buffer), _size(size) { _buffer[0] = '\0'; }
+
+    template<size_t SIZE>
+    explicit TextBuffer(char (&buffer)[SIZE]) : TextBuffer(buffer, SIZE) {}
+
+    inline size_t length() const { return _length; }
+    inline const char *c_str() const { return _buffer; }
+
+    TextBuffer &text(const char *str) {
+        while (*str) _char(*str++);
+
+        _buffer[_length] = '\0';
+        return *this;
+    }
+
+    TextBuffer &number(uint32_t value) {
+        char digits[10];
+        uint8_t count = 0;
+
+        do {
+            digits[count++] = char('0' + value % 10);
+            value /= 10;
+        } while (value);
+
+        while (count) _char(digits[--count]);
+
+        _buffer[_length] = '\0';
+        return *this;
+    }
+
+    // Fixed-point value rounded to `fraction` digits, prints "nan" and "ovf" like Print does
+    TextBuffer &fixed(float value, uint8_t fraction) {
+        if (isnan(value)) return text("nan");
+
+        static const uint32_t POW10[] = {1, 10, 100, 1000, 10000};
+        if (fraction > 4) fraction = 4;
+
+        const float scaled = fabsf(value) * (float) POW10[fraction] + 0.5f;
+        if (scaled >= 4294967040.0f) return text("ovf");
+
+        const auto units = (uint32_t) scaled;
+        if (value < 0 && units > 0) text("-");
+
+        number(units / POW10[fraction]);
+        if (fraction == 0) return *this;
+
+        text(".");
+        const uint32_t decimals = units % POW10[fraction];
+        for (uint32_t divider = POW10[fraction] / 10; divider > 0; divider /= 10) {
+            _char(char('0' + decimals / divider % 10));
+        }
+
+        _buffer[_length] = '\0';
+        return *this;
+    }
+
+private:
+    inline void _char(char c) {
+        if (_length + 1 < _size) _buffer[_length++] = c;
+    }
+};
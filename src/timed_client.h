@@ -0,0 +1,99 @@
+#pragma once
+
+#include <Arduino.h>
+#include <WiFi.h>
+#include <WiFiClientSecure.h>
+#include <esp_timer.h>
+
+enum HttpPhase : uint8_t {
+    // Host name lookup, new connections only
+    HTTP_PHASE_DNS,
+
+    // TCP connect and TLS handshake, WiFiClientSecure does both in one call. New connections only
+    HTTP_PHASE_CONNECT,
+
+    // From the first byte of the request to the last one handed to the socket
+    HTTP_PHASE_WRITE,
+
+    // From the end of the request to the first byte of the response
+    HTTP_PHASE_FIRST_BYTE,
+
+    HTTP_PHASE_COUNT,
+};
+
+/*
+ * TLS client which timestamps what HTTPClient does with it, so a request is split into phases.
+ * Slow DNS or connect points to the link, slow first byte to the backend.
+ * Phases which didn't happen in the request (e.g. connect of a reused connection) are negative.
+ * It also counts request bytes accepted by the connection, before TLS framing.
+ */
+class TimedClient : public WiFiClientSecure {
+    int64_t _phases[HTTP_PHASE_COUNT];
+
+    int64_t _write_start;
+    int64_t _write_end;
+    bool _first_byte;
+
+    size_t _bytes_written;
+
+public:
+    TimedClient() { begin_request(); }
+
+    void begin_request() {
+        for (auto &phase: _phases) phase = -1;
+
+        _write_start = -1;
+        _write_end = -1;
+        _first_byte = false;
+
+        _bytes_written = 0;
+    }
+
+    // Duration in microseconds, negative if phase didn't happen
+    inline int64_t phase(HttpPhase phase) const { return _phases[phase]; }
+
+    // Nothing is written when request fails to connect, and only a part of it when connection breaks
+    inline size_t bytes_written() const { return _bytes_written; }
+
+    int connect(const char *host, uint16_t port, int32_t timeout) override {
+        // Address is cached by lwIP, so lookup inside connect() doesn't go to the network again
+        int64_t start = esp_timer_get_time();
+        IPAddress address;
+        if (!WiFi.hostByName(host, address)) return 0;
+
+        int64_t end = esp_timer_get_time();
+        _phases[HTTP_PHASE_DNS] = end - start;
+
+        start = end;
+        const int result = WiFiClientSecure::connect(host, port, timeout);
+        if (result) _phases[HTTP_PHASE_CONNECT] = esp_timer_get_time() - start;
+
+        return result;
+    }
+
+    size_t write(const uint8_t *buffer, size_t size) override {
+        const int64_t start = esp_timer_get_time();
+        if (_write_start < 0) _write_start = start;
+
+        const size_t written = WiFiClientSecure::write(buffer, size);
+        _bytes_written += written;
+
+        // Request is written in several calls (headers and payload), phase spans all of them
+        _write_end = esp_timer_get_time();
+        _phases[HTTP_PHASE_WRITE] = _write_end - _write_start;
+
+        return written;
+    }
+
+    using WiFiClientSecure::write;
+
+    int available() override {
+        const int result = WiFiClientSecure::available();
+        if (result > 0 && !_first_byte && _write_end >= 0) {
+            _first_byte = true;
+            _phases[HTTP_PHASE_FIRST_BYTE] = esp_timer_get_time() - _write_end;
+        }
+
+        return result;
+    }
+};
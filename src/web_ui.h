@@ -1,73 +1,354 @@
 #pragma once
 
-#include <WebServer.h>
+#include <ESPAsyncWebServer.h>
 
+#include "boot.h"
+#include "channels.h"
+#include "event_bus.h"
+#include "events.h"
+#include "generated/web_assets.h"
+#include "json_writer.h"
+#include "metrics.h"
+#include "profiler.h"
 #include "settings.h"
 
-extern const char WEB_INDEX[] asm("_binary_html_index_html_start");
+// Page is revalidated by ETag after cache expiration, so keep it reasonable to pick up firmware updates
+const char *WEB_CACHE_CONTROL = "public, max-age=86400";
 
-static WebServer server(80);
+const unsigned long WEB_RESTART_DELAY = 500;
 
-String status_json() {
-    StaticJsonDocument<256> doc;
-    doc["temp"] = sensor_data.temperature;
-    doc["hum"] = sensor_data.humidity;
-    doc["co2"] = sensor_data.co2;
-    doc["fan"] = sensor_data.fan_speed;
-    doc["humr"] = sensor_data.humidifier_power;
-    doc["lat"] = sensor_data.send_latency;
+static AsyncWebServer server(80);
 
-    auto system = doc.createNestedObject("system");
-    system["uptime"] = esp_timer_get_time() / 1000000ULL;
-    system["wifi"] = WiFi.RSSI();
-    system["config_p"] = settings.is_pending_commit();
+// Long-running actions are moved out of the server callbacks, so they don't stall other connections
+static volatile bool restart_requested = false;
 
-    String result;
-    serializeJson(doc, result);
-    return result;
+struct StatusState {
+    // Indexed by zone and ChannelId
+    float values[ZONE_COUNT][CHANNEL_COUNT];
+
+    unsigned long long uptime;
+    int8_t wifi;
+    bool config_p;
+};
+
+// Channel values are NaN, so first event carries all of them
+StatusState empty_status() {
+    StatusState state{};
+    for (auto &zone: state.values) {
+        for (auto &value: zone) value = NAN;
+    }
+
+    return state;
+}
+
+static StatusState last_status_event = empty_status();
+#define STATUS_EVENT_MAX_LENGTH (128 + 128 * ZONE_COUNT)
+
+static char status_event_buffer[STATUS_EVENT_MAX_LENGTH];
+
+StatusState current_status() {
+    StatusState state{};
+    for (uint8_t zone = 0; zone < ZONE_COUNT; ++zone) sensor_data[zone].copy_to(state.values[zone]);
+
+    state.uptime = esp_timer_get_time() / 1000000ULL;
+    state.wifi = WiFi.RSSI();
+    state.config_p = settings.is_pending_commit();
+
+    return state;
+}
+
+inline bool status_changed(float value, float prev) {
+    return !(value == prev || (isnan(value) && isnan(prev)));
+}
+
+void status_zone_json(JsonWriter &json, const float (&values)[CHANNEL_COUNT], const float (*prev)[CHANNEL_COUNT]) {
+    for (auto &channel: Channels) {
+        const float value = values[channel.id];
+        if (!prev || status_changed(value, (*prev)[channel.id])) json.field(channel.key, value);
+    }
+}
+
+/*
+ * Layout of /status. When prev is passed only changed fields are written.
+ * First zone is at top level, other zones are in "zones" object by name.
+ */
+void status_json(JsonWriter &json, const StatusState &state, const StatusState *prev = nullptr) {
+    json.begin_object();
+    status_zone_json(json, state.values[0], prev ? &prev->values[0] : nullptr);
+
+    if (ZONE_COUNT > 1) {
+        json.begin_object("zones");
+        for (uint8_t zone = 1; zone < ZONE_COUNT; ++zone) {
+            json.begin_object(Zones[zone].name);
+            status_zone_json(json, state.values[zone], prev ? &prev->values[zone] : nullptr);
+            json.end_object();
+        }
+        json.end_object();
+    }
+
+    json.begin_object("system");
+    json.field("uptime", state.uptime);
+    if (!prev || state.wifi != prev->wifi) json.field("wifi", state.wifi);
+    if (!prev || state.config_p != prev->config_p) json.field("config_p", state.config_p);
+    json.end_object();
+
+    json.end_object();
+}
+
+// Writes null-terminated event into buffer, returns false if it doesn't fit
+bool status_event_json(char *buffer, size_t size, const StatusState &state, const StatusState *prev) {
+    ChunkWriter out((uint8_t *) buffer, size - 1);
+    JsonWriter json(out);
+    status_json(json, state, prev);
+
+    if (out.overflow()) return false;
+
+    buffer[out.written()] = '\0';
+    return true;
+}
+
+// Rendered JSON responses: largest is /settings, which grows with zones
+#define JSON_RESPONSE_SLOT_COUNT 2
+#define JSON_RESPONSE_MAX_LENGTH (512 + 768 * ZONE_COUNT)
+
+// Slot of a response which didn't finish in this time is taken by a new one, connection is dropped by then
+const unsigned long JSON_RESPONSE_TIMEOUT = 10000;
+
+struct JsonResponseSlot {
+    // Changed on every reuse, so filler of an abandoned response doesn't read the new one
+    uint32_t generation;
+    bool busy;
+    unsigned long started_at;
+    size_t length;
+    char data[JSON_RESPONSE_MAX_LENGTH];
+};
+
+// Used only by server callbacks, which run in one task
+static JsonResponseSlot json_response_slots[JSON_RESPONSE_SLOT_COUNT];
+
+JsonResponseSlot *acquire_json_response_slot() {
+    JsonResponseSlot *slot = nullptr;
+    for (auto &candidate: json_response_slots) {
+        if (!candidate.busy) {
+            slot = &candidate;
+            break;
+        }
+
+        if (millis() - candidate.started_at > JSON_RESPONSE_TIMEOUT) slot = &candidate;
+    }
+
+    if (slot == nullptr) return nullptr;
+
+    ++slot->generation;
+    slot->busy = true;
+    slot->started_at = millis();
+
+    return slot;
+}
+
+/*
+ * Responds with JSON generated by fn(JsonWriter &). It is rendered once into a pooled buffer
+ * and chunks are copied from there, so neither the text nor its data live on the heap during the response.
+ * Filler captures only slot and its generation, which std::function keeps without allocation.
+ */
+template<typename Fn>
+void send_json(AsyncWebServerRequest *request, Fn fn) {
+    JsonResponseSlot *slot = acquire_json_response_slot();
+    if (slot == nullptr) {
+        request->send(503, "plain/text", "Service Unavailable");
+        return;
+    }
+
+    ChunkWriter out((uint8_t *) slot->data, sizeof(slot->data));
+    JsonWriter json(out);
+    fn(json);
+
+    if (out.overflow()) {
+#ifdef DEBUG
+        Serial.print("JSON response doesn't fit: ");
+        Serial.println(out.position());
+#endif
+        slot->busy = false;
+        request->send(500, "plain/text", "Internal Server Error");
+        return;
+    }
+
+    slot->length = out.written();
+
+    const uint32_t generation = slot->generation;
+    request->send(request->beginResponse("application/json", slot->length, [slot, generation](uint8_t *buffer, size_t max_len, size_t index) -> size_t {
+        if (slot->generation != generation || index >= slot->length) return 0;
+
+        const size_t length = std::min(max_len, slot->length - index);
+        memcpy(buffer, slot->data + index, length);
+
+        if (index + length == slot->length) slot->busy = false;
+        return length;
+    }));
+}
+
+void on_status_events_connect(AsyncEventSourceClient *client) {
+    // New subscriber starts from full state, following events carry only changes
+    char buffer[STATUS_EVENT_MAX_LENGTH];
+    if (status_event_json(buffer, sizeof(buffer), current_status(), nullptr)) {
+        client->send(buffer);
+    }
+}
+
+/*
+ * Deltas are taken against the last state seen even without subscribers, page which connects later
+ * gets full state and then changes from there. Delta which doesn't fit is replaced by full state.
+ */
+void send_status_event() {
+    const auto state = current_status();
+
+    if (status_events.has_subscribers()) {
+        if (status_event_json(status_event_buffer, sizeof(status_event_buffer), state, &last_status_event)
+            || status_event_json(status_event_buffer, sizeof(status_event_buffer), state, nullptr)) {
+            status_events.broadcast(status_event_buffer);
+        }
+    }
+
+    last_status_event = state;
+}
+
+// Streamed as "alert" event: {"zone":"main","channel":"co2","value":1600,"active":true}
+void send_alert_event(const Event &event) {
+    if (!status_events.has_subscribers()) return;
+
+    char buffer[128];
+    ChunkWriter out((uint8_t *) buffer, sizeof(buffer) - 1);
+    JsonWriter json(out);
+
+    json.begin_object();
+    json.field("zone", Zones[event.zone].name);
+    json.field("channel", Channels[event.channel].key);
+    json.field("value", event.value);
+    json.field("active", event.type == EVENT_ALERT_RAISED);
+    json.end_object();
+
+    buffer[out.written()] = '\0';
+    status_events.broadcast(buffer, "alert");
+}
+
+// Burst of changes is sent as one status event
+void handle_events() {
+    bool status_dirty = false;
+
+    Event event;
+    while (web_events.take(event)) {
+        switch (event.type) {
+            case EVENT_ALERT_RAISED:
+            case EVENT_ALERT_CLEARED:
+                send_alert_event(event);
+                break;
+
+            default:
+                status_dirty = true;
+                break;
+        }
+    }
+
+    if (status_dirty) send_status_event();
+}
+
+void send_index(AsyncWebServerRequest *request) {
+    AsyncWebServerResponse *response;
+    if (request->hasHeader("If-None-Match") && request->header("If-None-Match") == WEB_INDEX_ETAG) {
+        response = request->beginResponse(304);
+    } else {
+        response = request->beginResponse_P(200, "text/html", WEB_INDEX_GZ, WEB_INDEX_GZ_SIZE);
+        response->addHeader("Content-Encoding", "gzip");
+    }
+
+    response->addHeader("ETag", WEB_INDEX_ETAG);
+    response->addHeader("Cache-Control", WEB_CACHE_CONTROL);
+    request->send(response);
+}
+
+void handle_restart() {
+    if (!restart_requested) return;
+
+    // Let the response reach the client first
+    delay(WEB_RESTART_DELAY);
+
+    if (settings.is_pending_commit()) {
+        settings.force_save();
+    }
+
+#ifdef DEBUG
+    Serial.println("Restart by use request");
+#endif
+
+    ESP.restart();
 }
 
 [[noreturn]] void web_loop(void *) {
-    server.on("/", [] { server.send(200, "text/html", WEB_INDEX); });
-    server.on("/settings", HTTPMethod::HTTP_GET, [] {
-        server.send(200, "application/json", settings.json());
+    boot_phase_begin(BOOT_WEB);
+
+    server.on("/", HTTP_GET, send_index);
+    server.on("/settings", HTTP_GET, [](AsyncWebServerRequest *request) {
+        // Snapshot is pinned only while the response is rendered, chunks are sent from the rendered text
+        const auto entry = settings.get();
+        send_json(request, [&entry](JsonWriter &json) { Settings::json(json, *entry); });
+    });
+    server.on("/status", HTTP_GET, [](AsyncWebServerRequest *request) {
+        const auto state = current_status();
+        send_json(request, [&state](JsonWriter &json) { status_json(json, state); });
+    });
+    server.on("/metrics", HTTP_GET, [](AsyncWebServerRequest *request) {
+        auto *response = request->beginResponseStream("text/plain; version=0.0.4");
+        write_metrics(*response);
+        request->send(response);
     });
-    server.on("/status", HTTPMethod::HTTP_GET, [] {
-        server.send(200, "application/json", status_json());
+    server.on("/profile", HTTP_GET, [](AsyncWebServerRequest *request) {
+        const auto state = current_profile();
+        send_json(request, [&state](JsonWriter &json) { profile_json(json, state); });
     });
-    server.on("/settings", HTTPMethod::HTTP_POST, [] {
-        if (settings.update_settings(server)) {
-            server.send(200, "plain/text", "OK");
+    server.on("/settings", HTTP_POST, [](AsyncWebServerRequest *request) {
+        if (settings.update_settings(request)) {
+            publish_event(EVENT_SETTINGS_CHANGED);
+            request->send(200, "plain/text", "OK");
         } else {
-            server.send(400, "plain/text", "Bad Request");
+            request->send(400, "plain/text", "Bad Request");
         }
     });
-    server.on("/reset", HTTPMethod::HTTP_POST, [] {
+    server.on("/reset", HTTP_POST, [](AsyncWebServerRequest *request) {
         settings.reset();
-        server.send(200, "plain/text", "OK");
+        publish_event(EVENT_SETTINGS_CHANGED);
+        request->send(200, "plain/text", "OK");
     });
-    server.on("/co2/calibrate", HTTPMethod::HTTP_POST, [] {
-        Mhz19.calibrate();
-        server.send(200, "plain/text", "OK");
-    });
-
-    server.on("/restart", HTTPMethod::HTTP_POST, [] {
-        if (settings.is_pending_commit()) {
-            settings.force_save();
+    server.on("/co2/calibrate", HTTP_POST, [](AsyncWebServerRequest *request) {
+        // Zone is selected by its name, first zone by default
+        const int zone = request->hasArg("zone") ? zone_by_name(request->arg("zone")) : 0;
+        if (zone < 0) {
+            request->send(400, "plain/text", "Bad Request");
+            return;
         }
 
-#ifdef DEBUG
-        Serial.println("Restart by use request");
-#endif
+        co2_calibration_requested.fetch_or(1u << zone);
+        request->send(200, "plain/text", "OK");
+    });
+    server.on("/restart", HTTP_POST, [](AsyncWebServerRequest *request) {
+        restart_requested = true;
+        xSemaphoreGive(web_task_wakeup);
 
-        server.send(200);
-        ESP.restart();
+        request->send(200);
     });
 
+    status_events.source().onConnect(on_status_events_connect);
+    server.addHandler(&status_events.source());
+
     server.begin();
+    boot_phase_end(BOOT_WEB);
 
     for (;;) {
-        server.handleClient();
-        delay(10);
+        xSemaphoreTake(web_task_wakeup, portMAX_DELAY);
+        profile_web.begin();
+
+        handle_events();
+        handle_restart();
+
+        profile_web.end();
     }
 }
\ No newline at end of file
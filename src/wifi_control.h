@@ -1,68 +1,311 @@
 #pragma once
 
 #include <Arduino.h>
+#include <Preferences.h>
 #include <WiFi.h>
+#include <esp_timer.h>
 
+#include "boot.h"
 #include "debug.h"
+#include "display_queue.h"
+#include "event_bus.h"
+#include "metrics.h"
 #include "sound.h"
 #include "hardware.h"
 
-const TickType_t mutex_wait_time = portMAX_DELAY;
-static SemaphoreHandle_t wifi_connection_mutex = xSemaphoreCreateMutex();
+// How long "connected" glyph is shown before the text resumes
+const uint16_t WIFI_CONNECTED_GLYPH_HOLD = 1000;
+
+// How long "connecting" glyph is shown at boot, sensor data is shown after it even while offline
+const uint16_t WIFI_CONNECTING_GLYPH_HOLD = 3000;
+
+const unsigned long WIFI_RECONNECT_MIN_DELAY = 500;
+const unsigned long WIFI_RECONNECT_MAX_DELAY = 60000;
+
+// Reconnect delay is randomized by +-25%, so devices don't hit the access point at once after its restart
+const unsigned long WIFI_RECONNECT_JITTER_PERCENT = 25;
+
+// wifi_max_connect_attempts is counted in these steps
+const unsigned long WIFI_CONNECT_ATTEMPT_DURATION = 100;
+
+// Attempt which got neither IP nor disconnect event (e.g. DHCP doesn't answer) is abandoned after this time
+const unsigned long WIFI_CONNECT_ATTEMPT_TIMEOUT = 10000;
+
+/*
+ * Reuse IP lease of the last connection instead of DHCP, saves DHCP round trips on reconnect.
+ * Off by default: the lease isn't checked, so if the router gives the address to another device, both stop working.
+ * Enable only with an address reserved for the board on the router.
+ */
+// #define WIFI_REUSE_IP_LEASE
+
+const uint32_t WIFI_CACHE_VERSION = 1;
+
+enum WifiLinkState : uint8_t {
+    WIFI_LINK_DISCONNECTED,
+    WIFI_LINK_CONNECTING,
+    WIFI_LINK_CONNECTED,
+};
+
+/*
+ * Wi-Fi link is driven by WiFi.onEvent() and esp_timer, nobody waits for the connection.
+ * Lost link is reconnected with exponential backoff. When it's still down after wifi_max_connect_attempts,
+ * Wi-Fi driver is restarted instead of the whole board, so sampling and schedules keep running offline.
+ */
+static volatile WifiLinkState wifi_link_state = WIFI_LINK_DISCONNECTED;
+static volatile bool wifi_was_connected = false;
+
+// Cleared by wifi_end(), so lost link isn't reconnected
+static volatile bool wifi_enabled = false;
+
+/*
+ * Access point and lease of the last successful connection, kept in NVS.
+ * Connection with known BSSID and channel skips the scan, and with WIFI_REUSE_IP_LEASE it also skips DHCP.
+ * If such connection fails, cache is ignored until the next successful connection.
+ */
+struct WifiCache {
+    uint32_t version;
+    uint8_t bssid[6];
+    int32_t channel;
+
+    uint32_t ip;
+    uint32_t gateway;
+    uint32_t subnet;
+    uint32_t dns;
+};
+
+static Preferences wifi_preferences;
+static WifiCache wifi_cache{};
+static bool wifi_cache_valid = false;
+static bool wifi_fast_connect = false;
+static unsigned long wifi_connect_started = 0;
+
+static esp_timer_handle_t wifi_reconnect_timer = nullptr;
+static unsigned long wifi_reconnect_delay = WIFI_RECONNECT_MIN_DELAY;
+static unsigned long wifi_disconnected_since = 0;
 
 bool is_connected() {
-    return WiFiClass::status() == WL_CONNECTED;
+    return wifi_link_state == WIFI_LINK_CONNECTED;
 }
 
-void wifi_connect() {
-    while (xSemaphoreTake(wifi_connection_mutex, mutex_wait_time) != pdTRUE) {
-#ifdef DEBUG
-        Serial.println("Can't take mutex (wifi_connect)");
-#endif
-    }
+void _wifi_load_cache() {
+    wifi_preferences.begin("wifi");
+    wifi_cache_valid = wifi_preferences.getBytes("cache", &wifi_cache, sizeof(wifi_cache)) == sizeof(wifi_cache)
+                       && wifi_cache.version == WIFI_CACHE_VERSION;
+}
+
+void _wifi_save_cache() {
+    WifiCache cache{};
+    cache.version = WIFI_CACHE_VERSION;
+    memcpy(cache.bssid, WiFi.BSSID(), sizeof(cache.bssid));
+    cache.channel = WiFi.channel();
+
+    cache.ip = WiFi.localIP();
+    cache.gateway = WiFi.gatewayIP();
+    cache.subnet = WiFi.subnetMask();
+    cache.dns = WiFi.dnsIP();
 
-    matrix.fillScreen(LOW);
-    matrix.write();
-    matrix.drawChar(0, 0, 'W', HIGH, LOW, 1);
-    matrix.write();
+    wifi_cache_valid = true;
 
+    // Don't wear out flash with the same data
+    if (memcmp(&cache, &wifi_cache, sizeof(cache)) == 0) return;
+
+    wifi_cache = cache;
+    wifi_preferences.putBytes("cache", &wifi_cache, sizeof(wifi_cache));
+}
+
+// Reconnect timer fires as the attempt timeout while connecting, and as backoff delay after a failure
+void _wifi_arm_attempt_timeout() {
+    esp_timer_stop(wifi_reconnect_timer);
+    esp_timer_start_once(wifi_reconnect_timer, (uint64_t) WIFI_CONNECT_ATTEMPT_TIMEOUT * 1000);
+}
+
+void _wifi_start() {
+    // Reported as disconnect with leave reason, which is ignored while connecting
     WiFi.disconnect(true);
 
     WiFiClass::mode(WIFI_STA);
     WiFi.setSleep(WIFI_PS_NONE);
-    WiFi.begin(ssid, password);
 
-    unsigned int attempt = 0;
-    while (WiFiClass::status() != WL_CONNECTED && attempt < settings.get().wifi_max_connect_attempts) {
-        matrix.fillScreen(LOW);
-        matrix.drawChar((int16_t) (attempt % width - spacer), 0, '.', HIGH, LOW, 1);
-        matrix.write();
+    // Reconnects are scheduled by us with backoff
+    WiFi.setAutoReconnect(false);
 
-        delay(100);
-        ++attempt;
+    wifi_fast_connect = wifi_cache_valid;
+    wifi_connect_started = millis();
+
+    if (wifi_fast_connect) {
+#ifdef WIFI_REUSE_IP_LEASE
+        WiFi.config(wifi_cache.ip, wifi_cache.gateway, wifi_cache.subnet, wifi_cache.dns);
+#endif
+        WiFi.begin(ssid, password, wifi_cache.channel, wifi_cache.bssid);
+    } else {
+        // Zero addresses switch back to DHCP
+        WiFi.config(IPAddress(), IPAddress(), IPAddress());
+        WiFi.begin(ssid, password);
     }
 
-    if (WiFiClass::status() != WL_CONNECTED) {
-        matrix.fillScreen(LOW);
-        matrix.drawChar(0, 0, 'F', HIGH, LOW, 1);
-        matrix.write();
+    _wifi_arm_attempt_timeout();
+}
+
+void _wifi_schedule_reconnect() {
+    const unsigned long jitter = wifi_reconnect_delay * WIFI_RECONNECT_JITTER_PERCENT / 100;
+    const unsigned long delay_ms = wifi_reconnect_delay - jitter + esp_random() % (2 * jitter + 1);
+
+    wifi_reconnect_delay = std::min(wifi_reconnect_delay * 2, WIFI_RECONNECT_MAX_DELAY);
+
+    esp_timer_stop(wifi_reconnect_timer);
+    esp_timer_start_once(wifi_reconnect_timer, (uint64_t) delay_ms * 1000);
+
+#ifdef DEBUG
+    Serial.print("WiFi reconnect in ");
+    Serial.print(delay_ms);
+    Serial.println(" ms");
+#endif
+}
+
+void _wifi_on_reconnect_timer(void *) {
+    if (!wifi_enabled || wifi_link_state == WIFI_LINK_CONNECTED) return;
+
+    if (wifi_link_state == WIFI_LINK_CONNECTING) {
+#ifdef DEBUG
+        Serial.println("WiFi connection attempt timed out");
+#endif
 
-        play_sound(SOUND_WIFI_FAIL);
-        xSemaphoreGive(wifi_connection_mutex);
+        // Cached access point or lease may be what hangs the attempt
+        if (wifi_fast_connect) wifi_cache_valid = false;
 
-        ESP.restart();
+        wifi_link_state = WIFI_LINK_DISCONNECTED;
+        _wifi_schedule_reconnect();
         return;
     }
 
-    matrix.fillScreen(LOW);
-    matrix.drawChar(0, 0, 'K', HIGH, LOW, 1);
-    matrix.write();
+    metric_wifi_reconnect_attempts.inc();
+    wifi_link_state = WIFI_LINK_CONNECTING;
 
-    xSemaphoreGive(wifi_connection_mutex);
+    const unsigned long max_disconnected_time = settings.get()->wifi_max_connect_attempts * WIFI_CONNECT_ATTEMPT_DURATION;
+    if (millis() - wifi_disconnected_since > max_disconnected_time) {
+#ifdef DEBUG
+        Serial.println("WiFi is down for too long, restarting WiFi");
+#endif
+
+        wifi_disconnected_since = millis();
+        _wifi_start();
+    } else if (wifi_fast_connect && !wifi_cache_valid) {
+        // Access point or lease has changed, start over with scan and DHCP
+        _wifi_start();
+    } else {
+        wifi_connect_started = millis();
+        WiFi.reconnect();
+        _wifi_arm_attempt_timeout();
+    }
+}
+
+void _wifi_on_event(WiFiEvent_t event, WiFiEventInfo_t info) {
+    switch (event) {
+        case ARDUINO_EVENT_WIFI_STA_GOT_IP:
+            esp_timer_stop(wifi_reconnect_timer);
+            wifi_reconnect_delay = WIFI_RECONNECT_MIN_DELAY;
+            wifi_link_state = WIFI_LINK_CONNECTED;
+
+            metric_wifi_connect_time.observe(millis() - wifi_connect_started);
+            boot_phase_end(BOOT_NETWORK);
+            _wifi_save_cache();
+
+            publish_event(EVENT_LINK_UP);
+
+            if (wifi_was_connected) {
+                metric_wifi_reconnects.inc();
+            } else {
+                wifi_was_connected = true;
+
+                display_show_glyph('K', 0, WIFI_CONNECTED_GLYPH_HOLD);
+                play_sound(SOUND_WIFI_ON, SOUND_PRIORITY_LOW);
+            }
 
 #ifdef DEBUG
-    Serial.print("Connected to WiFi with ");
-    Serial.print(attempt);
-    Serial.println(" attempts");
+            Serial.print("Connected to WiFi in ");
+            Serial.print(millis() - wifi_connect_started);
+            Serial.print(wifi_fast_connect ? " ms (cached AP), IP: " : " ms, IP: ");
+            Serial.println(WiFi.localIP());
 #endif
-}
\ No newline at end of file
+            break;
+
+        case ARDUINO_EVENT_WIFI_STA_DISCONNECTED:
+            if (!wifi_enabled) {
+                wifi_link_state = WIFI_LINK_DISCONNECTED;
+                break;
+            }
+
+            // Leave of the previous association by _wifi_start() or WiFi.reconnect(), attempt goes on
+            if (wifi_link_state == WIFI_LINK_CONNECTING && info.wifi_sta_disconnected.reason == WIFI_REASON_ASSOC_LEAVE) {
+                break;
+            }
+
+            // Also received for every failed attempt while connecting
+            if (wifi_link_state == WIFI_LINK_CONNECTED) {
+                metric_wifi_disconnects.inc();
+                wifi_disconnected_since = millis();
+
+                publish_event(EVENT_LINK_DOWN);
+
+                play_sound(SOUND_WIFI_FAIL);
+
+#ifdef DEBUG
+                Serial.println("WiFi lost connection");
+#endif
+            }
+
+            // Cached access point didn't work
+            if (wifi_link_state == WIFI_LINK_CONNECTING && wifi_fast_connect) wifi_cache_valid = false;
+
+            wifi_link_state = WIFI_LINK_DISCONNECTED;
+            _wifi_schedule_reconnect();
+            break;
+
+        default:
+            break;
+    }
+}
+
+// Starts connection in the background and returns immediately
+void wifi_begin() {
+    if (wifi_reconnect_timer == nullptr) {
+        esp_timer_create_args_t args{};
+        args.callback = _wifi_on_reconnect_timer;
+        args.name = "wifi_reconnect";
+        esp_timer_create(&args, &wifi_reconnect_timer);
+
+        WiFi.onEvent(_wifi_on_event);
+        _wifi_load_cache();
+    }
+
+    if (!boot_phase_completed(BOOT_NETWORK)) boot_phase_begin(BOOT_NETWORK);
+
+    display_show_glyph('W', 0, WIFI_CONNECTING_GLYPH_HOLD);
+
+    wifi_enabled = true;
+    wifi_link_state = WIFI_LINK_CONNECTING;
+    wifi_disconnected_since = millis();
+    _wifi_start();
+}
+
+// Turns the radio off until the next wifi_begin()
+void wifi_end() {
+    wifi_enabled = false;
+    esp_timer_stop(wifi_reconnect_timer);
+
+    WiFi.disconnect(true);
+    WiFiClass::mode(WIFI_OFF);
+
+    wifi_link_state = WIFI_LINK_DISCONNECTED;
+}
+
+// For code which can't do anything useful without network, like batch upload in low-power mode
+bool wifi_wait_connected(unsigned long timeout) {
+    const auto start = millis();
+    while (!is_connected()) {
+        if (millis() - start > timeout) return false;
+        delay(10);
+    }
+
+    return true;
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <Arduino.h>
+
+#include "models.h"
+#include "pins.h"
+#include "text_format.h"
+
+/*
+ * Zones served by the controller: every zone has its own set of sensors and actuators,
+ * sensor data, schedules and alerts. Channels of the registry (channels.h) exist in every zone.
+ * Zones are sampled in turns and uploaded together in a single request.
+ */
+
+struct ZoneActuator {
+    // -1 if actuator isn't connected
+    int8_t pin;
+    uint8_t pwm_channel;
+};
+
+struct ZoneInfo {
+    // Key in JSON, label in metrics and prefix on display
+    const char *name;
+
+    // BME280 on I2C controller 0 or 1, zones sharing a controller must use the same pins and different addresses
+    uint8_t i2c_bus;
+    int8_t sda;
+    int8_t scl;
+    uint8_t bme_address;
+
+    // MH-Z19, pins are -1 for defaults of the UART
+    uint8_t co2_uart;
+    int8_t co2_rx;
+    int8_t co2_tx;
+
+    // Indexed from ACTUATOR_FIRST
+    ZoneActuator actuators[ACTUATOR_COUNT];
+};
+
+#ifdef PIN_FAN_PWM
+#define ZONE_FAN {PIN_FAN_PWM, PWM_CHANNEL_FAN}
+#else
+#define ZONE_FAN {-1, 0}
+#endif
+
+#ifdef PIN_HUMIDIFIER_PWM
+#define ZONE_HUMIDIFIER {PIN_HUMIDIFIER_PWM, PWM_CHANNEL_HUMIDIFIER}
+#else
+#define ZONE_HUMIDIFIER {-1, 0}
+#endif
+
+static constexpr ZoneInfo Zones[] = {
+        {"main",    0, PIN_BME_SDA,       PIN_BME_SCL,       BME_ADDRESS, UART_CO2,       -1,               -1,
+                {ZONE_FAN, ZONE_HUMIDIFIER}},
+#ifdef MULTI_ZONE
+        {"bedroom", 1, PIN_ZONE2_BME_SDA, PIN_ZONE2_BME_SCL, BME_ADDRESS, UART_ZONE2_CO2, PIN_ZONE2_CO2_RX, PIN_ZONE2_CO2_TX,
+                {{PIN_ZONE2_FAN_PWM, PWM_CHANNEL_ZONE2_FAN}, {PIN_ZONE2_HUMIDIFIER_PWM, PWM_CHANNEL_ZONE2_HUMIDIFIER}}},
+#endif
+};
+
+constexpr uint8_t ZONE_COUNT = sizeof(Zones) / sizeof(Zones[0]);
+
+static_assert(ZONE_COUNT > 0, "At least one zone is required");
+
+// Zone name is shown only when there are several of them
+inline void zone_display_prefix(TextBuffer &text, uint8_t zone) {
+    if (ZONE_COUNT > 1) text.text(Zones[zone].name).text(" ");
+}
+
+// Index of zone with given name or -1
+inline int zone_by_name(const String &name) {
+    for (uint8_t zone = 0; zone < ZONE_COUNT; ++zone) {
+        if (name == Zones[zone].name) return zone;
+    }
+
+    return -1;
+}
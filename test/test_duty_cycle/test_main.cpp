@@ -0,0 +1,186 @@
+#include <unity.h>
+
+#include "duty_cycle.h"
+
+/*
+ * DutyCycle against a simulated clock: time only moves when the test advances it,
+ * the same way a wake up happens after sleep_duration().
+ */
+
+class FakeClock : public Clock {
+public:
+    uint64_t now = 0;
+
+    uint64_t now_ms() const override { return now; }
+};
+
+const DutyCycleConfig CONFIG = {1000, 10000, 4};
+
+static FakeClock fake_clock;
+static DutyCycleState state;
+
+void setUp() {
+    fake_clock.now = 0;
+    state = DutyCycleState{};
+}
+
+void tearDown() {}
+
+// One wake up: sample if due and upload with given result if due
+bool wake_up(DutyCycle &cycle, bool alert, bool network_up) {
+    if (cycle.sample_due()) cycle.sampled();
+    if (!cycle.upload_due(alert)) return false;
+
+    cycle.uploaded(network_up ? cycle.pending() : 0);
+    return true;
+}
+
+void sleep(DutyCycle &cycle) {
+    fake_clock.now += cycle.sleep_duration();
+}
+
+void test_sampling_cadence() {
+    DutyCycle cycle(fake_clock, state, CONFIG);
+
+    TEST_ASSERT_TRUE(cycle.sample_due());
+    cycle.sampled();
+
+    TEST_ASSERT_FALSE(cycle.sample_due());
+    TEST_ASSERT_EQUAL_UINT32(1000, cycle.sleep_duration());
+
+    // Late wake up keeps the cadence
+    fake_clock.now = 1200;
+    TEST_ASSERT_TRUE(cycle.sample_due());
+    cycle.sampled();
+    TEST_ASSERT_EQUAL_UINT32(800, cycle.sleep_duration());
+
+    // Missed samples are skipped, not taken back to back
+    fake_clock.now = 5500;
+    cycle.sampled();
+    TEST_ASSERT_EQUAL_UINT32(1000, cycle.sleep_duration());
+    TEST_ASSERT_EQUAL_UINT8(3, cycle.pending());
+}
+
+void test_upload_interval() {
+    fake_clock.now = 1;
+    DutyCycle cycle(fake_clock, state, CONFIG);
+
+    uint8_t uploads = 0;
+    for (uint8_t i = 0; i < 30; ++i) {
+        if (wake_up(cycle, false, true)) ++uploads;
+        sleep(cycle);
+    }
+
+    // Batch is full every 4 samples, before the upload interval is over
+    TEST_ASSERT_EQUAL_UINT8(7, uploads);
+    TEST_ASSERT_EQUAL_UINT8(2, cycle.pending());
+}
+
+void test_failed_upload_keeps_samples() {
+    fake_clock.now = CONFIG.upload_interval;
+    DutyCycle cycle(fake_clock, state, CONFIG);
+
+    // Upload interval is over since boot, so the first sample is uploaded
+    TEST_ASSERT_TRUE(wake_up(cycle, false, false));
+    TEST_ASSERT_EQUAL_UINT8(1, cycle.pending());
+    TEST_ASSERT_EQUAL_UINT32(2000, cycle.retry_delay());
+
+    sleep(cycle);
+    TEST_ASSERT_FALSE(wake_up(cycle, false, true));
+    TEST_ASSERT_EQUAL_UINT8(2, cycle.pending());
+
+    // Next attempt sends everything and resets the delay
+    fake_clock.now = 2 * CONFIG.upload_interval;
+    TEST_ASSERT_TRUE(wake_up(cycle, false, true));
+    TEST_ASSERT_EQUAL_UINT8(0, cycle.pending());
+    TEST_ASSERT_EQUAL_UINT32(0, cycle.retry_delay());
+}
+
+void test_full_batch_backs_off() {
+    DutyCycle cycle(fake_clock, state, CONFIG);
+
+    // Network is down, batch is full after 4 samples and alert is raised by every sample
+    uint64_t attempts[8];
+    uint8_t count = 0;
+    while (count < 8) {
+        if (wake_up(cycle, true, false)) attempts[count++] = fake_clock.now;
+        sleep(cycle);
+    }
+
+    // Attempts are 2, 4, 8 samples apart and then at the upload interval, not at every sample
+    TEST_ASSERT_EQUAL_UINT64(0, attempts[0]);
+    TEST_ASSERT_EQUAL_UINT64(2000, attempts[1]);
+    TEST_ASSERT_EQUAL_UINT64(6000, attempts[2]);
+    TEST_ASSERT_EQUAL_UINT64(14000, attempts[3]);
+    TEST_ASSERT_EQUAL_UINT64(24000, attempts[4]);
+    TEST_ASSERT_EQUAL_UINT64(34000, attempts[5]);
+    TEST_ASSERT_EQUAL_UINT64(44000, attempts[6]);
+    TEST_ASSERT_EQUAL_UINT64(54000, attempts[7]);
+
+    // Batch is capped at its size
+    TEST_ASSERT_EQUAL_UINT8(4, cycle.pending());
+
+    // Network is back, alert is sent as soon as the delay is over
+    fake_clock.now = attempts[7] + CONFIG.upload_interval;
+    TEST_ASSERT_TRUE(wake_up(cycle, true, true));
+
+    sleep(cycle);
+    TEST_ASSERT_TRUE(wake_up(cycle, true, true));
+}
+
+void test_full_storage_backs_off() {
+    DutyCycle cycle(fake_clock, state, CONFIG);
+
+    // Sample storage is full before the batch is, network is down
+    cycle.sampled();
+    TEST_ASSERT_TRUE(cycle.upload_due(false, true));
+    cycle.uploaded(0);
+
+    sleep(cycle);
+    cycle.sampled();
+    TEST_ASSERT_FALSE(cycle.upload_due(false, true));
+
+    sleep(cycle);
+    cycle.sampled();
+    TEST_ASSERT_TRUE(cycle.upload_due(false, true));
+}
+
+void test_dropped_samples() {
+    DutyCycle cycle(fake_clock, state, CONFIG);
+
+    cycle.sampled();
+    cycle.sampled();
+    cycle.dropped(1);
+    TEST_ASSERT_EQUAL_UINT8(1, cycle.pending());
+
+    cycle.dropped(5);
+    TEST_ASSERT_EQUAL_UINT8(0, cycle.pending());
+    TEST_ASSERT_FALSE(cycle.upload_due(true));
+}
+
+void test_sleep_duration() {
+    DutyCycle cycle(fake_clock, state, CONFIG);
+
+    // Sample is due at boot
+    TEST_ASSERT_EQUAL_UINT32(0, cycle.sleep_duration());
+
+    cycle.sampled();
+    fake_clock.now = 300;
+    TEST_ASSERT_EQUAL_UINT32(700, cycle.sleep_duration());
+
+    // Overslept, no sleep until the sample is taken
+    fake_clock.now = 1500;
+    TEST_ASSERT_EQUAL_UINT32(0, cycle.sleep_duration());
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_sampling_cadence);
+    RUN_TEST(test_upload_interval);
+    RUN_TEST(test_failed_upload_keeps_samples);
+    RUN_TEST(test_full_batch_backs_off);
+    RUN_TEST(test_full_storage_backs_off);
+    RUN_TEST(test_dropped_samples);
+    RUN_TEST(test_sleep_duration);
+    return UNITY_END();
+}
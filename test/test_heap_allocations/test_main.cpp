@@ -0,0 +1,102 @@
+#include <Arduino.h>
+#include <unity.h>
+
+#include "channels.h"
+#include "heap_counter.h"
+#include "json_writer.h"
+#include "models.h"
+#include "text_format.h"
+#include "zones.h"
+
+/*
+ * Text built on every sensor cycle and alert must not touch the heap, allocations there fragment it over days of uptime.
+ * Host build counts C++ allocations, which is where String and containers would show up. Fake String keeps even
+ * short text on the heap, so the control case below makes sure the counter sees String code at all.
+ */
+
+static SensorData data;
+
+void setUp() {
+    data = SensorData();
+}
+
+void tearDown() {}
+
+void set_values(float temperature, float humidity, float co2) {
+    data.values[TEMPERATURE] = temperature;
+    data.values[HUMIDITY] = humidity;
+    data.values[CO2] = co2;
+}
+
+void test_display_string() {
+    const uint32_t before = heap_allocations();
+
+    set_values(21.54f, 45.2f, 640);
+    TEST_ASSERT_TRUE(data.update_string());
+
+    set_values(-3.5f, 99.6f, 1260);
+    TEST_ASSERT_TRUE(data.update_string());
+    TEST_ASSERT_FALSE(data.update_string());
+
+    set_values(NAN, NAN, NAN);
+    TEST_ASSERT_TRUE(data.update_string());
+
+    TEST_ASSERT_EQUAL_UINT32(0, heap_allocations() - before);
+    TEST_ASSERT_EQUAL_STRING("NO DATA", data.display_string);
+}
+
+// Display text as it was built with String before TextBuffer
+void test_string_concatenation_allocates() {
+    const uint32_t before = heap_allocations();
+
+    const String text = String(21.5f, 1) + " C " + String(640) + "ppm";
+
+    TEST_ASSERT_GREATER_THAN(before, heap_allocations());
+    TEST_ASSERT_EQUAL_STRING("21.5 C 640ppm", text.c_str());
+}
+
+// Same text as display task shows for an alert, buffer is as long as display text
+void test_alert_text() {
+    char buffer[64 + 1];
+    const auto &channel = Channels[CO2];
+
+    const uint32_t before = heap_allocations();
+
+    TextBuffer text(buffer);
+    text.text("ALERT ");
+    zone_display_prefix(text, 0);
+    text.text(channel.name).text(": ").fixed(1640, channel.fraction).text(" ").text(channel.unit);
+
+    TEST_ASSERT_EQUAL_UINT32(0, heap_allocations() - before);
+    TEST_ASSERT_EQUAL_STRING(ZONE_COUNT > 1 ? "ALERT main CO2: 1640 ppm" : "ALERT CO2: 1640 ppm", buffer);
+}
+
+// Same JSON as alert event of the Web UI
+void test_alert_event_json() {
+    char buffer[128];
+
+    const uint32_t before = heap_allocations();
+
+    ChunkWriter out((uint8_t *) buffer, sizeof(buffer) - 1);
+    JsonWriter json(out);
+
+    json.begin_object();
+    json.field("zone", Zones[0].name);
+    json.field("channel", Channels[CO2].key);
+    json.field("value", 1640.0f);
+    json.field("active", true);
+    json.end_object();
+    buffer[out.written()] = '\0';
+
+    TEST_ASSERT_EQUAL_UINT32(0, heap_allocations() - before);
+    TEST_ASSERT_EQUAL_STRING("{\"zone\":\"main\",\"channel\":\"co2\",\"value\":1640,\"active\":true}", buffer);
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_string_concatenation_allocates);
+    RUN_TEST(test_display_string);
+    RUN_TEST(test_alert_text);
+    RUN_TEST(test_alert_event_json);
+    return UNITY_END();
+}
@@ -0,0 +1,379 @@
+#include <Arduino.h>
+#include <WiFi.h>
+#include <WiFiClient.h>
+#include <fake_time.h>
+#include <unity.h>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "mqtt.h"
+
+/*
+ * MqttClient over a real local socket against a scripted broker. Broker answers CONNECT and PINGREQ,
+ * PUBACKs are sent by the tests, so messages stay in flight as long as a test needs.
+ * Timeouts are reached by moving the fake clock, which otherwise runs in real time.
+ */
+
+const unsigned long CONNECT_TIMEOUT = 5000;
+
+// Real time to wait for packets to cross the socket
+const unsigned long SOCKET_WAIT = 2000;
+
+struct BrokerPacket {
+    uint8_t type;
+    uint8_t flags;
+
+    // Packet identifier of PUBLISH
+    uint16_t id;
+};
+
+class ScriptedBroker {
+    int _listen_fd = -1;
+    std::atomic<int> _client_fd{-1};
+    uint16_t _port = 0;
+
+    std::mutex _mutex;
+    std::vector<BrokerPacket> _packets;
+
+    static bool _read(int fd, uint8_t *buffer, size_t size) {
+        size_t received = 0;
+        while (received < size) {
+            const auto result = recv(fd, buffer + received, size - received, 0);
+            if (result <= 0) return false;
+
+            received += result;
+        }
+
+        return true;
+    }
+
+    void _send(const uint8_t *packet, size_t length) {
+        const int fd = _client_fd;
+        if (fd >= 0) send(fd, packet, length, MSG_NOSIGNAL);
+    }
+
+    void _serve(int fd) {
+        for (;;) {
+            uint8_t header;
+            if (!_read(fd, &header, 1)) return;
+
+            uint32_t length = 0;
+            uint8_t shift = 0, digit;
+            do {
+                if (!_read(fd, &digit, 1)) return;
+                length |= (uint32_t) (digit & 0x7f) << shift;
+                shift += 7;
+            } while (digit & 0x80);
+
+            std::vector<uint8_t> body(length);
+            if (length && !_read(fd, body.data(), length)) return;
+
+            BrokerPacket packet{(uint8_t) (header >> 4), (uint8_t) (header & 0x0f), 0};
+
+            // Id follows the topic
+            if (packet.type == MQTT_PUBLISH && length >= 2) {
+                const size_t topic_length = (body[0] << 8) | body[1];
+                if (length >= topic_length + 4) packet.id = (body[topic_length + 2] << 8) | body[topic_length + 3];
+            }
+
+            {
+                std::lock_guard<std::mutex> guard(_mutex);
+                _packets.push_back(packet);
+            }
+
+            if (packet.type == MQTT_CONNECT) {
+                const uint8_t connack[] = {MQTT_CONNACK << 4, 2, 0, 0};
+                _send(connack, sizeof(connack));
+            } else if (packet.type == MQTT_PINGREQ && answer_pings) {
+                const uint8_t pingresp[] = {MQTT_PINGRESP << 4, 0};
+                _send(pingresp, sizeof(pingresp));
+            }
+        }
+    }
+
+public:
+    std::atomic<bool> answer_pings{true};
+
+    void start() {
+        _listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+
+        sockaddr_in address{};
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+        bind(_listen_fd, (sockaddr *) &address, sizeof(address));
+        listen(_listen_fd, 1);
+
+        socklen_t address_length = sizeof(address);
+        getsockname(_listen_fd, (sockaddr *) &address, &address_length);
+        _port = ntohs(address.sin_port);
+
+        // One connection at a time, next one is accepted when the client goes away
+        std::thread([this]() {
+            for (;;) {
+                const int fd = accept(_listen_fd, nullptr, nullptr);
+                if (fd < 0) return;
+
+                _client_fd = fd;
+                _serve(fd);
+                _client_fd = -1;
+                close(fd);
+            }
+        }).detach();
+    }
+
+    inline uint16_t port() const { return _port; }
+
+    void puback(uint16_t id) {
+        const uint8_t packet[] = {MQTT_PUBACK << 4, 2, (uint8_t) (id >> 8), (uint8_t) (id & 0xff)};
+        _send(packet, sizeof(packet));
+    }
+
+    // Connection is lost without DISCONNECT
+    void drop() {
+        const int fd = _client_fd;
+        if (fd >= 0) shutdown(fd, SHUT_RDWR);
+    }
+
+    std::vector<BrokerPacket> packets() {
+        std::lock_guard<std::mutex> guard(_mutex);
+        return _packets;
+    }
+
+    void clear() {
+        std::lock_guard<std::mutex> guard(_mutex);
+        _packets.clear();
+    }
+
+    // Waits until broker has received given number of packets
+    bool wait(size_t count) {
+        const auto start = millis();
+        while (packets().size() < count) {
+            if (millis() - start > SOCKET_WAIT) return false;
+            delay(1);
+        }
+
+        return true;
+    }
+};
+
+static ScriptedBroker broker;
+static std::vector<uint32_t> acks;
+
+void on_ack(uint32_t latency_ms) {
+    acks.push_back(latency_ms);
+}
+
+// Client of a single test, starts with packet id 1
+struct TestClient {
+    WiFiClient connection;
+    MqttClient mqtt{connection, on_ack};
+
+    TestClient() {
+        acks.clear();
+        mqtt.credentials("monitor-test", nullptr, nullptr);
+
+        TEST_ASSERT_TRUE(mqtt.connect("127.0.0.1", broker.port(), CONNECT_TIMEOUT));
+        TEST_ASSERT_TRUE(broker.wait(1));
+        broker.clear();
+    }
+
+    bool publish() {
+        const uint8_t payload[] = "{\"Tamb\":22.5}";
+        return mqtt.publish("monitor/main", payload, sizeof(payload) - 1, true);
+    }
+
+    // Runs client loop until condition holds
+    bool loop_until(const std::function<bool()> &condition) {
+        const auto start = millis();
+        while (!condition()) {
+            if (millis() - start > SOCKET_WAIT) return false;
+
+            mqtt.loop();
+            delay(1);
+        }
+
+        return true;
+    }
+};
+
+void assert_publish(const BrokerPacket &packet, uint16_t id, bool duplicate) {
+    TEST_ASSERT_EQUAL_UINT8(MQTT_PUBLISH, packet.type);
+    TEST_ASSERT_EQUAL_UINT16(id, packet.id);
+
+    // QoS 1 and retained, DUP only on resend
+    TEST_ASSERT_EQUAL_UINT8(0x02 | 0x01 | (duplicate ? 0x08 : 0), packet.flags);
+}
+
+void setUp() {
+    // Client of a failed test is left connected, broker serves one connection at a time
+    broker.drop();
+    broker.answer_pings = true;
+}
+
+void tearDown() {}
+
+void test_window_full() {
+    TestClient client;
+
+    for (uint8_t i = 0; i < MQTT_INFLIGHT_WINDOW; ++i) TEST_ASSERT_TRUE(client.publish());
+    TEST_ASSERT_EQUAL_UINT8(0, client.mqtt.window_free());
+
+    // Nothing is written while the window is full
+    const auto bytes = client.mqtt.bytes_sent();
+    TEST_ASSERT_FALSE(client.publish());
+    TEST_ASSERT_EQUAL_UINT32(bytes, client.mqtt.bytes_sent());
+
+    TEST_ASSERT_TRUE(broker.wait(MQTT_INFLIGHT_WINDOW));
+    const auto packets = broker.packets();
+    TEST_ASSERT_EQUAL_UINT32(MQTT_INFLIGHT_WINDOW, packets.size());
+    for (uint8_t i = 0; i < MQTT_INFLIGHT_WINDOW; ++i) assert_publish(packets[i], i + 1, false);
+
+    // Acknowledged slot is taken by the next message
+    broker.puback(3);
+    TEST_ASSERT_TRUE(client.loop_until([&]() { return client.mqtt.window_free() == 1; }));
+    TEST_ASSERT_TRUE(client.publish());
+    TEST_ASSERT_EQUAL_UINT8(0, client.mqtt.window_free());
+}
+
+// PUBACK releases only the message with its id, unknown ids are ignored
+void test_puback_id_matching() {
+    TestClient client;
+
+    for (uint8_t i = 0; i < 3; ++i) TEST_ASSERT_TRUE(client.publish());
+    TEST_ASSERT_TRUE(broker.wait(3));
+
+    broker.puback(2);
+    broker.puback(77);
+    broker.puback(1);
+
+    TEST_ASSERT_TRUE(client.loop_until([]() { return acks.size() == 2; }));
+    TEST_ASSERT_TRUE(client.loop_until([&]() { return client.connection.available() == 0; }));
+    client.mqtt.loop();
+
+    TEST_ASSERT_EQUAL_UINT32(2, acks.size());
+    TEST_ASSERT_EQUAL_UINT8(1, client.mqtt.inflight());
+    for (auto latency: acks) TEST_ASSERT_LESS_OR_EQUAL(SOCKET_WAIT, latency);
+
+    // Acknowledged again, e.g. after a resend which crossed the first PUBACK
+    broker.puback(2);
+    TEST_ASSERT_TRUE(client.loop_until([&]() { return client.connection.available() == 0; }));
+    client.mqtt.loop();
+    TEST_ASSERT_EQUAL_UINT32(2, acks.size());
+
+    broker.puback(3);
+    TEST_ASSERT_TRUE(client.loop_until([&]() { return client.mqtt.inflight() == 0; }));
+    TEST_ASSERT_EQUAL_UINT32(3, acks.size());
+}
+
+void test_resend_after_timeout() {
+    TestClient client;
+
+    TEST_ASSERT_TRUE(client.publish());
+    TEST_ASSERT_TRUE(client.publish());
+    TEST_ASSERT_TRUE(broker.wait(2));
+
+    broker.puback(1);
+    TEST_ASSERT_TRUE(client.loop_until([]() { return acks.size() == 1; }));
+    broker.clear();
+
+    fake_time_advance((MQTT_RETRY_TIMEOUT - 1000) * 1000ull);
+    client.mqtt.loop();
+    TEST_ASSERT_FALSE(broker.wait(1));
+
+    // Only the unacknowledged message, once per timeout
+    fake_time_advance(2000 * 1000ull);
+    client.mqtt.loop();
+    client.mqtt.loop();
+    TEST_ASSERT_TRUE(broker.wait(1));
+    delay(50);
+
+    const auto packets = broker.packets();
+    TEST_ASSERT_EQUAL_UINT32(1, packets.size());
+    assert_publish(packets[0], 2, true);
+    TEST_ASSERT_EQUAL_UINT8(1, client.mqtt.inflight());
+}
+
+void test_resend_after_reconnect() {
+    TestClient client;
+
+    for (uint8_t i = 0; i < 3; ++i) TEST_ASSERT_TRUE(client.publish());
+    TEST_ASSERT_TRUE(broker.wait(3));
+
+    broker.puback(2);
+    TEST_ASSERT_TRUE(client.loop_until([]() { return acks.size() == 1; }));
+
+    broker.drop();
+    TEST_ASSERT_TRUE(client.loop_until([&]() { return !client.mqtt.connected(); }));
+    broker.clear();
+
+    // Session is persistent, so unacknowledged messages follow CONNECT right away with DUP set
+    TEST_ASSERT_TRUE(client.mqtt.connect("127.0.0.1", broker.port(), CONNECT_TIMEOUT));
+    TEST_ASSERT_TRUE(client.publish());
+    TEST_ASSERT_TRUE(broker.wait(4));
+
+    const auto packets = broker.packets();
+    TEST_ASSERT_EQUAL_UINT32(4, packets.size());
+    TEST_ASSERT_EQUAL_UINT8(MQTT_CONNECT, packets[0].type);
+    assert_publish(packets[1], 1, true);
+    assert_publish(packets[2], 3, true);
+    assert_publish(packets[3], 4, false);
+}
+
+// Ping is sent after half of keep alive without other packets, missing response closes the connection
+void test_keep_alive_teardown() {
+    TestClient client;
+    const uint64_t half_keep_alive_us = (uint64_t) MQTT_KEEP_ALIVE * 1000000 / 2 + 1000000;
+
+    fake_time_advance(half_keep_alive_us);
+    client.mqtt.loop();
+    TEST_ASSERT_TRUE(broker.wait(1));
+    TEST_ASSERT_EQUAL_UINT8(MQTT_PINGREQ, broker.packets()[0].type);
+
+    // Answered ping keeps the connection
+    delay(50);
+    client.mqtt.loop();
+    broker.answer_pings = false;
+
+    fake_time_advance(half_keep_alive_us);
+    client.mqtt.loop();
+    TEST_ASSERT_TRUE(client.mqtt.connected());
+    TEST_ASSERT_TRUE(broker.wait(2));
+    TEST_ASSERT_EQUAL_UINT8(MQTT_PINGREQ, broker.packets()[1].type);
+
+    fake_time_advance(half_keep_alive_us);
+    client.mqtt.loop();
+    TEST_ASSERT_FALSE(client.mqtt.connected());
+}
+
+int main() {
+    // Wi-Fi connects on the stepped clock, sockets need real time afterwards
+    fake_time_set_speed(0);
+    WiFi.mode(WIFI_STA);
+    WiFi.begin("test", "password");
+    while (!WiFi.isConnected()) delay(100);
+    fake_time_set_speed(1);
+
+    broker.start();
+
+    UNITY_BEGIN();
+    RUN_TEST(test_window_full);
+    RUN_TEST(test_puback_id_matching);
+    RUN_TEST(test_resend_after_timeout);
+    RUN_TEST(test_resend_after_reconnect);
+    RUN_TEST(test_keep_alive_teardown);
+    const int failures = UNITY_END();
+
+    // Wi-Fi event task and broker thread are still running
+    fflush(stdout);
+    quick_exit(failures);
+}
@@ -0,0 +1,62 @@
+#include <Arduino.h>
+#include <Adafruit_GFX.h>
+#include <Max72xxEmulator.h>
+#include <Max72xxPanel.h>
+#include <unity.h>
+
+#include <chrono>
+
+#include "scroll_text.h"
+
+/*
+ * Render benchmark: text is scrolled across 1..16 chained panels the same way the display task does it
+ * (clear, draw columns, write), and host time and SPI traffic per frame are reported.
+ * Times include the emulator decoding the SPI stream, so compare them between runs, not with the device.
+ */
+
+const uint8_t PANEL_CS = 5;
+const uint8_t GLYPH_WIDTH = 6;
+const uint8_t MAX_PANELS = 16;
+const uint16_t FRAMES = 2000;
+
+static ScrollText<GLYPH_WIDTH> text;
+
+void setUp() {
+    text.render("21.5 C  1.2k ppm  45 %  21.5 C  1.2k ppm  45 %");
+}
+
+void tearDown() {}
+
+void bench_panels(uint8_t panels) {
+    Max72xxPanel panel(PANEL_CS, panels, 1);
+    auto &emulator = Max72xxEmulator::instance();
+    emulator.setMaxFrames(1);
+    emulator.clear();
+
+    const auto start = std::chrono::steady_clock::now();
+    for (uint16_t frame = 0; frame < FRAMES; ++frame) {
+        panel.fillScreen(LOW);
+        text.draw(panel, (int32_t) (frame % (text.length() + panel.width())) - panel.width(), 0);
+        panel.write();
+    }
+
+    const auto elapsed = std::chrono::steady_clock::now() - start;
+    const double us = (double) std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count() / 1000.0 / FRAMES;
+
+    TEST_ASSERT_EQUAL_UINT32(FRAMES, emulator.stats().frames);
+
+    char message[96];
+    snprintf(message, sizeof(message), "%2u panels: %7.2f us/frame, %6.1f SPI bytes/frame",
+             panels, us, emulator.stats().avgBytes());
+    TEST_MESSAGE(message);
+}
+
+void test_render_time_per_panel_count() {
+    for (uint8_t panels = 1; panels <= MAX_PANELS; ++panels) bench_panels(panels);
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_render_time_per_panel_count);
+    return UNITY_END();
+}
@@ -0,0 +1,87 @@
+#include <Arduino.h>
+#include <Adafruit_GFX.h>
+#include <Max72xxEmulator.h>
+#include <Max72xxPanel.h>
+#include <unity.h>
+
+#include <string>
+
+#include "scroll_text.h"
+
+/*
+ * Golden frames of the scrolling text as the MAX7219 chain latched them.
+ * A change of glyph rendering, column packing or panel mapping shows up as a different picture.
+ */
+
+const uint8_t PANEL_CS = 5;
+const uint8_t GLYPH_WIDTH = 6;
+const uint8_t PANELS = 4;
+
+static ScrollText<GLYPH_WIDTH> text;
+
+void setUp() {
+    text.render("21.5 C");
+}
+
+void tearDown() {}
+
+std::string last_frame_ascii() {
+    auto &emulator = Max72xxEmulator::instance();
+
+    char *buffer = nullptr;
+    size_t size = 0;
+    FILE *out = open_memstream(&buffer, &size);
+    emulator.dumpAscii(out, emulator.frames().back());
+    fclose(out);
+
+    std::string result(buffer, size);
+    free(buffer);
+
+    return result;
+}
+
+std::string draw_frame(Max72xxPanel &panel, int32_t offset) {
+    panel.fillScreen(LOW);
+    text.draw(panel, offset, 0);
+    panel.write();
+
+    return last_frame_ascii();
+}
+
+void test_text_frame() {
+    Max72xxPanel panel(PANEL_CS, PANELS, 1);
+
+    TEST_ASSERT_EQUAL_STRING(
+            ".###....#.........#####........#\n"
+            "#...#..##.........#...........#.\n"
+            "....#...#.........####........#.\n"
+            ".###....#.............#.......#.\n"
+            "#.......#.............#.......#.\n"
+            "#.......#.....##..#...#.......#.\n"
+            "#####..###....##...###.........#\n"
+            "................................\n",
+            draw_frame(panel, 0).c_str());
+}
+
+void test_scrolled_frame() {
+    Max72xxPanel panel(PANEL_CS, PANELS, 1);
+
+    // Text enters from the right edge, as at the start of a scroll pass
+    TEST_ASSERT_EQUAL_STRING(
+            ".....................###....#...\n"
+            "....................#...#..##...\n"
+            "........................#...#...\n"
+            ".....................###....#...\n"
+            "....................#.......#...\n"
+            "....................#.......#...\n"
+            "....................#####..###..\n"
+            "................................\n",
+            draw_frame(panel, -20).c_str());
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_text_frame);
+    RUN_TEST(test_scrolled_frame);
+    return UNITY_END();
+}
@@ -0,0 +1,148 @@
+#include <unity.h>
+
+#include <chrono>
+#include <random>
+
+#include "series_codec.h"
+
+/*
+ * Round trip of the series codec on a synthetic room: slow random walk of temperature, humidity and CO2
+ * sampled every 5 s with timing jitter and occasional missing CO2 readings.
+ * Also reports compression ratio and encode and decode time per sample on host.
+ */
+
+const uint16_t SAMPLES = 10000;
+const uint8_t CHANNELS = 3;
+
+// Scales of the battery batch: one decimal digit more than displayed
+static SeriesFormat format;
+
+static uint32_t times[SAMPLES];
+static float values[SAMPLES][CHANNELS];
+
+static SeriesBlock<65536> block;
+
+void generate_samples() {
+    std::mt19937 random(1);
+    std::normal_distribution<float> noise(0, 1);
+
+    float temperature = 22.5f, humidity = 45, co2 = 600;
+    uint32_t time = 1000;
+
+    for (uint16_t i = 0; i < SAMPLES; ++i) {
+        temperature += noise(random) * 0.02f;
+        humidity += noise(random) * 0.1f;
+        co2 += noise(random) * 3;
+        time += 5000 + random() % 21 - 10;
+
+        times[i] = time;
+        values[i][0] = temperature;
+        values[i][1] = humidity;
+        values[i][2] = i % 500 == 0 ? NAN : roundf(co2);
+    }
+}
+
+void setUp() {
+    format = SeriesFormat{};
+    format.channels = CHANNELS;
+    format.scale[0] = 100;
+    format.scale[1] = 10;
+    format.scale[2] = 10;
+
+    block = SeriesBlock<65536>{};
+}
+
+void tearDown() {}
+
+double elapsed_ns(std::chrono::steady_clock::time_point start) {
+    return (double) std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+void test_round_trip() {
+    SeriesEncoder encoder(format, block);
+
+    auto start = std::chrono::steady_clock::now();
+    for (uint16_t i = 0; i < SAMPLES; ++i) TEST_ASSERT_TRUE(encoder.append(times[i], values[i]));
+    const double encode_ns = elapsed_ns(start) / SAMPLES;
+
+    SeriesDecoder decoder(format, block);
+
+    uint32_t time;
+    float decoded[CHANNELS];
+    uint16_t count = 0;
+
+    start = std::chrono::steady_clock::now();
+    while (decoder.next(time, decoded)) {
+        TEST_ASSERT_EQUAL_UINT32(times[count], time);
+
+        for (uint8_t c = 0; c < CHANNELS; ++c) {
+            if (isnan(values[count][c])) {
+                TEST_ASSERT_FLOAT_IS_NAN(decoded[c]);
+            } else {
+                // Rounded to the scale, within half of its step
+                TEST_ASSERT_FLOAT_WITHIN(0.5f / format.scale[c] + 1e-4f, values[count][c], decoded[c]);
+            }
+        }
+
+        ++count;
+    }
+    const double decode_ns = elapsed_ns(start) / SAMPLES;
+
+    TEST_ASSERT_EQUAL_UINT16(SAMPLES, count);
+
+    // Floats alone take 12 bytes per sample, with timestamp 16
+    const double bytes_per_sample = (double) block.state.length / SAMPLES;
+    TEST_ASSERT_LESS_THAN(6.0, bytes_per_sample);
+
+    char message[128];
+    snprintf(message, sizeof(message), "%.2f B/sample, ratio %.2f (%.2f with timestamp), encode %.1f ns/sample, decode %.1f ns/sample",
+             bytes_per_sample, 12.0 / bytes_per_sample, 16.0 / bytes_per_sample, encode_ns, decode_ns);
+    TEST_MESSAGE(message);
+}
+
+void test_block_full() {
+    SeriesBlock<192> small{};
+    SeriesEncoder encoder(format, small);
+
+    uint16_t count = 0;
+    while (encoder.append(times[count], values[count])) ++count;
+
+    // Failed append leaves the block as it was
+    TEST_ASSERT_EQUAL_UINT16(count, small.state.count);
+    TEST_ASSERT_LESS_OR_EQUAL(192, small.state.length);
+    TEST_ASSERT_GREATER_THAN(16, count);
+}
+
+void test_drop_front() {
+    SeriesBlock<192> small{};
+    SeriesEncoder encoder(format, small);
+    for (uint16_t i = 0; i < 20; ++i) TEST_ASSERT_TRUE(encoder.append(times[i], values[i]));
+
+    series_drop_front(format, small, 5);
+    TEST_ASSERT_EQUAL_UINT16(15, small.state.count);
+
+    SeriesDecoder decoder(format, small);
+    uint32_t time;
+    float decoded[CHANNELS];
+    for (uint16_t i = 5; i < 20; ++i) {
+        TEST_ASSERT_TRUE(decoder.next(time, decoded));
+        TEST_ASSERT_EQUAL_UINT32(times[i], time);
+    }
+
+    TEST_ASSERT_FALSE(decoder.next(time, decoded));
+
+    // Encoding continues after the kept samples
+    SeriesEncoder appender(format, small);
+    TEST_ASSERT_TRUE(appender.append(times[20], values[20]));
+    TEST_ASSERT_EQUAL_UINT16(16, small.state.count);
+}
+
+int main() {
+    generate_samples();
+
+    UNITY_BEGIN();
+    RUN_TEST(test_round_trip);
+    RUN_TEST(test_block_full);
+    RUN_TEST(test_drop_front);
+    return UNITY_END();
+}
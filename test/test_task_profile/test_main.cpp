@@ -0,0 +1,131 @@
+#include <Arduino.h>
+#include <fake_time.h>
+#include <unity.h>
+
+#include <string>
+
+#include "json_writer.h"
+#include "task_profile.h"
+
+/*
+ * TaskProfile totals on the fake clock, which only moves when the test advances it,
+ * and layout of /profile for a given state.
+ */
+
+static const uint32_t BUCKETS_US[] = {1000, 10000};
+
+void setUp() {}
+
+void tearDown() {}
+
+void iteration(TaskProfile &profile, uint32_t busy_us, uint32_t blocked_us = 0) {
+    profile.begin();
+    fake_time_advance(busy_us);
+    if (blocked_us) profile.blocked(blocked_us);
+    profile.end();
+}
+
+void test_totals() {
+    Histogram duration("loop", "", BUCKETS_US, 1e-6f);
+    PeakGauge peak("peak", "", 1e-6f);
+    TaskProfile profile("Test", duration, peak);
+
+    TEST_ASSERT_EQUAL_INT8(-1, profile.core());
+
+    iteration(profile, 1500);
+    iteration(profile, 700);
+    iteration(profile, 20000);
+
+    TEST_ASSERT_EQUAL_UINT32(3, profile.iterations());
+    TEST_ASSERT_EQUAL_UINT32(22, profile.busy_ms());
+    TEST_ASSERT_EQUAL_UINT32(20000, profile.max_us());
+    TEST_ASSERT_EQUAL_INT8(xPortGetCoreID(), profile.core());
+
+    TEST_ASSERT_EQUAL_UINT32(1, duration.bucket(0));
+    TEST_ASSERT_EQUAL_UINT32(1, duration.bucket(1));
+    TEST_ASSERT_EQUAL_UINT32(1, duration.bucket(2));
+    TEST_ASSERT_FLOAT_WITHIN(1e-6f, 0.0222f, (float) duration.sum());
+}
+
+// Sub-millisecond parts are carried over to the next iterations instead of being lost
+void test_remainders() {
+    Histogram duration("loop", "", BUCKETS_US, 1e-6f);
+    PeakGauge peak("peak", "", 1e-6f);
+    TaskProfile profile("Test", duration, peak);
+
+    for (uint8_t i = 0; i < 9; ++i) iteration(profile, 300, 250);
+    TEST_ASSERT_EQUAL_UINT32(2, profile.busy_ms());
+    TEST_ASSERT_EQUAL_UINT32(2, profile.blocked_ms());
+
+    iteration(profile, 300, 250);
+    TEST_ASSERT_EQUAL_UINT32(3, profile.busy_ms());
+    TEST_ASSERT_EQUAL_UINT32(2, profile.blocked_ms());
+
+    iteration(profile, 300, 250);
+    TEST_ASSERT_EQUAL_UINT32(3, profile.busy_ms());
+    TEST_ASSERT_EQUAL_UINT32(2, profile.blocked_ms());
+
+    iteration(profile, 300, 250);
+    TEST_ASSERT_EQUAL_UINT32(3, profile.busy_ms());
+    TEST_ASSERT_EQUAL_UINT32(3, profile.blocked_ms());
+}
+
+ProfileState sample_state() {
+    ProfileState state{};
+    state.uptime_ms = 10000;
+    state.tasks[0] = {"UI", 0, 100, 2000, 500, 50000, 1024};
+    state.tasks[1] = {"Data", 1, 10, 500, 0, 80000, 2048};
+    state.tasks[2] = {"Web", -1, 0, 0, 0, 0, NAN};
+
+    return state;
+}
+
+std::string render(const ProfileState &state) {
+    char buffer[1024];
+    ChunkWriter out((uint8_t *) buffer, sizeof(buffer) - 1);
+    JsonWriter json(out);
+    profile_json(json, state);
+
+    TEST_ASSERT_FALSE(out.overflow());
+    return std::string(buffer, out.written());
+}
+
+// Without run-time stats core utilization is CPU time of profiled tasks, blocked time excluded
+void test_profile_json() {
+    TEST_ASSERT_EQUAL_STRING(
+            "{\"uptime\":10000,\"tasks\":{"
+            "\"UI\":{\"core\":0,\"iterations\":100,\"avg_us\":20000,\"max_us\":50000,\"busy\":20,\"blocked_ms\":500,\"cpu\":15,\"stack_free\":1024},"
+            "\"Data\":{\"core\":1,\"iterations\":10,\"avg_us\":50000,\"max_us\":80000,\"busy\":5,\"blocked_ms\":0,\"cpu\":5,\"stack_free\":2048},"
+            "\"Web\":{\"core\":-1,\"iterations\":0,\"avg_us\":0,\"max_us\":0,\"busy\":0,\"blocked_ms\":0,\"cpu\":0,\"stack_free\":null}},"
+            "\"cores\":{\"0\":15,\"1\":5}}",
+            render(sample_state()).c_str());
+}
+
+// With run-time stats core utilization is taken from idle tasks
+void test_profile_json_runtime() {
+    ProfileState state = sample_state();
+    state.total_runtime = 3000;
+    state.runtime_count = 3;
+    state.runtime[0] = {"IDLE0", 0, 2100, 1000};
+    state.runtime[1] = {"IDLE1", 1, 2700, 1000};
+    state.runtime[2] = {"loopTask", -1, 200, 512};
+
+    const auto json = render(state);
+    TEST_ASSERT_NOT_NULL(strstr(json.c_str(),
+                                "\"cores\":{\"0\":30,\"1\":10},"
+                                "\"runtime\":{"
+                                "\"IDLE0\":{\"core\":0,\"cpu\":70,\"stack_free\":1000},"
+                                "\"IDLE1\":{\"core\":1,\"cpu\":90,\"stack_free\":1000},"
+                                "\"loopTask\":{\"core\":-1,\"cpu\":6.7,\"stack_free\":512}}}"));
+}
+
+int main() {
+    fake_time_set_speed(0);
+
+    UNITY_BEGIN();
+    RUN_TEST(test_totals);
+    RUN_TEST(test_remainders);
+    RUN_TEST(test_profile_json);
+    RUN_TEST(test_profile_json_runtime);
+    return UNITY_END();
+}
@@ -0,0 +1,197 @@
+#include <Arduino.h>
+#include <WiFi.h>
+#include <fake_time.h>
+#include <unity.h>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+#include "timed_client.h"
+
+/*
+ * TimedClient against a local HTTP server, written to the way HTTPClient does: headers and payload
+ * in separate calls, then polling available() for the response. Gaps inside the write phase
+ * and the server's think time are made by moving the fake clock, which otherwise runs in real time.
+ * Server answers only after the clock was moved, so the think time is always in the first byte phase.
+ */
+
+const char REQUEST_HEADERS[] = "POST /api HTTP/1.1\r\nHost: localhost\r\nContent-Length: 13\r\n\r\n";
+const char REQUEST_BODY[] = "{\"Tamb\":22.5}";
+const size_t REQUEST_LENGTH = sizeof(REQUEST_HEADERS) - 1 + sizeof(REQUEST_BODY) - 1;
+
+const char RESPONSE[] = "HTTP/1.1 200 OK\r\nContent-Length: 0\r\n\r\n";
+
+const uint64_t WRITE_GAP_US = 20000;
+const uint64_t FIRST_BYTE_US = 150000;
+
+// Real time the test itself adds to the measured phases
+const int64_t SLACK_US = 500000;
+
+static uint16_t server_port = 0;
+
+// Response is allowed by the test after it has moved the clock by the server's think time
+static std::atomic<int> responses_allowed{0};
+static std::atomic<int> responses_sent{0};
+
+void serve_connection(int fd) {
+    for (;;) {
+        char buffer[REQUEST_LENGTH];
+        size_t received = 0;
+        while (received < REQUEST_LENGTH) {
+            const auto result = recv(fd, buffer + received, REQUEST_LENGTH - received, 0);
+            if (result <= 0) break;
+
+            received += result;
+        }
+
+        if (received < REQUEST_LENGTH) break;
+
+        while (responses_sent >= responses_allowed) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+        ++responses_sent;
+        send(fd, RESPONSE, sizeof(RESPONSE) - 1, MSG_NOSIGNAL);
+    }
+
+    close(fd);
+}
+
+// Connections are kept alive, each is served on its own
+void serve(int listen_fd) {
+    for (;;) {
+        const int fd = accept(listen_fd, nullptr, nullptr);
+        if (fd < 0) return;
+
+        std::thread(serve_connection, fd).detach();
+    }
+}
+
+uint16_t start_server() {
+    const int fd = socket(AF_INET, SOCK_STREAM, 0);
+
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    bind(fd, (sockaddr *) &address, sizeof(address));
+    listen(fd, 1);
+
+    socklen_t address_length = sizeof(address);
+    getsockname(fd, (sockaddr *) &address, &address_length);
+
+    std::thread(serve, fd).detach();
+    return ntohs(address.sin_port);
+}
+
+// Port which nobody listens on
+uint16_t closed_port() {
+    const int fd = socket(AF_INET, SOCK_STREAM, 0);
+
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    bind(fd, (sockaddr *) &address, sizeof(address));
+    socklen_t address_length = sizeof(address);
+    getsockname(fd, (sockaddr *) &address, &address_length);
+    close(fd);
+
+    return ntohs(address.sin_port);
+}
+
+// Request as HTTPClient writes it, then the whole response is read
+void request(TimedClient &client) {
+    client.write((const uint8_t *) REQUEST_HEADERS, sizeof(REQUEST_HEADERS) - 1);
+    fake_time_advance(WRITE_GAP_US);
+    client.write((const uint8_t *) REQUEST_BODY, sizeof(REQUEST_BODY) - 1);
+
+    fake_time_advance(FIRST_BYTE_US);
+    ++responses_allowed;
+
+    const auto start = millis();
+    while (client.available() < (int) sizeof(RESPONSE) - 1) {
+        TEST_ASSERT_TRUE(millis() - start < SLACK_US / 1000);
+        delay(1);
+    }
+
+    char response[sizeof(RESPONSE)];
+    TEST_ASSERT_EQUAL_INT(sizeof(RESPONSE) - 1, client.read((uint8_t *) response, sizeof(RESPONSE) - 1));
+}
+
+void assert_phase_within(int64_t expected_us, int64_t actual_us) {
+    TEST_ASSERT_TRUE(actual_us >= expected_us);
+    TEST_ASSERT_TRUE(actual_us < expected_us + SLACK_US);
+}
+
+void setUp() {}
+
+void tearDown() {}
+
+void test_new_connection() {
+    TimedClient client;
+    TEST_ASSERT_EQUAL_INT(1, client.connect("127.0.0.1", server_port, 1000));
+    request(client);
+
+    assert_phase_within(0, client.phase(HTTP_PHASE_DNS));
+    assert_phase_within(0, client.phase(HTTP_PHASE_CONNECT));
+    assert_phase_within(WRITE_GAP_US, client.phase(HTTP_PHASE_WRITE));
+    assert_phase_within(FIRST_BYTE_US, client.phase(HTTP_PHASE_FIRST_BYTE));
+
+    TEST_ASSERT_EQUAL_UINT32(REQUEST_LENGTH, client.bytes_written());
+}
+
+// Request on a kept connection has no DNS and connect, and counts only its own bytes
+void test_reused_connection() {
+    TimedClient client;
+    TEST_ASSERT_EQUAL_INT(1, client.connect("127.0.0.1", server_port, 1000));
+    request(client);
+
+    client.begin_request();
+    request(client);
+
+    TEST_ASSERT_TRUE(client.phase(HTTP_PHASE_DNS) < 0);
+    TEST_ASSERT_TRUE(client.phase(HTTP_PHASE_CONNECT) < 0);
+    assert_phase_within(WRITE_GAP_US, client.phase(HTTP_PHASE_WRITE));
+    assert_phase_within(FIRST_BYTE_US, client.phase(HTTP_PHASE_FIRST_BYTE));
+
+    TEST_ASSERT_EQUAL_UINT32(REQUEST_LENGTH, client.bytes_written());
+}
+
+// Lookup is timed even when connection is refused, nothing after it
+void test_refused_connection() {
+    TimedClient client;
+    TEST_ASSERT_EQUAL_INT(0, client.connect("127.0.0.1", closed_port(), 1000));
+
+    assert_phase_within(0, client.phase(HTTP_PHASE_DNS));
+    TEST_ASSERT_TRUE(client.phase(HTTP_PHASE_CONNECT) < 0);
+    TEST_ASSERT_TRUE(client.phase(HTTP_PHASE_WRITE) < 0);
+    TEST_ASSERT_TRUE(client.phase(HTTP_PHASE_FIRST_BYTE) < 0);
+
+    TEST_ASSERT_EQUAL_UINT32(0, client.bytes_written());
+}
+
+int main() {
+    // Wi-Fi connects on the stepped clock, sockets need real time afterwards
+    fake_time_set_speed(0);
+    WiFi.mode(WIFI_STA);
+    WiFi.begin("test", "password");
+    while (!WiFi.isConnected()) delay(100);
+    fake_time_set_speed(1);
+
+    server_port = start_server();
+
+    UNITY_BEGIN();
+    RUN_TEST(test_new_connection);
+    RUN_TEST(test_reused_connection);
+    RUN_TEST(test_refused_connection);
+    const int failures = UNITY_END();
+
+    // Wi-Fi event task and server thread are still running
+    fflush(stdout);
+    quick_exit(failures);
+}
@@ -0,0 +1,119 @@
+#include <Arduino.h>
+#include <Adafruit_BME280.h>
+#include <HTTPClient.h>
+#include <fake_time.h>
+#include <unity.h>
+
+#include <string>
+#include <vector>
+
+#include "zones.h"
+
+/*
+ * Firmware running on the fake clock with every zone on its own sensors, which read differently.
+ * Zones are sampled in turns spread over the update interval and uploaded by a single request.
+ * Built with MULTI_ZONE by the native-zones environment, a single zone is checked by the native one.
+ */
+
+void setup();
+
+// Defaults of the firmware settings and of the data task loop
+const uint32_t SENSOR_UPDATE_INTERVAL = 5000;
+const uint32_t SENSOR_SEND_INTERVAL = 15000;
+const uint32_t DATA_LOOP_DELAY = 100;
+
+const uint32_t TURN_INTERVAL = SENSOR_UPDATE_INTERVAL / ZONE_COUNT;
+
+// Every zone has a BME280 on its own I2C controller
+const char *const EXPECTED_ZONE_VALUES[] = {
+        "\"Tamb\":22.5,\"Hum\":45,\"CntR\":600",
+        "\"Tamb\":20.5,\"Hum\":55,\"CntR\":800",
+};
+
+static_assert(ZONE_COUNT <= sizeof(EXPECTED_ZONE_VALUES) / sizeof(EXPECTED_ZONE_VALUES[0]), "Zone readings are missing");
+
+void setUp() {}
+
+void tearDown() {}
+
+// Time of every sample, and zone it belongs to, by BME280 reads of the zone's bus
+void test_sampling_turns() {
+    uint32_t reads[ZONE_COUNT];
+    for (uint8_t zone = 0; zone < ZONE_COUNT; ++zone) reads[zone] = fake_bme280(Zones[zone].i2c_bus).reads;
+
+    std::vector<std::pair<uint32_t, uint8_t>> samples;
+    const uint32_t end = millis() + 4 * SENSOR_UPDATE_INTERVAL;
+    while (millis() < end) {
+        delay(10);
+
+        for (uint8_t zone = 0; zone < ZONE_COUNT; ++zone) {
+            // Reads of a sample can be seen over two polls
+            const uint32_t value = fake_bme280(Zones[zone].i2c_bus).reads;
+            const bool same_sample = !samples.empty() && samples.back().second == zone
+                                     && millis() - samples.back().first < DATA_LOOP_DELAY;
+            if (value != reads[zone] && !same_sample) samples.emplace_back(millis(), zone);
+            reads[zone] = value;
+        }
+    }
+
+    TEST_ASSERT_GREATER_OR_EQUAL(4 * ZONE_COUNT - 1, samples.size());
+
+    for (size_t i = 1; i < samples.size(); ++i) {
+        TEST_ASSERT_EQUAL_UINT8((samples[i - 1].second + 1) % ZONE_COUNT, samples[i].second);
+
+        // Next turn comes on the first loop iteration after the turn interval
+        const uint32_t spacing = samples[i].first - samples[i - 1].first;
+        TEST_ASSERT_GREATER_THAN(TURN_INTERVAL, spacing);
+        TEST_ASSERT_LESS_OR_EQUAL(TURN_INTERVAL + 2 * DATA_LOOP_DELAY, spacing);
+    }
+}
+
+// Every upload is one request with all zones, each with its own readings
+void test_single_upload_request() {
+    fake_http_clear();
+    delay(3 * SENSOR_SEND_INTERVAL);
+
+    const auto requests = fake_http_requests();
+    TEST_ASSERT_GREATER_OR_EQUAL(2, requests.size());
+    TEST_ASSERT_LESS_OR_EQUAL(3, requests.size());
+
+    for (auto &request: requests) {
+        const std::string body = request.body.c_str();
+
+        if (ZONE_COUNT == 1) {
+            TEST_ASSERT_EQUAL_UINT32(0, body.find(std::string("{") + EXPECTED_ZONE_VALUES[0]));
+            continue;
+        }
+
+        // Top level has zone objects only, in order of Zones[]
+        size_t position = 0;
+        for (uint8_t zone = 0; zone < ZONE_COUNT; ++zone) {
+            const std::string object = std::string(zone == 0 ? "{\"" : "},\"") + Zones[zone].name + "\":{" + EXPECTED_ZONE_VALUES[zone];
+            const size_t found = body.find(object, position);
+
+            TEST_ASSERT_TRUE_MESSAGE(found != std::string::npos, body.c_str());
+            if (zone == 0) TEST_ASSERT_EQUAL_UINT32(0, found);
+
+            position = found + object.size();
+        }
+
+        TEST_ASSERT_EQUAL_UINT32(body.size() - 2, body.find("}}", position));
+    }
+}
+
+int main() {
+    fake_time_set_speed(0);
+    setup();
+
+    // Past Wi-Fi connection and the first turns
+    delay(SENSOR_UPDATE_INTERVAL);
+
+    UNITY_BEGIN();
+    RUN_TEST(test_sampling_turns);
+    RUN_TEST(test_single_upload_request);
+    const int failures = UNITY_END();
+
+    // Firmware tasks are still running, static destructors would pull objects from under them
+    fflush(stdout);
+    quick_exit(failures);
+}